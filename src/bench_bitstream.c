@@ -0,0 +1,337 @@
+/*
+ *  bench_bitstream.c - VDPAU backend for VA-API (bitstream submission benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* Measures how many VdpBitstreamBuffers the driver hands to
+ * VdpDecoderRender() for multi-slice H.264 pictures, and how long
+ * vaRenderPicture() + vaEndPicture() take, with and without
+ * VDPAU_VIDEO_BITSTREAM_ASSEMBLY. The fragment count comes from the
+ * counters of the software VDPAU device in the driver statistics, so
+ * this requires VDPAU_VIDEO_SOFTWARE=1, and times include the recording
+ * of statistics. Each run happens in a child process since the assembly
+ * setting is read once per process.
+ */
+
+#define NUM_SURFACES 4
+
+typedef struct {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        num_slices;
+    unsigned int        slice_size;
+    unsigned int        num_pictures;
+} bench_params_t;
+
+typedef struct {
+    tool_driver_t       drv;
+    VAConfigID          config;
+    VAContextID         context;
+    VASurfaceID         surfaces[NUM_SURFACES];
+    VAPictureParameterBufferH264 pic_param;
+    VASliceParameterBufferH264 *slice_params;
+    uint8_t            *slice_data;
+} bench_t;
+
+// Fills in parameters of picture N, which references picture N-1
+static void
+bench_fill_params(bench_t *bench, const bench_params_t *params, unsigned int n)
+{
+    VAPictureParameterBufferH264 * const pic_param = &bench->pic_param;
+    VASurfaceID const ref = n > 0 ?
+        bench->surfaces[(n - 1) % NUM_SURFACES] : VA_INVALID_SURFACE;
+    unsigned int i, j;
+
+    memset(pic_param, 0, sizeof(*pic_param));
+    pic_param->CurrPic.picture_id           = bench->surfaces[n % NUM_SURFACES];
+    pic_param->picture_width_in_mbs_minus1  = (params->width + 15) / 16 - 1;
+    pic_param->picture_height_in_mbs_minus1 = (params->height + 15) / 16 - 1;
+    pic_param->num_ref_frames               = 1;
+    pic_param->seq_fields.bits.frame_mbs_only_flag = 1;
+    for (i = 0; i < 16; i++) {
+        pic_param->ReferenceFrames[i].picture_id = VA_INVALID_SURFACE;
+        pic_param->ReferenceFrames[i].flags      = VA_PICTURE_H264_INVALID;
+    }
+    if (ref != VA_INVALID_SURFACE) {
+        pic_param->ReferenceFrames[0].picture_id = ref;
+        pic_param->ReferenceFrames[0].flags =
+            VA_PICTURE_H264_SHORT_TERM_REFERENCE;
+    }
+
+    memset(bench->slice_params, 0,
+           params->num_slices * sizeof(*bench->slice_params));
+    for (i = 0; i < params->num_slices; i++) {
+        VASliceParameterBufferH264 * const slice_param = &bench->slice_params[i];
+        slice_param->slice_data_size   = params->slice_size;
+        slice_param->slice_data_offset = i * params->slice_size;
+        for (j = 0; j < 32; j++) {
+            slice_param->RefPicList0[j].picture_id = VA_INVALID_SURFACE;
+            slice_param->RefPicList1[j].picture_id = VA_INVALID_SURFACE;
+        }
+        slice_param->RefPicList0[0].picture_id = ref;
+    }
+}
+
+// Submits picture N, returns the time spent in vaRenderPicture() and vaEndPicture()
+static int
+bench_picture(
+    bench_t              *bench,
+    const bench_params_t *params,
+    unsigned int          n,
+    uint64_t             *time
+)
+{
+    VABufferID buffers[3];
+    unsigned int i, num_buffers = 0;
+    uint64_t start;
+    int ret = 0;
+
+    bench_fill_params(bench, params, n);
+
+    if (!tool_check_status(VA_CALL(&bench->drv, BeginPicture,
+                                   bench->context,
+                                   bench->pic_param.CurrPic.picture_id),
+                           "vaBeginPicture()"))
+        return 0;
+    if (!tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VAPictureParameterBufferType,
+                                   sizeof(bench->pic_param), 1,
+                                   &bench->pic_param,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()") ||
+        !tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VASliceParameterBufferType,
+                                   sizeof(*bench->slice_params),
+                                   params->num_slices, bench->slice_params,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()") ||
+        !tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VASliceDataBufferType,
+                                   params->num_slices * params->slice_size, 1,
+                                   bench->slice_data,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()"))
+        goto end;
+
+    start = get_ticks_usec();
+    if (!tool_check_status(VA_CALL(&bench->drv, RenderPicture, bench->context,
+                                   buffers, num_buffers),
+                           "vaRenderPicture()") ||
+        !tool_check_status(VA_CALL(&bench->drv, EndPicture, bench->context),
+                           "vaEndPicture()"))
+        goto end;
+    *time = get_ticks_usec() - start;
+    ret = 1;
+
+end:
+    for (i = 0; i < num_buffers; i++)
+        VA_CALL(&bench->drv, DestroyBuffer, buffers[i]);
+    return ret;
+}
+
+// Runs the benchmark in this process, slices start with a start code if START_CODES is set
+static int
+bench_run(const bench_params_t *params, int start_codes)
+{
+    bench_t bench;
+    char stats_path[64];
+    uint64_t renders, fragments, bytes;
+    uint64_t time, total_time = 0, max_time = 0;
+    unsigned int i;
+    int ret = -1;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.slice_params = calloc(params->num_slices, sizeof(*bench.slice_params));
+    bench.slice_data   = malloc(params->num_slices * params->slice_size);
+    if (!bench.slice_params || !bench.slice_data)
+        goto end;
+
+    /* Slice payloads without emulated start codes, as in real streams */
+    memset(bench.slice_data, 0x55, params->num_slices * params->slice_size);
+    for (i = 0; i < params->num_slices; i++) {
+        uint8_t * const slice = bench.slice_data + i * params->slice_size;
+        if (start_codes) {
+            slice[0] = 0x00;
+            slice[1] = 0x00;
+            slice[2] = 0x01;
+            slice[3] = 0x65;
+        }
+        else
+            slice[0] = 0x65;
+    }
+
+    stats_path[0] = '\0';
+    if (tool_stats_enable(stats_path, sizeof(stats_path)) < 0 ||
+        tool_driver_open(&bench.drv) < 0)
+        goto end;
+
+    if (!tool_check_status(VA_CALL(&bench.drv, CreateConfig,
+                                   VAProfileH264High, VAEntrypointVLD,
+                                   NULL, 0, &bench.config),
+                           "vaCreateConfig()") ||
+        !tool_check_status(VA_CALL(&bench.drv, CreateSurfaces,
+                                   params->width, params->height,
+                                   VA_RT_FORMAT_YUV420, NUM_SURFACES,
+                                   bench.surfaces),
+                           "vaCreateSurfaces()") ||
+        !tool_check_status(VA_CALL(&bench.drv, CreateContext, bench.config,
+                                   params->width, params->height, 0,
+                                   bench.surfaces, NUM_SURFACES,
+                                   &bench.context),
+                           "vaCreateContext()"))
+        goto end;
+
+    for (i = 0; i < params->num_pictures; i++) {
+        if (!bench_picture(&bench, params, i, &time))
+            goto end;
+        total_time += time;
+        if (max_time < time)
+            max_time = time;
+    }
+    for (i = 0; i < NUM_SURFACES; i++)
+        VA_CALL(&bench.drv, SyncSurface, bench.surfaces[i]);
+    ret = 0;
+
+end:
+    if (bench.drv.ctx) {
+        if (bench.context)
+            VA_CALL(&bench.drv, DestroyContext, bench.context);
+        if (bench.surfaces[0])
+            VA_CALL(&bench.drv, DestroySurfaces, bench.surfaces, NUM_SURFACES);
+        if (bench.config)
+            VA_CALL(&bench.drv, DestroyConfig, bench.config);
+    }
+    tool_driver_close(&bench.drv);
+    free(bench.slice_params);
+    free(bench.slice_data);
+
+    /* Statistics are written at vaTerminate() */
+    if (ret == 0) {
+        if (!tool_stats_read_counter(stats_path, "soft: decoder renders",
+                                     &renders) ||
+            !tool_stats_read_counter(stats_path, "soft: bitstream buffers",
+                                     &fragments) ||
+            !tool_stats_read_counter(stats_path, "soft: bitstream bytes",
+                                     &bytes) ||
+            renders == 0) {
+            fprintf(stderr, "no picture reached the software VDPAU device\n");
+            ret = -1;
+        }
+        else
+            printf("assembly %-3s start codes %-3s %6.1f buffers/picture, "
+                   "%8.0f bytes/picture, %7.2f us/picture (max %llu us)\n",
+                   getenv("VDPAU_VIDEO_BITSTREAM_ASSEMBLY"),
+                   start_codes ? "yes" : "no",
+                   (double)fragments / renders, (double)bytes / renders,
+                   (double)total_time / params->num_pictures,
+                   (unsigned long long)max_time);
+    }
+    if (stats_path[0])
+        unlink(stats_path);
+    return ret;
+}
+
+// Runs the benchmark in a child process with the given assembly setting
+static int
+bench_fork(const bench_params_t *params, const char *assembly, int start_codes)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        setenv("VDPAU_VIDEO_BITSTREAM_ASSEMBLY", assembly, 1);
+        exit(bench_run(params, start_codes) < 0);
+    }
+    if (waitpid(pid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return 0;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n PICTURES] [-c SLICES] [-b BYTES] [-s WIDTHxHEIGHT]\n"
+            "  -n PICTURES  number of pictures (default 1000)\n"
+            "  -c SLICES    slices per picture (default 8)\n"
+            "  -b BYTES     bytes per slice (default 4096)\n"
+            "  -s SIZE      picture size (default 1920x1088)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    int opt;
+
+    params.width        = 1920;
+    params.height       = 1088;
+    params.num_slices   = 8;
+    params.slice_size   = 4096;
+    params.num_pictures = 1000;
+
+    while ((opt = getopt(argc, argv, "n:c:b:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            params.num_pictures = atoi(optarg);
+            break;
+        case 'c':
+            params.num_slices = atoi(optarg);
+            break;
+        case 'b':
+            params.slice_size = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &params.width, &params.height) == 2)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.num_pictures == 0 || params.num_slices == 0 ||
+        params.slice_size < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%u pictures of %u slices of %u bytes\n", params.num_pictures,
+           params.num_slices, params.slice_size);
+    if (bench_fork(&params, "no",  0) < 0 ||
+        bench_fork(&params, "yes", 0) < 0 ||
+        bench_fork(&params, "no",  1) < 0 ||
+        bench_fork(&params, "yes", 1) < 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,352 @@
+/*
+ *  bench_buffer_pool.c - VDPAU backend for VA-API (VA buffer pool benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* Submits H.264 pictures the way libva clients do, creating picture
+ * parameter, IQ matrix, slice parameter and slice data buffers for each
+ * picture and destroying them after vaEndPicture(), with slice counts
+ * and sizes changing from one picture to the next. Reports how many
+ * buffer data blocks come from the VA buffer pool, and how many are
+ * allocated from the heap per picture once the pool is warmed up. The
+ * counters come from the driver statistics, so runs with the default
+ * pool and with VDPAU_VIDEO_BUFFER_POOL_SIZE=0 each happen in child
+ * processes, over the warm-up pictures alone and then over all of them.
+ */
+
+#define NUM_SURFACES 4
+#define MAX_SLICES   8
+
+typedef struct {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        max_slice_size;
+    unsigned int        num_warmup_pictures;
+    unsigned int        num_pictures;
+} bench_params_t;
+
+typedef struct {
+    uint64_t            num_allocs;
+    uint64_t            num_hits;
+    uint64_t            time;
+} bench_result_t;
+
+typedef struct {
+    tool_driver_t       drv;
+    VAConfigID          config;
+    VAContextID         context;
+    VASurfaceID         surfaces[NUM_SURFACES];
+    VAPictureParameterBufferH264 pic_param;
+    VAIQMatrixBufferH264 iq_matrix;
+    VASliceParameterBufferH264 slice_params[MAX_SLICES];
+    uint8_t            *slice_data;
+    unsigned int        seed;
+} bench_t;
+
+// Submits picture N with its own set of buffers
+static int
+bench_picture(bench_t *bench, const bench_params_t *params, unsigned int n)
+{
+    VAPictureParameterBufferH264 * const pic_param = &bench->pic_param;
+    VABufferID buffers[4];
+    unsigned int i, num_buffers = 0, num_slices, slice_size;
+    int ret = 0;
+
+    /* Pictures of varying size, as I, P and B pictures are */
+    bench->seed = bench->seed * 1103515245 + 12345;
+    num_slices  = 1 + (bench->seed >> 16) % MAX_SLICES;
+    slice_size  = 4 + (bench->seed >> 8) % params->max_slice_size;
+
+    memset(pic_param, 0, sizeof(*pic_param));
+    pic_param->CurrPic.picture_id           = bench->surfaces[n % NUM_SURFACES];
+    pic_param->picture_width_in_mbs_minus1  = (params->width + 15) / 16 - 1;
+    pic_param->picture_height_in_mbs_minus1 = (params->height + 15) / 16 - 1;
+    pic_param->seq_fields.bits.frame_mbs_only_flag = 1;
+    for (i = 0; i < 16; i++) {
+        pic_param->ReferenceFrames[i].picture_id = VA_INVALID_SURFACE;
+        pic_param->ReferenceFrames[i].flags      = VA_PICTURE_H264_INVALID;
+    }
+
+    memset(bench->slice_params, 0, sizeof(bench->slice_params));
+    for (i = 0; i < num_slices; i++) {
+        VASliceParameterBufferH264 * const slice_param = &bench->slice_params[i];
+        unsigned int j;
+
+        slice_param->slice_data_size   = slice_size;
+        slice_param->slice_data_offset = i * slice_size;
+        for (j = 0; j < 32; j++) {
+            slice_param->RefPicList0[j].picture_id = VA_INVALID_SURFACE;
+            slice_param->RefPicList1[j].picture_id = VA_INVALID_SURFACE;
+        }
+        bench->slice_data[i * slice_size] = 0x65;
+    }
+
+    if (!tool_check_status(VA_CALL(&bench->drv, BeginPicture, bench->context,
+                                   pic_param->CurrPic.picture_id),
+                           "vaBeginPicture()"))
+        return 0;
+    if (!tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VAPictureParameterBufferType,
+                                   sizeof(*pic_param), 1, pic_param,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()") ||
+        !tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VAIQMatrixBufferType,
+                                   sizeof(bench->iq_matrix), 1,
+                                   &bench->iq_matrix,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()") ||
+        !tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VASliceParameterBufferType,
+                                   sizeof(bench->slice_params[0]), num_slices,
+                                   bench->slice_params,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()") ||
+        !tool_check_status(VA_CALL(&bench->drv, CreateBuffer, bench->context,
+                                   VASliceDataBufferType,
+                                   num_slices * slice_size, 1,
+                                   bench->slice_data,
+                                   &buffers[num_buffers++]),
+                           "vaCreateBuffer()"))
+        goto end;
+
+    if (!tool_check_status(VA_CALL(&bench->drv, RenderPicture, bench->context,
+                                   buffers, num_buffers),
+                           "vaRenderPicture()") ||
+        !tool_check_status(VA_CALL(&bench->drv, EndPicture, bench->context),
+                           "vaEndPicture()"))
+        goto end;
+    ret = 1;
+
+end:
+    for (i = 0; i < num_buffers; i++)
+        VA_CALL(&bench->drv, DestroyBuffer, buffers[i]);
+    return ret;
+}
+
+// Submits NUM_PICTURES pictures in this process
+static int
+bench_run(
+    const bench_params_t *params,
+    unsigned int          num_pictures,
+    bench_result_t       *result
+)
+{
+    bench_t bench;
+    char stats_path[64];
+    uint64_t start;
+    unsigned int i;
+    int ret = -1;
+
+    memset(&bench, 0, sizeof(bench));
+    memset(&bench.iq_matrix, 16, sizeof(bench.iq_matrix));
+    bench.seed       = 1;
+    bench.slice_data = calloc(MAX_SLICES, params->max_slice_size + 4);
+    if (!bench.slice_data)
+        return -1;
+
+    stats_path[0] = '\0';
+    if (tool_stats_enable(stats_path, sizeof(stats_path)) < 0 ||
+        tool_driver_open(&bench.drv) < 0)
+        goto end;
+
+    if (!tool_check_status(VA_CALL(&bench.drv, CreateConfig,
+                                   VAProfileH264High, VAEntrypointVLD,
+                                   NULL, 0, &bench.config),
+                           "vaCreateConfig()") ||
+        !tool_check_status(VA_CALL(&bench.drv, CreateSurfaces,
+                                   params->width, params->height,
+                                   VA_RT_FORMAT_YUV420, NUM_SURFACES,
+                                   bench.surfaces),
+                           "vaCreateSurfaces()") ||
+        !tool_check_status(VA_CALL(&bench.drv, CreateContext, bench.config,
+                                   params->width, params->height, 0,
+                                   bench.surfaces, NUM_SURFACES,
+                                   &bench.context),
+                           "vaCreateContext()"))
+        goto end;
+
+    start = get_ticks_usec();
+    for (i = 0; i < num_pictures; i++) {
+        if (!bench_picture(&bench, params, i))
+            goto end;
+    }
+    for (i = 0; i < NUM_SURFACES; i++)
+        VA_CALL(&bench.drv, SyncSurface, bench.surfaces[i]);
+    result->time = get_ticks_usec() - start;
+    ret = 0;
+
+end:
+    if (bench.drv.ctx) {
+        if (bench.context)
+            VA_CALL(&bench.drv, DestroyContext, bench.context);
+        if (bench.surfaces[0])
+            VA_CALL(&bench.drv, DestroySurfaces, bench.surfaces, NUM_SURFACES);
+        if (bench.config)
+            VA_CALL(&bench.drv, DestroyConfig, bench.config);
+    }
+    tool_driver_close(&bench.drv);
+    free(bench.slice_data);
+
+    /* Statistics are written at vaTerminate() */
+    if (ret == 0 &&
+        (!tool_stats_read_counter(stats_path, "VA buffer pool: allocations",
+                                  &result->num_allocs) ||
+         !tool_stats_read_counter(stats_path, "VA buffer pool: from pool",
+                                  &result->num_hits))) {
+        fprintf(stderr, "driver statistics have no VA buffer pool counters\n");
+        ret = -1;
+    }
+    if (stats_path[0])
+        unlink(stats_path);
+    return ret;
+}
+
+// Runs the benchmark in a child process with the given pool size
+// (NULL: driver default), the result is sent back through a pipe
+static int
+bench_fork(
+    const bench_params_t *params,
+    const char           *pool_size,
+    unsigned int          num_pictures,
+    bench_result_t       *result
+)
+{
+    int fds[2], status, ret;
+    pid_t pid;
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        if (pool_size)
+            setenv("VDPAU_VIDEO_BUFFER_POOL_SIZE", pool_size, 1);
+        else
+            unsetenv("VDPAU_VIDEO_BUFFER_POOL_SIZE");
+        if (bench_run(params, num_pictures, result) < 0 ||
+            write(fds[1], result, sizeof(*result)) != sizeof(*result))
+            exit(1);
+        exit(0);
+    }
+
+    close(fds[1]);
+    ret = read(fds[0], result, sizeof(*result)) == sizeof(*result) ? 0 : -1;
+    close(fds[0]);
+    if (waitpid(pid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return ret;
+}
+
+// Runs the warm-up pictures, then all pictures, with the given pool size
+static int
+bench_pool(const bench_params_t *params, const char *pool_size)
+{
+    bench_result_t warmup, total;
+    uint64_t num_allocs, num_hits;
+
+    if (bench_fork(params, pool_size, params->num_warmup_pictures, &warmup) < 0 ||
+        bench_fork(params, pool_size, params->num_warmup_pictures +
+                   params->num_pictures, &total) < 0)
+        return -1;
+
+    num_allocs = total.num_allocs - warmup.num_allocs;
+    num_hits   = total.num_hits   - warmup.num_hits;
+    printf("pool %-8s %6.2f allocations/picture, %6.2f from pool, "
+           "%6.2f from heap, %7.2f us/picture\n",
+           pool_size ? pool_size : "default",
+           (double)num_allocs / params->num_pictures,
+           (double)num_hits / params->num_pictures,
+           (double)(num_allocs - num_hits) / params->num_pictures,
+           (double)(total.time - warmup.time) / params->num_pictures);
+    return 0;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n PICTURES] [-w PICTURES] [-b BYTES] [-s WIDTHxHEIGHT]\n"
+            "  -n PICTURES  number of measured pictures (default 1000)\n"
+            "  -w PICTURES  number of warm-up pictures (default 1000)\n"
+            "  -b BYTES     maximum bytes per slice (default 65536)\n"
+            "  -s SIZE      picture size (default 1920x1088)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    int opt;
+
+    params.width               = 1920;
+    params.height              = 1088;
+    params.max_slice_size      = 65536;
+    params.num_warmup_pictures = 1000;
+    params.num_pictures        = 1000;
+
+    while ((opt = getopt(argc, argv, "n:w:b:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            params.num_pictures = atoi(optarg);
+            break;
+        case 'w':
+            params.num_warmup_pictures = atoi(optarg);
+            break;
+        case 'b':
+            params.max_slice_size = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &params.width, &params.height) == 2)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.num_pictures == 0 || params.max_slice_size == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%u pictures of 1 to %u slices of up to %u bytes, after %u "
+           "warm-up pictures\n", params.num_pictures, MAX_SLICES,
+           params.max_slice_size, params.num_warmup_pictures);
+    if (bench_pool(&params, NULL) < 0 ||
+        bench_pool(&params, "0") < 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ *  bench_image.c - VDPAU backend for VA-API (image transfer benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+
+/* Measures vaGetImage() and vaPutImage() of NV12 images covering the
+ * whole surface, against images covering a region of interest in its
+ * middle, and read-only vaDeriveImage() + vaMapBuffer() + vaUnmapBuffer()
+ * of the whole surface. Throughput is given in image bytes, i.e. only
+ * the bytes the client asked for. Regions and derived images are read
+ * back from a CPU copy of the surface, kept until the surface changes,
+ * so they are measured with and without a full-frame vaPutImage()
+ * before each transfer (not counted).
+ */
+
+typedef struct {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        roi_width;
+    unsigned int        roi_height;
+    unsigned int        num_loops;
+} bench_params_t;
+
+typedef enum {
+    BENCH_GET,
+    BENCH_PUT,
+    BENCH_DERIVE
+} bench_op_t;
+
+// Reads the surface through vaDeriveImage(), without writing to it
+static VAStatus
+derive_image(tool_driver_t *drv, VASurfaceID surface)
+{
+    VAImage image;
+    void *data;
+    VAStatus status;
+
+    status = VA_CALL(drv, DeriveImage, surface, &image);
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+    status = VA_CALL(drv, MapBuffer, image.buf, &data);
+    if (status == VA_STATUS_SUCCESS)
+        status = VA_CALL(drv, UnmapBuffer, image.buf);
+    VA_CALL(drv, DestroyImage, image.image_id);
+    return status;
+}
+
+// Times NUM_LOOPS transfers of IMAGE to or from the surface at (X, Y),
+// each after putting DIRTY_IMAGE to the surface if not NULL
+static int
+bench_transfer(
+    tool_driver_t        *drv,
+    const bench_params_t *params,
+    const char           *name,
+    bench_op_t            op,
+    VASurfaceID           surface,
+    const VAImage        *image,
+    int                   x,
+    int                   y,
+    const VAImage        *dirty_image
+)
+{
+    uint64_t start, elapsed = 0;
+    unsigned int i;
+    VAStatus status;
+
+    for (i = 0; i < params->num_loops; i++) {
+        if (dirty_image) {
+            status = VA_CALL(drv, PutImage, surface, dirty_image->image_id,
+                             0, 0, dirty_image->width, dirty_image->height,
+                             0, 0, dirty_image->width, dirty_image->height);
+            if (!tool_check_status(status, "vaPutImage()"))
+                return -1;
+            VA_CALL(drv, SyncSurface, surface);
+        }
+
+        start = get_ticks_usec();
+        switch (op) {
+        case BENCH_GET:
+            status = VA_CALL(drv, GetImage, surface, x, y,
+                             image->width, image->height, image->image_id);
+            break;
+        case BENCH_PUT:
+            status = VA_CALL(drv, PutImage, surface, image->image_id,
+                             0, 0, image->width, image->height,
+                             x, y, image->width, image->height);
+            break;
+        default:
+            status = derive_image(drv, surface);
+            break;
+        }
+        if (!tool_check_status(status, name))
+            return -1;
+        VA_CALL(drv, SyncSurface, surface);
+        elapsed += get_ticks_usec() - start;
+    }
+
+    printf("%-28s %5ux%-5u %9.1f us %9.1f MB/s\n", name,
+           image->width, image->height,
+           (double)elapsed / params->num_loops,
+           elapsed > 0 ? (double)params->num_loops * image->width *
+           image->height * 3 / 2 / elapsed : 0.0);
+    return 0;
+}
+
+// Finds the NV12 image format
+static int
+get_nv12_format(tool_driver_t *drv, VAImageFormat *format)
+{
+    VAImageFormat *formats;
+    int i, num_formats = 0, ret = -1;
+
+    formats = calloc(drv->ctx->max_image_formats, sizeof(*formats));
+    if (!formats)
+        return -1;
+    if (tool_check_status(VA_CALL(drv, QueryImageFormats, formats,
+                                  &num_formats), "vaQueryImageFormats()")) {
+        for (i = 0; i < num_formats; i++) {
+            if (formats[i].fourcc == VA_FOURCC('N','V','1','2')) {
+                *format = formats[i];
+                ret = 0;
+                break;
+            }
+        }
+    }
+    if (ret < 0)
+        fprintf(stderr, "driver has no NV12 image format\n");
+    free(formats);
+    return ret;
+}
+
+static int
+bench_run(const bench_params_t *params)
+{
+    tool_driver_t drv;
+    VAImageFormat format;
+    VASurfaceID surface = VA_INVALID_SURFACE;
+    VAImage full_image, roi_image;
+    int roi_x, roi_y, ret = -1;
+
+    full_image.image_id = VA_INVALID_ID;
+    roi_image.image_id  = VA_INVALID_ID;
+
+    if (tool_driver_open(&drv) < 0)
+        return -1;
+    if (get_nv12_format(&drv, &format) < 0)
+        goto end;
+
+    if (!tool_check_status(VA_CALL(&drv, CreateSurfaces,
+                                   params->width, params->height,
+                                   VA_RT_FORMAT_YUV420, 1, &surface),
+                           "vaCreateSurfaces()") ||
+        !tool_check_status(VA_CALL(&drv, CreateImage, &format,
+                                   params->width, params->height,
+                                   &full_image), "vaCreateImage()") ||
+        !tool_check_status(VA_CALL(&drv, CreateImage, &format,
+                                   params->roi_width, params->roi_height,
+                                   &roi_image), "vaCreateImage()"))
+        goto end;
+
+    /* Even offsets, so that the ROI starts on a chroma sample */
+    roi_x = ((params->width  - params->roi_width)  / 2) & ~1;
+    roi_y = ((params->height - params->roi_height) / 2) & ~1;
+
+    if (bench_transfer(&drv, params, "vaPutImage() full", BENCH_PUT,
+                       surface, &full_image, 0, 0, NULL) < 0 ||
+        bench_transfer(&drv, params, "vaGetImage() full", BENCH_GET,
+                       surface, &full_image, 0, 0, NULL) < 0 ||
+        bench_transfer(&drv, params, "vaPutImage() ROI", BENCH_PUT,
+                       surface, &roi_image, roi_x, roi_y, NULL) < 0 ||
+        bench_transfer(&drv, params, "vaPutImage() ROI, dirty", BENCH_PUT,
+                       surface, &roi_image, roi_x, roi_y, &full_image) < 0 ||
+        bench_transfer(&drv, params, "vaGetImage() ROI", BENCH_GET,
+                       surface, &roi_image, roi_x, roi_y, NULL) < 0 ||
+        bench_transfer(&drv, params, "vaGetImage() ROI, dirty", BENCH_GET,
+                       surface, &roi_image, roi_x, roi_y, &full_image) < 0 ||
+        bench_transfer(&drv, params, "vaDeriveImage() read", BENCH_DERIVE,
+                       surface, &full_image, 0, 0, NULL) < 0 ||
+        bench_transfer(&drv, params, "vaDeriveImage() read, dirty",
+                       BENCH_DERIVE, surface, &full_image, 0, 0,
+                       &full_image) < 0)
+        goto end;
+    ret = 0;
+
+end:
+    if (roi_image.image_id != VA_INVALID_ID)
+        VA_CALL(&drv, DestroyImage, roi_image.image_id);
+    if (full_image.image_id != VA_INVALID_ID)
+        VA_CALL(&drv, DestroyImage, full_image.image_id);
+    if (surface != VA_INVALID_SURFACE)
+        VA_CALL(&drv, DestroySurfaces, &surface, 1);
+    tool_driver_close(&drv);
+    return ret;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n LOOPS] [-s WIDTHxHEIGHT] [-r WIDTHxHEIGHT]\n"
+            "  -n LOOPS  transfers per measurement (default 200)\n"
+            "  -s SIZE   surface size (default 1920x1080)\n"
+            "  -r SIZE   region of interest size (default 320x240)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    int opt;
+
+    params.width      = 1920;
+    params.height     = 1080;
+    params.roi_width  = 320;
+    params.roi_height = 240;
+    params.num_loops  = 200;
+
+    while ((opt = getopt(argc, argv, "n:s:r:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            params.num_loops = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &params.width, &params.height) == 2)
+                break;
+            usage(argv[0]);
+            return 1;
+        case 'r':
+            if (sscanf(optarg, "%ux%u", &params.roi_width,
+                       &params.roi_height) == 2)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.num_loops == 0 ||
+        params.roi_width == 0 || params.roi_width > params.width ||
+        params.roi_height == 0 || params.roi_height > params.height) {
+        usage(argv[0]);
+        return 1;
+    }
+    return bench_run(&params) < 0;
+}
@@ -0,0 +1,211 @@
+/*
+ *  bench_object_heap.c - VDPAU backend for VA-API (object heap benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "object_heap.h"
+#include "utils.h"
+#include <unistd.h>
+
+/* Measures object_heap_lookup() from N threads, while the same threads
+ * allocate and free objects of the heap, as decode threads do with VA
+ * buffers while they look up surfaces and buffers. Lookups go to a set
+ * of objects that stay allocated, and to the ID of an object that was
+ * just freed, which must fail.
+ */
+
+typedef struct {
+    struct object_base  base;
+    unsigned int        payload;
+} bench_object_t;
+
+typedef struct {
+    unsigned int        num_objects;
+    unsigned int        num_lookups;
+    unsigned int        lookups_per_alloc;
+} bench_params_t;
+
+typedef struct {
+    pthread_t             thread;
+    const bench_params_t *params;
+    object_heap_p         heap;
+    const int            *ids;
+    unsigned int          seed;
+    uint64_t              num_lookups;
+    uint64_t              num_allocs;
+    int                   error;
+} bench_thread_t;
+
+static void *
+bench_thread(void *arg)
+{
+    bench_thread_t * const t = arg;
+    const bench_params_t * const params = t->params;
+    bench_object_t *obj;
+    unsigned int i, j, seed = t->seed;
+    int id;
+
+    for (i = 0; i < params->num_lookups; i += params->lookups_per_alloc) {
+        for (j = 0; j < params->lookups_per_alloc; j++) {
+            seed = seed * 1103515245 + 12345;
+            id = t->ids[(seed >> 16) % params->num_objects];
+            obj = (bench_object_t *)object_heap_lookup(t->heap, id);
+            if (!obj || obj->payload != (unsigned int)id) {
+                t->error = 1;
+                return NULL;
+            }
+        }
+        t->num_lookups += j;
+
+        id = object_heap_allocate(t->heap);
+        obj = (bench_object_t *)object_heap_lookup(t->heap, id);
+        if (!obj) {
+            t->error = 1;
+            return NULL;
+        }
+        object_heap_free(t->heap, &obj->base);
+        if (object_heap_lookup(t->heap, id)) {
+            t->error = 1;
+            return NULL;
+        }
+        t->num_lookups += 2;
+        t->num_allocs++;
+    }
+    return NULL;
+}
+
+// Runs the benchmark with NUM_THREADS threads
+static int
+bench_run(const bench_params_t *params, unsigned int num_threads)
+{
+    struct object_heap heap;
+    bench_thread_t *threads;
+    bench_object_t *obj;
+    uint64_t start, elapsed, num_lookups = 0, num_allocs = 0;
+    unsigned int i;
+    int *ids, ret = -1;
+
+    ids     = malloc(params->num_objects * sizeof(*ids));
+    threads = calloc(num_threads, sizeof(*threads));
+    if (!ids || !threads || object_heap_init(&heap, sizeof(*obj), 0x04000000) < 0)
+        goto end;
+
+    for (i = 0; i < params->num_objects; i++) {
+        ids[i] = object_heap_allocate(&heap);
+        obj = (bench_object_t *)object_heap_lookup(&heap, ids[i]);
+        if (!obj)
+            goto end;
+        obj->payload = ids[i];
+    }
+
+    start = get_ticks_usec();
+    for (i = 0; i < num_threads; i++) {
+        threads[i].params = params;
+        threads[i].heap   = &heap;
+        threads[i].ids    = ids;
+        threads[i].seed   = i + 1;
+        if (pthread_create(&threads[i].thread, NULL, bench_thread,
+                           &threads[i]) != 0) {
+            num_threads = i;
+            break;
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        if (threads[i].error)
+            fprintf(stderr, "thread %u: lookup failed\n", i);
+        num_lookups += threads[i].num_lookups;
+        num_allocs  += threads[i].num_allocs;
+    }
+    elapsed = get_ticks_usec() - start;
+
+    printf("%2u threads %12.0f lookups/s %12.0f allocs/s\n", num_threads,
+           elapsed > 0 ? (double)num_lookups * 1e6 / elapsed : 0.0,
+           elapsed > 0 ? (double)num_allocs * 1e6 / elapsed : 0.0);
+
+    ret = 0;
+    for (i = 0; i < num_threads; i++) {
+        if (threads[i].error)
+            ret = -1;
+    }
+    for (i = 0; i < params->num_objects; i++) {
+        obj = (bench_object_t *)object_heap_lookup(&heap, ids[i]);
+        object_heap_free(&heap, &obj->base);
+    }
+    object_heap_destroy(&heap);
+
+end:
+    free(threads);
+    free(ids);
+    return ret;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-t THREADS] [-n LOOKUPS] [-o OBJECTS] [-a LOOKUPS]\n"
+            "  -t THREADS  maximum number of threads (default 8)\n"
+            "  -n LOOKUPS  lookups per thread (default 10000000)\n"
+            "  -o OBJECTS  objects looked up (default 64)\n"
+            "  -a LOOKUPS  lookups per allocate/free (default 16)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    unsigned int num_threads, max_threads = 8;
+    int opt;
+
+    params.num_objects       = 64;
+    params.num_lookups       = 10000000;
+    params.lookups_per_alloc = 16;
+
+    while ((opt = getopt(argc, argv, "t:n:o:a:h")) != -1) {
+        switch (opt) {
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'n':
+            params.num_lookups = atoi(optarg);
+            break;
+        case 'o':
+            params.num_objects = atoi(optarg);
+            break;
+        case 'a':
+            params.lookups_per_alloc = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_threads == 0 || params.num_lookups == 0 ||
+        params.num_objects == 0 || params.lookups_per_alloc == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        if (bench_run(&params, num_threads) < 0)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ *  bench_rgba.c - VDPAU backend for VA-API (RGBA readback benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* Measures vaGetImage() of a BGRA image from an NV12 surface, converted
+ * on the CPU from an NV12 readback (VDPAU_VIDEO_CPU_RGBA=1) against a
+ * round trip through the video mixer and an RGBA output surface. The
+ * setting is read once per process, so each runs in a child process.
+ * The CPU path keeps its NV12 readback until the surface changes, so
+ * both are measured with and without a vaPutImage() before each
+ * readback (not counted).
+ */
+
+typedef struct {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        num_loops;
+} bench_params_t;
+
+// Finds the image format with the given FOURCC
+static int
+get_image_format(tool_driver_t *drv, uint32_t fourcc, VAImageFormat *format)
+{
+    VAImageFormat *formats;
+    int i, num_formats = 0, ret = -1;
+
+    formats = calloc(drv->ctx->max_image_formats, sizeof(*formats));
+    if (!formats)
+        return -1;
+    if (tool_check_status(VA_CALL(drv, QueryImageFormats, formats,
+                                  &num_formats), "vaQueryImageFormats()")) {
+        for (i = 0; i < num_formats; i++) {
+            if (formats[i].fourcc == fourcc) {
+                *format = formats[i];
+                ret = 0;
+                break;
+            }
+        }
+    }
+    if (ret < 0)
+        fprintf(stderr, "driver has no %.4s image format\n",
+                (const char *)&fourcc);
+    free(formats);
+    return ret;
+}
+
+// Times NUM_LOOPS readbacks of the surface to RGBA_IMAGE, each after
+// putting DIRTY_IMAGE to the surface if not NULL
+static int
+bench_readback(
+    tool_driver_t        *drv,
+    const bench_params_t *params,
+    const char           *name,
+    VASurfaceID           surface,
+    const VAImage        *rgba_image,
+    const VAImage        *dirty_image
+)
+{
+    uint64_t start, elapsed = 0;
+    unsigned int i;
+    VAStatus status;
+
+    for (i = 0; i < params->num_loops; i++) {
+        if (dirty_image) {
+            status = VA_CALL(drv, PutImage, surface, dirty_image->image_id,
+                             0, 0, dirty_image->width, dirty_image->height,
+                             0, 0, dirty_image->width, dirty_image->height);
+            if (!tool_check_status(status, "vaPutImage()"))
+                return -1;
+            VA_CALL(drv, SyncSurface, surface);
+        }
+
+        start = get_ticks_usec();
+        status = VA_CALL(drv, GetImage, surface, 0, 0,
+                         rgba_image->width, rgba_image->height,
+                         rgba_image->image_id);
+        if (!tool_check_status(status, "vaGetImage()"))
+            return -1;
+        elapsed += get_ticks_usec() - start;
+    }
+
+    printf("%-28s %5ux%-5u %9.1f us %9.1f Mpixels/s\n", name,
+           rgba_image->width, rgba_image->height,
+           (double)elapsed / params->num_loops,
+           elapsed > 0 ? (double)params->num_loops * rgba_image->width *
+           rgba_image->height / elapsed : 0.0);
+    return 0;
+}
+
+static int
+bench_run(const bench_params_t *params, const char *label)
+{
+    tool_driver_t drv;
+    VAImageFormat nv12_format, rgba_format;
+    VASurfaceID surface = VA_INVALID_SURFACE;
+    VAImage nv12_image, rgba_image;
+    char name[64];
+    int ret = -1;
+
+    nv12_image.image_id = VA_INVALID_ID;
+    rgba_image.image_id = VA_INVALID_ID;
+
+    if (tool_driver_open(&drv) < 0)
+        return -1;
+    if (get_image_format(&drv, VA_FOURCC('N','V','1','2'), &nv12_format) < 0 ||
+        get_image_format(&drv, VA_FOURCC('B','G','R','A'), &rgba_format) < 0)
+        goto end;
+
+    if (!tool_check_status(VA_CALL(&drv, CreateSurfaces,
+                                   params->width, params->height,
+                                   VA_RT_FORMAT_YUV420, 1, &surface),
+                           "vaCreateSurfaces()") ||
+        !tool_check_status(VA_CALL(&drv, CreateImage, &nv12_format,
+                                   params->width, params->height,
+                                   &nv12_image), "vaCreateImage()") ||
+        !tool_check_status(VA_CALL(&drv, CreateImage, &rgba_format,
+                                   params->width, params->height,
+                                   &rgba_image), "vaCreateImage()") ||
+        !tool_check_status(VA_CALL(&drv, PutImage, surface,
+                                   nv12_image.image_id,
+                                   0, 0, params->width, params->height,
+                                   0, 0, params->width, params->height),
+                           "vaPutImage()"))
+        goto end;
+
+    snprintf(name, sizeof(name), "vaGetImage() %s", label);
+    if (bench_readback(&drv, params, name, surface, &rgba_image, NULL) < 0)
+        goto end;
+    snprintf(name, sizeof(name), "vaGetImage() %s, dirty", label);
+    if (bench_readback(&drv, params, name, surface, &rgba_image,
+                       &nv12_image) < 0)
+        goto end;
+    ret = 0;
+
+end:
+    if (rgba_image.image_id != VA_INVALID_ID)
+        VA_CALL(&drv, DestroyImage, rgba_image.image_id);
+    if (nv12_image.image_id != VA_INVALID_ID)
+        VA_CALL(&drv, DestroyImage, nv12_image.image_id);
+    if (surface != VA_INVALID_SURFACE)
+        VA_CALL(&drv, DestroySurfaces, &surface, 1);
+    tool_driver_close(&drv);
+    return ret;
+}
+
+// Runs the benchmark in a child process with the given CPU RGBA setting
+static int
+bench_fork(const bench_params_t *params, const char *cpu_rgba,
+           const char *label)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        setenv("VDPAU_VIDEO_CPU_RGBA", cpu_rgba, 1);
+        exit(bench_run(params, label) < 0);
+    }
+    if (waitpid(pid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return 0;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n LOOPS] [-s WIDTHxHEIGHT]\n"
+            "  -n LOOPS  readbacks per measurement (default 100)\n"
+            "  -s SIZE   surface size (default 1920x1080)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    int opt;
+
+    params.width     = 1920;
+    params.height    = 1080;
+    params.num_loops = 100;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            params.num_loops = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &params.width, &params.height) == 2)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.num_loops == 0 || params.width == 0 || params.height == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (bench_fork(&params, "yes", "CPU") < 0 ||
+        bench_fork(&params, "no",  "mixer") < 0)
+        return 1;
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ *  bench_startcode.c - VDPAU backend for VA-API (start code scan benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+
+#include "sysdeps.h"
+#include "startcode.h"
+#include "utils.h"
+#include <unistd.h>
+
+/* Measures the throughput of startcode_find() against a byte-by-byte
+ * scan, on slice data without start codes, and the cost of
+ * startcode_check_leading() on slices that begin with a start code and
+ * on slices that do not. The latter only looks at the leading bytes.
+ */
+
+static volatile unsigned int g_sink;
+
+// Fills BUF with random bytes, with emulation prevention applied
+static void
+fill_slice_data(uint8_t *buf, unsigned int size)
+{
+    unsigned int i, seed = 1;
+
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = seed >> 16;
+        /* Make zero bytes as frequent as in CABAC data, about 1 in 64 */
+        if ((buf[i] & 0x3f) == 0)
+            buf[i] = 0;
+        if (i >= 2 && buf[i - 2] == 0 && buf[i - 1] == 0 && buf[i] <= 3)
+            buf[i] = 3;
+    }
+}
+
+// Returns the offset of the first start code prefix, one byte at a time
+static unsigned int
+startcode_find_bytewise(const uint8_t *buf, unsigned int size)
+{
+    unsigned int i;
+
+    for (i = 0; i + 2 < size; i++) {
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
+            return i;
+    }
+    return size;
+}
+
+typedef unsigned int (*startcode_find_func)(const uint8_t *, unsigned int);
+
+// Prints the scan throughput of FUNC over NUM_BYTES bytes in chunks of SIZE
+static void
+bench_find(const char *name, startcode_find_func func,
+           const uint8_t *buf, unsigned int size, uint64_t num_bytes)
+{
+    uint64_t i, n = num_bytes / size, start, elapsed;
+    unsigned int sink = 0;
+
+    start = get_ticks_usec();
+    for (i = 0; i < n; i++)
+        sink += func(buf, size);
+    elapsed = get_ticks_usec() - start;
+    g_sink = sink;
+
+    printf("%-32s %8u bytes %8.2f GB/s\n", name, size,
+           elapsed > 0 ? (double)n * size / (elapsed * 1e3) : 0.0);
+}
+
+// Prints the cost of startcode_check_leading() on slices of SIZE bytes
+static void
+bench_check_leading(const char *name, const uint8_t *buf, unsigned int size,
+                    uint64_t num_bytes)
+{
+    uint64_t i, n = num_bytes / size, start, elapsed;
+    unsigned int sink = 0;
+
+    start = get_ticks_usec();
+    for (i = 0; i < n; i++)
+        sink += startcode_check_leading(buf, size);
+    elapsed = get_ticks_usec() - start;
+    g_sink = sink;
+
+    printf("%-32s %8u bytes %10.1f ns/slice\n", name, size,
+           (double)elapsed * 1e3 / n);
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-m MBYTES]\n"
+            "  -m MBYTES  megabytes scanned per measurement (default 1024)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int slice_sizes[] = { 256, 4096, 65536, 1 << 20 };
+    uint64_t num_bytes = 1024 << 20;
+    uint8_t *buf, *slice;
+    unsigned int i, size;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            num_bytes = (uint64_t)atoi(optarg) << 20;
+            if (num_bytes > 0)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    size = slice_sizes[ARRAY_ELEMS(slice_sizes) - 1];
+    buf = malloc(size + 4);
+    if (!buf)
+        return 1;
+
+    /* BUF + 4 holds slice data without start code, BUF a NAL unit with one */
+    slice = buf + 4;
+    fill_slice_data(slice, size);
+    buf[0] = 0x00;
+    buf[1] = 0x00;
+    buf[2] = 0x01;
+    buf[3] = 0x65;
+    if (startcode_find(slice, size) != size) {
+        fprintf(stderr, "generated slice data has a start code\n");
+        free(buf);
+        return 1;
+    }
+
+    for (i = 0; i < ARRAY_ELEMS(slice_sizes); i++)
+        bench_find("startcode_find() bytewise", startcode_find_bytewise,
+                   slice, slice_sizes[i], num_bytes);
+    for (i = 0; i < ARRAY_ELEMS(slice_sizes); i++)
+        bench_find("startcode_find()", startcode_find,
+                   slice, slice_sizes[i], num_bytes);
+    for (i = 0; i < ARRAY_ELEMS(slice_sizes); i++)
+        bench_check_leading("check_leading() start code",
+                            buf, slice_sizes[i], num_bytes);
+    for (i = 0; i < ARRAY_ELEMS(slice_sizes); i++)
+        bench_check_leading("check_leading() no start code",
+                            slice, slice_sizes[i], num_bytes);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ *  bench_surface_pool.c - VDPAU backend for VA-API (surface churn benchmark)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+
+/* Measures the cost of vaCreateSurfaces() / vaDestroySurfaces() churn,
+ * as seen with players that re-create their decode surfaces on every
+ * seek or resolution change, with the VDPAU surface pool enabled and
+ * disabled (VDPAU_VIDEO_SURFACE_POOL_SIZE=0). The driver is reloaded
+ * for each run since the pool settings are read at vaInitialize().
+ */
+
+typedef struct {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        num_surfaces;
+    unsigned int        num_loops;
+} bench_params_t;
+
+// Runs the churn loop with the given pool size (NULL: driver default)
+static int
+bench_churn(const bench_params_t *params, const char *pool_size)
+{
+    tool_driver_t drv;
+    VASurfaceID *surfaces;
+    uint64_t start, elapsed, max_time = 0;
+    unsigned int i;
+    int ret = -1;
+
+    if (pool_size)
+        setenv("VDPAU_VIDEO_SURFACE_POOL_SIZE", pool_size, 1);
+    else
+        unsetenv("VDPAU_VIDEO_SURFACE_POOL_SIZE");
+
+    surfaces = malloc(params->num_surfaces * sizeof(*surfaces));
+    if (!surfaces)
+        return -1;
+    if (tool_driver_open(&drv) < 0) {
+        free(surfaces);
+        return -1;
+    }
+
+    start = get_ticks_usec();
+    for (i = 0; i <= params->num_loops; i++) {
+        uint64_t t = get_ticks_usec();
+        VAStatus status;
+
+        /* The first round fills the pool and is not counted */
+        if (i == 1)
+            start = t;
+
+        status = VA_CALL(&drv, CreateSurfaces,
+                         params->width, params->height, VA_RT_FORMAT_YUV420,
+                         params->num_surfaces, surfaces);
+        if (!tool_check_status(status, "vaCreateSurfaces()"))
+            goto end;
+        status = VA_CALL(&drv, DestroySurfaces,
+                         surfaces, params->num_surfaces);
+        if (!tool_check_status(status, "vaDestroySurfaces()"))
+            goto end;
+
+        t = get_ticks_usec() - t;
+        if (i > 0 && max_time < t)
+            max_time = t;
+    }
+    elapsed = get_ticks_usec() - start;
+
+    printf("pool size %-8s %8.2f us per surface, %10.0f surfaces/s "
+           "(max %llu us per batch)\n",
+           pool_size ? pool_size : "default",
+           (double)elapsed / (params->num_loops * params->num_surfaces),
+           elapsed > 0 ?
+           params->num_loops * params->num_surfaces * 1e6 / elapsed : 0.0,
+           (unsigned long long)max_time);
+    ret = 0;
+
+end:
+    tool_driver_close(&drv);
+    free(surfaces);
+    return ret;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n LOOPS] [-c COUNT] [-s WIDTHxHEIGHT]\n"
+            "  -n LOOPS  number of create/destroy rounds (default 1000)\n"
+            "  -c COUNT  surfaces created per round (default 16)\n"
+            "  -s SIZE   surface size (default 1920x1080)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_params_t params;
+    int opt;
+
+    params.width        = 1920;
+    params.height       = 1080;
+    params.num_surfaces = 16;
+    params.num_loops    = 1000;
+
+    while ((opt = getopt(argc, argv, "n:c:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            params.num_loops = atoi(optarg);
+            break;
+        case 'c':
+            params.num_surfaces = atoi(optarg);
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &params.width, &params.height) == 2)
+                break;
+            /* fall-through */
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (params.num_loops == 0 || params.num_surfaces == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%u rounds of %u surfaces of %ux%u\n", params.num_loops,
+           params.num_surfaces, params.width, params.height);
+    if (bench_churn(&params, NULL) < 0 ||
+        bench_churn(&params, "0") < 0)
+        return 1;
+    return 0;
+}
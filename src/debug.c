@@ -21,6 +21,7 @@
 #include "sysdeps.h"
 #include "debug.h"
 #include "utils.h"
+#include "vdpau_trace.h"
 #include <stdarg.h>
 
 static void do_vfprintf(FILE *fp, const char *msg, va_list args)
@@ -59,7 +60,7 @@ void vdpau_information_message(const char *msg, ...)
     va_end(args);
 }
 
-static int debug_enabled(void)
+int debug_enabled(void)
 {
     static int g_debug_enabled = -1;
     if (g_debug_enabled < 0) {
@@ -83,14 +84,14 @@ void debug_message(const char *msg, ...)
 }
 
 static int g_trace_is_new_line  = 1;
-static int g_trace_indent       = 0;
+static __thread int g_trace_indent;
 
 int trace_enabled(void)
 {
     static int g_trace_enabled = -1;
     if (g_trace_enabled < 0) {
         if (getenv_yesno("VDPAU_VIDEO_TRACE", &g_trace_enabled) < 0)
-            g_trace_enabled = 0;
+            g_trace_enabled = trace_file_requested();
     }
     return g_trace_enabled;
 }
@@ -114,6 +115,13 @@ void trace_print(const char *format, ...)
 {
     va_list args;
 
+    if (trace_file_enabled()) {
+        va_start(args, format);
+        trace_record(g_trace_indent, format, args);
+        va_end(args);
+        return;
+    }
+
     if (g_trace_is_new_line) {
         int i, j, n;
         printf("%s: ", PACKAGE_NAME);
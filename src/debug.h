@@ -30,6 +30,10 @@ void vdpau_information_message(const char *msg, ...)
 void debug_message(const char *msg, ...)
     attribute_hidden;
 
+// Returns TRUE if debug messages are enabled
+int debug_enabled(void)
+    attribute_hidden;
+
 #if DEBUG && USE_DEBUG
 # define D(x) x
 # define bug debug_message
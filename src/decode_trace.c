@@ -0,0 +1,492 @@
+/*
+ *  decode_trace.c - VDPAU backend for VA-API (binary trace decoder)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+
+#include "sysdeps.h"
+#include "vdpau_trace.h"
+#include <unistd.h>
+
+/* Turns a trace recorded with VDPAU_VIDEO_TRACE_FILE back into text,
+ * one line per trace line with its time and thread, or into trace
+ * events (JSON) to be opened in chrome://tracing or ui.perfetto.dev.
+ * Lines are sorted by time, since the rings of the threads are
+ * written out one after the other.
+ */
+
+typedef struct {
+    char               *str;
+    size_t              len;
+    int                 complete;
+} trace_string_t;
+
+typedef struct {
+    uint64_t            timestamp;
+    unsigned int        seq;
+    unsigned int        thread;
+    unsigned int        indent;
+    char               *text;
+} trace_line_t;
+
+/* Line being assembled from the records of a thread */
+typedef struct {
+    uint64_t            timestamp;
+    unsigned int        indent;
+    char               *text;
+    size_t              len;
+    size_t              len_max;
+} trace_thread_t;
+
+typedef struct {
+    trace_string_t     *strings;
+    unsigned int        num_strings;
+    trace_thread_t     *threads;
+    unsigned int        num_threads;
+    trace_line_t       *lines;
+    unsigned int        num_lines;
+    unsigned int        num_lines_max;
+    uint64_t            num_dropped;
+    uint64_t            start_time;
+} trace_t;
+
+static void *
+grow_array(void *array, unsigned int *num_max, unsigned int num, size_t size)
+{
+    if (num < *num_max)
+        return array;
+    *num_max = MAX(2 * *num_max, MAX(num + 1, 16));
+    array = realloc(array, *num_max * size);
+    if (!array) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return array;
+}
+
+static void
+append_text(trace_thread_t *thread, const char *str, size_t len)
+{
+    if (thread->len + len + 1 > thread->len_max) {
+        thread->len_max = MAX(2 * thread->len_max, thread->len + len + 64);
+        thread->text = realloc(thread->text, thread->len_max);
+        if (!thread->text) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(thread->text + thread->len, str, len);
+    thread->len += len;
+    thread->text[thread->len] = '\0';
+}
+
+static trace_string_t *
+get_string(trace_t *trace, unsigned int id)
+{
+    unsigned int num_strings = trace->num_strings;
+
+    if (id >= num_strings) {
+        trace->strings = grow_array(trace->strings, &num_strings, id,
+                                    sizeof(*trace->strings));
+        memset(&trace->strings[trace->num_strings], 0,
+               (num_strings - trace->num_strings) * sizeof(*trace->strings));
+        trace->num_strings = num_strings;
+    }
+    return &trace->strings[id];
+}
+
+static trace_thread_t *
+get_thread(trace_t *trace, unsigned int thread)
+{
+    unsigned int num_threads = trace->num_threads;
+
+    if (thread >= num_threads) {
+        trace->threads = grow_array(trace->threads, &num_threads, thread,
+                                    sizeof(*trace->threads));
+        memset(&trace->threads[trace->num_threads], 0,
+               (num_threads - trace->num_threads) * sizeof(*trace->threads));
+        trace->num_threads = num_threads;
+    }
+    return &trace->threads[thread];
+}
+
+// Appends a line to the output, taking ownership of TEXT
+static void
+add_line(trace_t *trace, uint64_t timestamp, unsigned int thread,
+         unsigned int indent, char *text)
+{
+    trace_line_t *line;
+
+    trace->lines = grow_array(trace->lines, &trace->num_lines_max,
+                              trace->num_lines, sizeof(*trace->lines));
+    line = &trace->lines[trace->num_lines];
+    line->timestamp = timestamp;
+    line->seq       = trace->num_lines++;
+    line->thread    = thread;
+    line->indent    = indent;
+    line->text      = text;
+}
+
+// Emits the line assembled for THREAD, if any
+static void
+flush_thread(trace_t *trace, unsigned int thread_id)
+{
+    trace_thread_t * const thread = get_thread(trace, thread_id);
+
+    if (thread->len == 0)
+        return;
+    add_line(trace, thread->timestamp, thread_id, thread->indent,
+             thread->text);
+    thread->text    = NULL;
+    thread->len     = 0;
+    thread->len_max = 0;
+}
+
+// Formats RECORD the way trace_print() would have, see trace_parse_format()
+static void
+format_record(trace_t *trace, const vdpau_trace_record_t *record,
+              trace_thread_t *thread)
+{
+    const trace_string_t * const format = get_string(trace, record->id);
+    const char *p, *q;
+    char spec[32], buf[256];
+    unsigned int n = 0, num_longs, spec_len;
+    double value;
+    int len;
+
+    if (!format->complete) {
+        append_text(thread, "<unknown>", 9);
+        return;
+    }
+
+    for (p = format->str; *p; p = q) {
+        if (*p != '%') {
+            q = strchr(p, '%');
+            if (!q)
+                q = p + strlen(p);
+            append_text(thread, p, q - p);
+            continue;
+        }
+        if (p[1] == '%' || n >= record->num_args) {
+            /* Conversions past the recorded arguments are kept as is */
+            append_text(thread, "%", 1);
+            q = p + (p[1] == '%' ? 2 : 1);
+            continue;
+        }
+
+        /* Copy flags, width and precision, drop length modifiers */
+        spec[0] = '%';
+        spec_len = 1;
+        num_longs = 0;
+        for (q = p + 1; *q && strchr("#0- +'123456789.lhzjt", *q); q++) {
+            if (*q == 'l')
+                num_longs++;
+            else if (!strchr("hzjt", *q) && spec_len < sizeof(spec) - 4)
+                spec[spec_len++] = *q;
+        }
+        if (!*q)
+            break;
+
+        switch (*q) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (num_longs > 0)
+                spec[spec_len++] = 'l';
+            if (num_longs > 1)
+                spec[spec_len++] = 'l';
+            spec[spec_len++] = *q;
+            spec[spec_len] = '\0';
+            if (num_longs > 1)
+                len = snprintf(buf, sizeof(buf), spec,
+                               (unsigned long long)record->args[n]);
+            else if (num_longs == 1)
+                len = snprintf(buf, sizeof(buf), spec,
+                               (unsigned long)record->args[n]);
+            else
+                len = snprintf(buf, sizeof(buf), spec,
+                               (unsigned int)record->args[n]);
+            break;
+        case 'p':
+            spec[spec_len++] = 'p';
+            spec[spec_len] = '\0';
+            len = snprintf(buf, sizeof(buf), spec,
+                           (void *)(uintptr_t)record->args[n]);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+            spec[spec_len++] = *q;
+            spec[spec_len] = '\0';
+            memcpy(&value, &record->args[n], sizeof(value));
+            len = snprintf(buf, sizeof(buf), spec, value);
+            break;
+        case 's': {
+            const trace_string_t * const str =
+                get_string(trace, record->args[n]);
+            spec[spec_len++] = 's';
+            spec[spec_len] = '\0';
+            len = snprintf(buf, sizeof(buf), spec,
+                           str->complete ? str->str : "<unknown>");
+            break;
+        }
+        default:
+            /* trace_parse_format() stopped there too */
+            append_text(thread, p, strlen(p));
+            return;
+        }
+        append_text(thread, buf, MIN((size_t)MAX(len, 0), sizeof(buf) - 1));
+        n++;
+        q++;
+    }
+}
+
+// Adds the text of a PRINT record to the line of its thread
+static void
+add_print(trace_t *trace, const vdpau_trace_record_t *record)
+{
+    trace_thread_t * const thread = get_thread(trace, record->thread);
+    char *line, *eol;
+    size_t len;
+
+    if (thread->len == 0) {
+        thread->timestamp = record->timestamp;
+        thread->indent    = record->indent;
+    }
+    format_record(trace, record, thread);
+
+    /* Split complete lines off */
+    while (thread->text && (eol = strchr(thread->text, '\n')) != NULL) {
+        len  = eol - thread->text;
+        line = malloc(len + 1);
+        if (!line) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        memcpy(line, thread->text, len);
+        line[len] = '\0';
+        add_line(trace, thread->timestamp, record->thread, thread->indent,
+                 line);
+        thread->len -= len + 1;
+        memmove(thread->text, eol + 1, thread->len + 1);
+        thread->timestamp = record->timestamp;
+        thread->indent    = record->indent;
+    }
+}
+
+// Adds a STRING record to the string table
+static void
+add_string(trace_t *trace, const vdpau_trace_record_t *record)
+{
+    trace_string_t * const string = get_string(trace, record->id);
+    const char * const chunk = (const char *)record->args;
+    size_t len;
+
+    /* A string ID is only defined once, but chunks may be repeated */
+    if (string->complete)
+        return;
+
+    len = strnlen(chunk, sizeof(record->args));
+    string->str = realloc(string->str, string->len + len + 1);
+    if (!string->str) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(string->str + string->len, chunk, len);
+    string->len += len;
+    string->str[string->len] = '\0';
+    string->complete = len < sizeof(record->args);
+}
+
+static int
+compare_lines(const void *a, const void *b)
+{
+    const trace_line_t * const la = a;
+    const trace_line_t * const lb = b;
+
+    if (la->timestamp != lb->timestamp)
+        return la->timestamp < lb->timestamp ? -1 : 1;
+    return la->seq < lb->seq ? -1 : la->seq > lb->seq;
+}
+
+// Reads all records of FP, returns 0 on success
+static int
+read_trace(trace_t *trace, FILE *fp, const char *filename)
+{
+    vdpau_trace_record_t record;
+    char magic[8];
+    uint32_t header[2];
+    unsigned int i;
+
+    if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+        memcmp(magic, VDPAU_TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(header), 1, fp) != 1) {
+        fprintf(stderr, "%s: not a trace file\n", filename);
+        return -1;
+    }
+    if (header[0] != VDPAU_TRACE_VERSION || header[1] != sizeof(record)) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", filename,
+                header[0]);
+        return -1;
+    }
+
+    trace->start_time = UINT64_MAX;
+    while (fread(&record, sizeof(record), 1, fp) == 1) {
+        switch (record.type) {
+        case VDPAU_TRACE_RECORD_STRING:
+            add_string(trace, &record);
+            break;
+        case VDPAU_TRACE_RECORD_PRINT:
+            trace->start_time = MIN(trace->start_time, record.timestamp);
+            add_print(trace, &record);
+            break;
+        case VDPAU_TRACE_RECORD_DROPPED: {
+            char * const line = malloc(64);
+            if (!line)
+                return -1;
+            flush_thread(trace, record.thread);
+            snprintf(line, 64, "<%llu records dropped>",
+                     (unsigned long long)record.args[0]);
+            add_line(trace, record.timestamp, record.thread, 0, line);
+            trace->num_dropped += record.args[0];
+            break;
+        }
+        default:
+            fprintf(stderr, "%s: unknown record type %u\n", filename,
+                    record.type);
+            return -1;
+        }
+    }
+    for (i = 0; i < trace->num_threads; i++)
+        flush_thread(trace, i);
+    if (trace->start_time == UINT64_MAX)
+        trace->start_time = 0;
+
+    qsort(trace->lines, trace->num_lines, sizeof(*trace->lines),
+          compare_lines);
+    return 0;
+}
+
+static void
+print_text(const trace_t *trace)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < trace->num_lines; i++) {
+        const trace_line_t * const line = &trace->lines[i];
+        printf("%12.6f %3u: ",
+               (line->timestamp - MIN(line->timestamp, trace->start_time)) / 1e9,
+               line->thread);
+        for (j = 0; j < line->indent; j++)
+            printf("    ");
+        printf("%s\n", line->text);
+    }
+}
+
+static void
+print_json_string(const char *str)
+{
+    putchar('"');
+    for (; *str; str++) {
+        const unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+// Prints each line as an instant event on the track of its thread
+static void
+print_json(const trace_t *trace)
+{
+    unsigned int i;
+
+    printf("{\"traceEvents\":[\n");
+    for (i = 0; i < trace->num_lines; i++) {
+        const trace_line_t * const line = &trace->lines[i];
+        printf("%s{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+               "\"ts\":%.3f,\"name\":", i > 0 ? ",\n" : "", line->thread,
+               (line->timestamp - MIN(line->timestamp, trace->start_time)) / 1e3);
+        print_json_string(line->text);
+        printf(",\"args\":{\"indent\":%u}}", line->indent);
+    }
+    printf("\n]}\n");
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-j] TRACE-FILE\n"
+            "  -j  print trace events (JSON) instead of text\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    trace_t trace;
+    FILE *fp;
+    unsigned int i;
+    int opt, json = 0, ret;
+
+    while ((opt = getopt(argc, argv, "jh")) != -1) {
+        switch (opt) {
+        case 'j':
+            json = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    fp = fopen(argv[optind], "rb");
+    if (!fp) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    memset(&trace, 0, sizeof(trace));
+    ret = read_trace(&trace, fp, argv[optind]);
+    fclose(fp);
+    if (ret == 0) {
+        if (json)
+            print_json(&trace);
+        else
+            print_text(&trace);
+        if (trace.num_dropped > 0)
+            fprintf(stderr, "%llu records were dropped\n",
+                    (unsigned long long)trace.num_dropped);
+    }
+
+    for (i = 0; i < trace.num_lines; i++)
+        free(trace.lines[i].text);
+    for (i = 0; i < trace.num_threads; i++)
+        free(trace.threads[i].text);
+    for (i = 0; i < trace.num_strings; i++)
+        free(trace.strings[i].str);
+    free(trace.lines);
+    free(trace.threads);
+    free(trace.strings);
+    return ret != 0;
+}
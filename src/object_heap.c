@@ -49,6 +49,26 @@
 #define LAST_FREE   -1
 #define ALLOCATED   -2
 
+/*
+ * Lookups are performed without taking the heap mutex. This works
+ * because the bucket array is allocated once with a fixed capacity
+ * and never moves, buckets are never freed before the heap itself,
+ * and new buckets are published (release) before heap_size grows.
+ * Allocation and release of objects remain serialized by the mutex.
+ */
+#define atomic_load_acquire(p)          __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define atomic_store_release(p, v)      __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/* Returns the object stored in the specified slot */
+static inline object_base_p
+object_heap_slot(object_heap_p heap, int index)
+{
+    int bucket_index = index / heap->heap_increment;
+    int obj_index = index % heap->heap_increment;
+
+    return (object_base_p)(heap->bucket[bucket_index] + obj_index * heap->object_size);
+}
+
 /*
  * Expands the heap
  * Return 0 on success, -1 on error
@@ -63,16 +83,7 @@ object_heap_expand(object_heap_p heap)
     int bucket_index = new_heap_size / heap->heap_increment - 1;
 
     if (bucket_index >= heap->num_buckets) {
-        int new_num_buckets = heap->num_buckets + 8;
-        void **new_bucket;
-
-        new_bucket = realloc(heap->bucket, new_num_buckets * sizeof(void *));
-        if (NULL == new_bucket) {
-            return -1;
-        }
-
-        heap->num_buckets = new_num_buckets;
-        heap->bucket = new_bucket;
+        return -1; /* Heap is full */
     }
 
     new_heap_index = (void *) malloc(heap->heap_increment * heap->object_size);
@@ -80,16 +91,25 @@ object_heap_expand(object_heap_p heap)
         return -1; /* Out of memory */
     }
 
-    heap->bucket[bucket_index] = new_heap_index;
-    next_free = heap->next_free;
+    next_free = LAST_FREE;
     for (i = new_heap_size; i-- > heap->heap_size;) {
         object_base_p obj = (object_base_p)(new_heap_index + (i - heap->heap_size) * heap->object_size);
         obj->id = i + heap->id_offset;
         obj->next_free = next_free;
         next_free = i;
     }
-    heap->next_free = next_free;
-    heap->heap_size = new_heap_size;
+
+    /* Append the new slots to the tail of the free list */
+    if (heap->last_free == LAST_FREE)
+        heap->next_free = next_free;
+    else
+        atomic_store_release(&object_heap_slot(heap, heap->last_free)->next_free,
+                             next_free);
+    heap->last_free = new_heap_size - 1;
+
+    /* Publish the new bucket before making its objects reachable */
+    atomic_store_release(&heap->bucket[bucket_index], new_heap_index);
+    atomic_store_release(&heap->heap_size, new_heap_size);
     return 0; /* Success */
 }
 
@@ -105,8 +125,11 @@ object_heap_init(object_heap_p heap, int object_size, int id_offset)
     heap->heap_size = 0;
     heap->heap_increment = 16;
     heap->next_free = LAST_FREE;
-    heap->num_buckets = 0;
-    heap->bucket = NULL;
+    heap->last_free = LAST_FREE;
+    heap->num_buckets = OBJECT_HEAP_MAX_OBJECTS / heap->heap_increment;
+    heap->bucket = calloc(heap->num_buckets, sizeof(void *));
+    if (!heap->bucket)
+        return -1;
     return object_heap_expand(heap);
 }
 
@@ -118,7 +141,6 @@ static int
 object_heap_allocate_unlocked(object_heap_p heap)
 {
     object_base_p obj;
-    int bucket_index, obj_index;
 
     if (LAST_FREE == heap->next_free) {
         if (-1 == object_heap_expand(heap)) {
@@ -127,12 +149,11 @@ object_heap_allocate_unlocked(object_heap_p heap)
     }
     ASSERT(heap->next_free >= 0);
 
-    bucket_index = heap->next_free / heap->heap_increment;
-    obj_index = heap->next_free % heap->heap_increment;
-
-    obj = (object_base_p)(heap->bucket[bucket_index] + obj_index * heap->object_size);
+    obj = object_heap_slot(heap, heap->next_free);
     heap->next_free = obj->next_free;
-    obj->next_free = ALLOCATED;
+    if (heap->next_free == LAST_FREE)
+        heap->last_free = LAST_FREE;
+    atomic_store_release(&obj->next_free, ALLOCATED);
     return obj->id;
 }
 
@@ -151,35 +172,34 @@ object_heap_allocate(object_heap_p heap)
  * Lookup an object by object ID
  * Returns a pointer to the object on success, returns NULL on error
  */
-static object_base_p
-object_heap_lookup_unlocked(object_heap_p heap, int id)
+object_base_p
+object_heap_lookup(object_heap_p heap, int id)
 {
     object_base_p obj;
-    int bucket_index, obj_index;
+    void *bucket;
+    int index, bucket_index, obj_index;
 
-    if ((id < heap->id_offset) || (id > (heap->heap_size + heap->id_offset))) {
+    if ((id & OBJECT_HEAP_OFFSET_MASK) != heap->id_offset) {
+        return NULL;
+    }
+    index = id & OBJECT_HEAP_ID_MASK;
+    if (index >= atomic_load_acquire(&heap->heap_size)) {
         return NULL;
     }
-    id &= OBJECT_HEAP_ID_MASK;
-    bucket_index = id / heap->heap_increment;
-    obj_index = id % heap->heap_increment;
-    obj = (object_base_p)(heap->bucket[bucket_index] + obj_index * heap->object_size);
+    bucket_index = index / heap->heap_increment;
+    obj_index = index % heap->heap_increment;
+    bucket = atomic_load_acquire(&heap->bucket[bucket_index]);
+    obj = (object_base_p)(bucket + obj_index * heap->object_size);
 
     /* Check if the object has in fact been allocated */
-    if (obj->next_free != ALLOCATED) {
+    if (atomic_load_acquire(&obj->next_free) != ALLOCATED) {
         return NULL;
     }
-    return obj;
-}
-
-object_base_p
-object_heap_lookup(object_heap_p heap, int id)
-{
-    object_base_p obj;
 
-    pthread_mutex_lock(&heap->mutex);
-    obj = object_heap_lookup_unlocked(heap, id);
-    pthread_mutex_unlock(&heap->mutex);
+    /* Check the generation, the slot may have been freed and reused */
+    if (atomic_load_acquire(&obj->id) != id) {
+        return NULL;
+    }
     return obj;
 }
 
@@ -237,11 +257,25 @@ object_heap_next(object_heap_p heap, object_heap_iterator *iter)
 static void
 object_heap_free_unlocked(object_heap_p heap, object_base_p obj)
 {
+    int index, gen;
+
     /* Check if the object has in fact been allocated */
     ASSERT(obj->next_free == ALLOCATED);
 
-    obj->next_free = heap->next_free;
-    heap->next_free = obj->id & OBJECT_HEAP_ID_MASK;
+    /* Bump the generation so that stale IDs no longer resolve */
+    index = obj->id & OBJECT_HEAP_ID_MASK;
+    gen = ((obj->id & OBJECT_HEAP_GEN_MASK) >> OBJECT_HEAP_GEN_SHIFT) + 1;
+    atomic_store_release(&obj->id, heap->id_offset | index |
+                         ((gen << OBJECT_HEAP_GEN_SHIFT) & OBJECT_HEAP_GEN_MASK));
+
+    /* Append the slot to the tail of the free list (FIFO reuse) */
+    atomic_store_release(&obj->next_free, LAST_FREE);
+    if (heap->last_free == LAST_FREE)
+        heap->next_free = index;
+    else
+        atomic_store_release(&object_heap_slot(heap, heap->last_free)->next_free,
+                             index);
+    heap->last_free = index;
 }
 
 void
@@ -284,4 +318,5 @@ object_heap_destroy(object_heap_p heap)
     heap->bucket = NULL;
     heap->heap_size = 0;
     heap->next_free = LAST_FREE;
+    heap->last_free = LAST_FREE;
 }
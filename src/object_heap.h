@@ -24,8 +24,19 @@
 #include <sys/types.h>
 #include <pthread.h>
 
+/*
+ * Object IDs are laid out as follows:
+ *   bits 24-30: heap type (id_offset)
+ *   bits 16-23: slot generation, bumped each time the slot is freed
+ *   bits  0-15: slot index
+ */
 #define OBJECT_HEAP_OFFSET_MASK 0x7f000000
-#define OBJECT_HEAP_ID_MASK     0x00ffffff
+#define OBJECT_HEAP_GEN_MASK    0x00ff0000
+#define OBJECT_HEAP_GEN_SHIFT   16
+#define OBJECT_HEAP_ID_MASK     0x0000ffff
+
+/* Maximum number of objects per heap (fixed bucket array capacity) */
+#define OBJECT_HEAP_MAX_OBJECTS (OBJECT_HEAP_ID_MASK + 1)
 
 typedef struct object_base *object_base_p;
 typedef struct object_heap *object_heap_p;
@@ -40,6 +51,7 @@ struct object_heap {
     int object_size;
     int id_offset;
     int next_free;
+    int last_free;
     int heap_size;
     int heap_increment;
     void **bucket;
@@ -58,6 +70,7 @@ object_heap_init(object_heap_p heap, int object_size, int id_offset)
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
+ * Freed slots are reused in FIFO order
  */
 int object_heap_allocate(object_heap_p heap)
     attribute_hidden;
@@ -65,6 +78,9 @@ int object_heap_allocate(object_heap_p heap)
 /*
  * Lookup an allocated object by object ID
  * Returns a pointer to the object on success, returns NULL on error
+ * This function does not take the heap lock and is safe to call
+ * concurrently with object_heap_allocate() and object_heap_free()
+ * Stale IDs (from a freed and reused slot) are rejected
  */
 object_base_p
 object_heap_lookup(object_heap_p heap, int id)
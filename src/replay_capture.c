@@ -0,0 +1,679 @@
+/*
+ *  replay_capture.c - VDPAU backend for VA-API (decode capture replay)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include "sysdeps.h"
+#include "vdpau_capture.h"
+#include "tool_driver.h"
+#include "utils.h"
+#include <unistd.h>
+#include <time.h>
+
+/* Re-drives a decode session recorded with VDPAU_VIDEO_CAPTURE through
+ * the driver, and reports how long the driver took to accept each
+ * picture. Surface IDs are remapped to the surfaces created for the
+ * replay, including the reference surfaces named in picture and H.264
+ * slice parameters. With VDPAU_VIDEO_SOFTWARE=1, this measures the
+ * driver overhead without a GPU: decoded surfaces keep their contents.
+ * The time spent in vaRenderPicture() is also reported per codec, in
+ * nanoseconds per buffer, as this is where VA buffers are translated.
+ */
+
+enum {
+    REPLAY_CODEC_MPEG2,
+    REPLAY_CODEC_MPEG4,
+    REPLAY_CODEC_H264,
+    REPLAY_CODEC_VC1,
+    REPLAY_CODEC_VP9,
+    REPLAY_CODEC_OTHER,
+    REPLAY_CODEC_COUNT
+};
+
+static const char *replay_codec_names[REPLAY_CODEC_COUNT] = {
+    "MPEG-2", "MPEG-4", "H.264", "VC-1", "VP9", "other"
+};
+
+typedef struct {
+    uint64_t            num_buffers;
+    uint64_t            render_time;
+} replay_codec_t;
+
+typedef struct {
+    VASurfaceID         capture_id;
+    VASurfaceID         surface;
+    unsigned int        width;
+    unsigned int        height;
+} replay_surface_t;
+
+/* Records of several contexts may be interleaved, so the picture in
+ * progress is tracked per context */
+typedef struct {
+    uint32_t            capture_id;
+    VAProfile           profile;
+    VAConfigID          config;
+    VAContextID         context;
+    unsigned int        width;
+    unsigned int        height;
+    VASurfaceID         picture_surface;
+    uint64_t            picture_start;
+    VABufferID         *buffers;
+    unsigned int        num_buffers;
+    unsigned int        num_buffers_max;
+} replay_context_t;
+
+typedef struct {
+    tool_driver_t       drv;
+    FILE               *file;
+    replay_context_t   *contexts;
+    unsigned int        num_contexts;
+    unsigned int        num_contexts_max;
+    replay_surface_t   *surfaces;
+    unsigned int        num_surfaces;
+    unsigned int        num_surfaces_max;
+    uint8_t            *payload;
+    unsigned int        payload_size_max;
+    int                 sync;
+    int                 verbose;
+    unsigned int        num_pictures;
+    unsigned int        num_errors;
+    unsigned int        num_unknown_surfaces;
+    uint64_t            num_bytes;
+    uint64_t            total_time;
+    uint64_t            max_time;
+    replay_codec_t      codecs[REPLAY_CODEC_COUNT];
+} replay_t;
+
+// Returns the codec of the specified profile
+static unsigned int get_codec(VAProfile profile)
+{
+    switch (profile) {
+    case VAProfileMPEG2Simple:
+    case VAProfileMPEG2Main:
+        return REPLAY_CODEC_MPEG2;
+    case VAProfileMPEG4Simple:
+    case VAProfileMPEG4AdvancedSimple:
+    case VAProfileMPEG4Main:
+        return REPLAY_CODEC_MPEG4;
+    case VAProfileH264Baseline:
+    case VAProfileH264Main:
+    case VAProfileH264High:
+        return REPLAY_CODEC_H264;
+    case VAProfileVC1Simple:
+    case VAProfileVC1Main:
+    case VAProfileVC1Advanced:
+        return REPLAY_CODEC_VC1;
+    case VAProfileVP9Profile0:
+        return REPLAY_CODEC_VP9;
+    default:
+        break;
+    }
+    return REPLAY_CODEC_OTHER;
+}
+
+// Returns the monotonic time in nanoseconds
+static uint64_t get_ticks_nsec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static replay_context_t *
+replay_lookup_context(replay_t *replay, uint32_t capture_id)
+{
+    unsigned int i;
+
+    for (i = 0; i < replay->num_contexts; i++) {
+        if (replay->contexts[i].capture_id == capture_id)
+            return &replay->contexts[i];
+    }
+    return NULL;
+}
+
+static replay_surface_t *
+replay_lookup_surface(replay_t *replay, VASurfaceID capture_id)
+{
+    unsigned int i;
+
+    for (i = 0; i < replay->num_surfaces; i++) {
+        if (replay->surfaces[i].capture_id == capture_id)
+            return &replay->surfaces[i];
+    }
+    return NULL;
+}
+
+// Get the replay surface for CAPTURE_ID, created with the given size
+static VASurfaceID
+replay_get_surface(
+    replay_t           *replay,
+    VASurfaceID         capture_id,
+    unsigned int        width,
+    unsigned int        height
+)
+{
+    replay_surface_t *s;
+    VASurfaceID surface;
+
+    s = replay_lookup_surface(replay, capture_id);
+    if (s && s->width == width && s->height == height)
+        return s->surface;
+
+    if (!tool_check_status(VA_CALL(&replay->drv, CreateSurfaces,
+                                   width, height, VA_RT_FORMAT_YUV420,
+                                   1, &surface), "vaCreateSurfaces()"))
+        return VA_INVALID_SURFACE;
+
+    if (s)
+        VA_CALL(&replay->drv, DestroySurfaces, &s->surface, 1);
+    else {
+        s = realloc_buffer((void **)&replay->surfaces,
+                           &replay->num_surfaces_max,
+                           replay->num_surfaces + 1, sizeof(*s));
+        if (!s) {
+            VA_CALL(&replay->drv, DestroySurfaces, &surface, 1);
+            return VA_INVALID_SURFACE;
+        }
+        s = &replay->surfaces[replay->num_surfaces++];
+        s->capture_id = capture_id;
+    }
+    s->surface = surface;
+    s->width   = width;
+    s->height  = height;
+    return surface;
+}
+
+// Replace the captured surface ID at *PID with the replay surface ID
+static void
+replay_remap_surface(replay_t *replay, VASurfaceID *pid)
+{
+    replay_surface_t *s;
+
+    if (*pid == VA_INVALID_SURFACE)
+        return;
+
+    s = replay_lookup_surface(replay, *pid);
+    if (s)
+        *pid = s->surface;
+    else {
+        *pid = VA_INVALID_SURFACE;
+        replay->num_unknown_surfaces++;
+    }
+}
+
+// Remap the surface IDs held in a picture or slice parameter buffer
+static void
+replay_remap_buffer(
+    replay_t           *replay,
+    VAProfile           profile,
+    VABufferType        type,
+    uint8_t            *data,
+    unsigned int        element_size,
+    unsigned int        num_elements
+)
+{
+    unsigned int i, j;
+
+    switch (type) {
+    case VAPictureParameterBufferType:
+        switch (profile) {
+        case VAProfileMPEG2Simple:
+        case VAProfileMPEG2Main: {
+            VAPictureParameterBufferMPEG2 * const p = (void *)data;
+            if (element_size < sizeof(*p))
+                break;
+            replay_remap_surface(replay, &p->forward_reference_picture);
+            replay_remap_surface(replay, &p->backward_reference_picture);
+            break;
+        }
+        case VAProfileMPEG4Simple:
+        case VAProfileMPEG4AdvancedSimple:
+        case VAProfileMPEG4Main: {
+            VAPictureParameterBufferMPEG4 * const p = (void *)data;
+            if (element_size < sizeof(*p))
+                break;
+            replay_remap_surface(replay, &p->forward_reference_picture);
+            replay_remap_surface(replay, &p->backward_reference_picture);
+            break;
+        }
+        case VAProfileH264Baseline:
+        case VAProfileH264Main:
+        case VAProfileH264High: {
+            VAPictureParameterBufferH264 * const p = (void *)data;
+            if (element_size < sizeof(*p))
+                break;
+            replay_remap_surface(replay, &p->CurrPic.picture_id);
+            for (i = 0; i < ARRAY_ELEMS(p->ReferenceFrames); i++)
+                replay_remap_surface(replay, &p->ReferenceFrames[i].picture_id);
+            break;
+        }
+        case VAProfileVC1Simple:
+        case VAProfileVC1Main:
+        case VAProfileVC1Advanced: {
+            VAPictureParameterBufferVC1 * const p = (void *)data;
+            if (element_size < sizeof(*p))
+                break;
+            replay_remap_surface(replay, &p->forward_reference_picture);
+            replay_remap_surface(replay, &p->backward_reference_picture);
+            replay_remap_surface(replay, &p->inloop_decoded_picture);
+            break;
+        }
+        case VAProfileVP9Profile0: {
+            VADecPictureParameterBufferVP9 * const p = (void *)data;
+            if (element_size < sizeof(*p))
+                break;
+            for (i = 0; i < ARRAY_ELEMS(p->reference_frames); i++)
+                replay_remap_surface(replay, &p->reference_frames[i]);
+            break;
+        }
+        default:
+            break;
+        }
+        break;
+    case VASliceParameterBufferType:
+        switch (profile) {
+        case VAProfileH264Baseline:
+        case VAProfileH264Main:
+        case VAProfileH264High:
+            if (element_size < sizeof(VASliceParameterBufferH264))
+                break;
+            for (i = 0; i < num_elements; i++) {
+                VASliceParameterBufferH264 * const p =
+                    (void *)(data + i * element_size);
+                for (j = 0; j < ARRAY_ELEMS(p->RefPicList0); j++)
+                    replay_remap_surface(replay, &p->RefPicList0[j].picture_id);
+                for (j = 0; j < ARRAY_ELEMS(p->RefPicList1); j++)
+                    replay_remap_surface(replay, &p->RefPicList1[j].picture_id);
+            }
+            break;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Destroy the VA context created for a captured one
+static void
+replay_destroy_context(replay_t *replay, replay_context_t *c)
+{
+    unsigned int i;
+
+    for (i = 0; i < c->num_buffers; i++)
+        VA_CALL(&replay->drv, DestroyBuffer, c->buffers[i]);
+    c->num_buffers = 0;
+
+    if (c->context != VA_INVALID_ID)
+        VA_CALL(&replay->drv, DestroyContext, c->context);
+    if (c->config != VA_INVALID_ID)
+        VA_CALL(&replay->drv, DestroyConfig, c->config);
+    c->context = VA_INVALID_ID;
+    c->config  = VA_INVALID_ID;
+}
+
+// VDPAU_CAPTURE_TAG_CONTEXT
+static int
+replay_create_context(
+    replay_t           *replay,
+    uint32_t            capture_id,
+    const uint32_t     *header,
+    unsigned int        size
+)
+{
+    replay_context_t *c;
+    VASurfaceID *render_targets;
+    unsigned int i, num_render_targets;
+    int ok;
+
+    if (size < 5 * sizeof(uint32_t))
+        return 0;
+    num_render_targets = header[4];
+    if (size != (5 + num_render_targets) * sizeof(uint32_t))
+        return 0;
+
+    c = replay_lookup_context(replay, capture_id);
+    if (c)
+        replay_destroy_context(replay, c);
+    else {
+        c = realloc_buffer((void **)&replay->contexts,
+                           &replay->num_contexts_max,
+                           replay->num_contexts + 1, sizeof(*c));
+        if (!c)
+            return 0;
+        c = &replay->contexts[replay->num_contexts++];
+        memset(c, 0, sizeof(*c));
+        c->capture_id = capture_id;
+        c->config     = VA_INVALID_ID;
+        c->context    = VA_INVALID_ID;
+    }
+    c->profile = header[0];
+    c->width   = header[1];
+    c->height  = header[2];
+
+    render_targets = calloc(num_render_targets + 1, sizeof(*render_targets));
+    if (!render_targets)
+        return 0;
+    for (i = 0; i < num_render_targets; i++) {
+        render_targets[i] = replay_get_surface(replay, header[5 + i],
+                                               c->width, c->height);
+        if (render_targets[i] == VA_INVALID_SURFACE) {
+            free(render_targets);
+            return 0;
+        }
+    }
+
+    ok = (tool_check_status(VA_CALL(&replay->drv, CreateConfig, c->profile,
+                                    VAEntrypointVLD, NULL, 0, &c->config),
+                            "vaCreateConfig()") &&
+          tool_check_status(VA_CALL(&replay->drv, CreateContext, c->config,
+                                    c->width, c->height, header[3],
+                                    render_targets, num_render_targets,
+                                    &c->context),
+                            "vaCreateContext()"));
+    free(render_targets);
+    return ok;
+}
+
+// Get the replay context for CAPTURE_ID, for picture records
+static replay_context_t *
+replay_get_picture_context(replay_t *replay, uint32_t capture_id)
+{
+    replay_context_t * const c = replay_lookup_context(replay, capture_id);
+
+    if (!c || c->context == VA_INVALID_ID) {
+        fprintf(stderr, "picture for unknown context 0x%08x\n", capture_id);
+        return NULL;
+    }
+    return c;
+}
+
+// VDPAU_CAPTURE_TAG_BEGIN
+static int
+replay_begin_picture(
+    replay_t           *replay,
+    replay_context_t   *c,
+    const uint32_t     *header,
+    unsigned int        size
+)
+{
+    if (size != 4 * sizeof(uint32_t))
+        return 0;
+
+    c->picture_start   = get_ticks_usec();
+    c->picture_surface = replay_get_surface(replay, header[3],
+                                            c->width, c->height);
+    if (c->picture_surface == VA_INVALID_SURFACE)
+        return 0;
+    return tool_check_status(VA_CALL(&replay->drv, BeginPicture, c->context,
+                                     c->picture_surface),
+                             "vaBeginPicture()");
+}
+
+// VDPAU_CAPTURE_TAG_BUFFER
+static int
+replay_render_buffer(
+    replay_t           *replay,
+    replay_context_t   *c,
+    uint32_t           *header,
+    unsigned int        size
+)
+{
+    unsigned int element_size, num_elements, max_num_elements;
+    VABufferID buffer, *buffers;
+    replay_codec_t *codec;
+    uint64_t start;
+    uint8_t *data;
+    int ok;
+
+    if (size < 4 * sizeof(uint32_t))
+        return 0;
+
+    element_size     = header[1];
+    num_elements     = header[2];
+    max_num_elements = header[3];
+    data             = (uint8_t *)&header[4];
+    if ((uint64_t)element_size * max_num_elements != size - 4 * sizeof(uint32_t))
+        return 0;
+
+    replay_remap_buffer(replay, c->profile, header[0], data,
+                        element_size, num_elements);
+
+    if (!tool_check_status(VA_CALL(&replay->drv, CreateBuffer, c->context,
+                                   header[0], element_size, max_num_elements,
+                                   data, &buffer), "vaCreateBuffer()"))
+        return 0;
+
+    buffers = realloc_buffer((void **)&c->buffers, &c->num_buffers_max,
+                             c->num_buffers + 1, sizeof(*buffers));
+    if (!buffers) {
+        VA_CALL(&replay->drv, DestroyBuffer, buffer);
+        return 0;
+    }
+    c->buffers[c->num_buffers++] = buffer;
+    replay->num_bytes += element_size * num_elements;
+
+    if (num_elements != max_num_elements &&
+        !tool_check_status(VA_CALL(&replay->drv, BufferSetNumElements,
+                                   buffer, num_elements),
+                           "vaBufferSetNumElements()"))
+        return 0;
+
+    start = get_ticks_nsec();
+    ok = tool_check_status(VA_CALL(&replay->drv, RenderPicture, c->context,
+                                   &buffer, 1), "vaRenderPicture()");
+    codec = &replay->codecs[get_codec(c->profile)];
+    codec->render_time += get_ticks_nsec() - start;
+    codec->num_buffers++;
+    return ok;
+}
+
+// VDPAU_CAPTURE_TAG_END
+static int
+replay_end_picture(replay_t *replay, replay_context_t *c)
+{
+    uint64_t picture_time;
+    unsigned int i;
+    int ok;
+
+    ok = tool_check_status(VA_CALL(&replay->drv, EndPicture, c->context),
+                           "vaEndPicture()");
+
+    /* Like most clients, destroy buffers once the picture is submitted */
+    for (i = 0; i < c->num_buffers; i++)
+        VA_CALL(&replay->drv, DestroyBuffer, c->buffers[i]);
+    c->num_buffers = 0;
+
+    if (ok && replay->sync)
+        ok = tool_check_status(VA_CALL(&replay->drv, SyncSurface,
+                                       c->picture_surface),
+                               "vaSyncSurface()");
+
+    picture_time = get_ticks_usec() - c->picture_start;
+    replay->total_time += picture_time;
+    if (replay->max_time < picture_time)
+        replay->max_time = picture_time;
+    if (replay->verbose)
+        printf("picture %u: context 0x%08x, surface 0x%08x, %llu us\n",
+               replay->num_pictures, c->capture_id, c->picture_surface,
+               (unsigned long long)picture_time);
+    replay->num_pictures++;
+    return ok;
+}
+
+// Replay all records of the capture file once
+static int
+replay_file(replay_t *replay)
+{
+    replay_context_t *c;
+    uint32_t record[3];
+    int ok;
+
+    while (fread(record, sizeof(record), 1, replay->file) == 1) {
+        if (!realloc_buffer((void **)&replay->payload,
+                            &replay->payload_size_max,
+                            record[2] + 1, 1) ||
+            (record[2] > 0 &&
+             fread(replay->payload, record[2], 1, replay->file) != 1)) {
+            fprintf(stderr, "truncated capture file\n");
+            return 0;
+        }
+
+        switch (record[0]) {
+        case VDPAU_CAPTURE_TAG_CONTEXT:
+            ok = replay_create_context(replay, record[1],
+                                       (uint32_t *)replay->payload, record[2]);
+            break;
+        case VDPAU_CAPTURE_TAG_BEGIN:
+            c = replay_get_picture_context(replay, record[1]);
+            ok = c && replay_begin_picture(replay, c,
+                                           (uint32_t *)replay->payload,
+                                           record[2]);
+            break;
+        case VDPAU_CAPTURE_TAG_BUFFER:
+            c = replay_get_picture_context(replay, record[1]);
+            ok = c && replay_render_buffer(replay, c,
+                                           (uint32_t *)replay->payload,
+                                           record[2]);
+            break;
+        case VDPAU_CAPTURE_TAG_END:
+            c = replay_get_picture_context(replay, record[1]);
+            ok = c && replay_end_picture(replay, c);
+            break;
+        default:
+            fprintf(stderr, "unknown capture record %u\n", record[0]);
+            return 0;
+        }
+        if (!ok)
+            replay->num_errors++;
+    }
+    return 1;
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n LOOPS] [-s] [-v] CAPTURE-FILE\n"
+            "  -n LOOPS  replay the capture LOOPS times (default 1)\n"
+            "  -s        wait for each picture with vaSyncSurface()\n"
+            "  -v        print the time taken by each picture\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    replay_t replay;
+    char magic[8];
+    uint32_t version;
+    unsigned int i, loop, num_loops = 1;
+    uint64_t start, elapsed;
+    int opt, ret = 1;
+
+    memset(&replay, 0, sizeof(replay));
+    while ((opt = getopt(argc, argv, "n:svh")) != -1) {
+        switch (opt) {
+        case 'n':
+            num_loops = atoi(optarg);
+            break;
+        case 's':
+            replay.sync = 1;
+            break;
+        case 'v':
+            replay.verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    replay.file = fopen(argv[optind], "rb");
+    if (!replay.file) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fread(magic, sizeof(magic), 1, replay.file) != 1 ||
+        memcmp(magic, VDPAU_CAPTURE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&version, sizeof(version), 1, replay.file) != 1 ||
+        version != VDPAU_CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a version %d capture file\n",
+                argv[optind], VDPAU_CAPTURE_VERSION);
+        fclose(replay.file);
+        return 1;
+    }
+
+    if (tool_driver_open(&replay.drv) < 0) {
+        fclose(replay.file);
+        return 1;
+    }
+
+    start = get_ticks_usec();
+    for (loop = 0; loop < num_loops; loop++) {
+        fseek(replay.file, sizeof(magic) + sizeof(version), SEEK_SET);
+        if (!replay_file(&replay))
+            goto end;
+        for (i = 0; i < replay.num_contexts; i++)
+            replay_destroy_context(&replay, &replay.contexts[i]);
+    }
+    for (i = 0; i < replay.num_surfaces; i++)
+        VA_CALL(&replay.drv, SyncSurface, replay.surfaces[i].surface);
+    elapsed = get_ticks_usec() - start;
+
+    printf("%u pictures, %llu KB of buffers, %u errors\n",
+           replay.num_pictures, (unsigned long long)replay.num_bytes / 1024,
+           replay.num_errors);
+    if (replay.num_unknown_surfaces > 0)
+        printf("%u references to unknown surfaces\n",
+               replay.num_unknown_surfaces);
+    if (replay.num_pictures > 0 && elapsed > 0)
+        printf("%.1f pictures/s, %.1f us per picture (max %llu us)\n",
+               replay.num_pictures * 1e6 / elapsed,
+               (double)replay.total_time / replay.num_pictures,
+               (unsigned long long)replay.max_time);
+    for (i = 0; i < REPLAY_CODEC_COUNT; i++) {
+        const replay_codec_t * const codec = &replay.codecs[i];
+        if (codec->num_buffers > 0)
+            printf("%-8s %10llu buffers, %.0f ns per buffer in vaRenderPicture()\n",
+                   replay_codec_names[i],
+                   (unsigned long long)codec->num_buffers,
+                   (double)codec->render_time / codec->num_buffers);
+    }
+    ret = replay.num_errors > 0;
+
+end:
+    for (i = 0; i < replay.num_contexts; i++) {
+        replay_destroy_context(&replay, &replay.contexts[i]);
+        free(replay.contexts[i].buffers);
+    }
+    for (i = 0; i < replay.num_surfaces; i++)
+        VA_CALL(&replay.drv, DestroySurfaces, &replay.surfaces[i].surface, 1);
+    tool_driver_close(&replay.drv);
+    free(replay.contexts);
+    free(replay.surfaces);
+    free(replay.payload);
+    fclose(replay.file);
+    return ret;
+}
@@ -0,0 +1,113 @@
+/*
+ *  startcode.c - Start code scanner
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "startcode.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define USE_STARTCODE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# include <arm_neon.h>
+# define USE_STARTCODE_NEON 1
+#endif
+
+// Scans [START, SIZE) for the first start code prefix, byte by byte
+static unsigned int
+startcode_find_c(const uint8_t *buf, unsigned int start, unsigned int size)
+{
+    unsigned int i;
+
+    for (i = start; i + 2 < size; i++) {
+        /* No start code prefix can begin at i, i + 1 or i + 2 */
+        if (buf[i + 2] > 1) {
+            i += 2;
+            continue;
+        }
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
+            return i;
+    }
+    return size;
+}
+
+#if USE_STARTCODE_SSE2
+// Returns the offset of the first 00 00 01 start code prefix, or SIZE if none
+unsigned int
+startcode_find(const uint8_t *buf, unsigned int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    unsigned int i;
+    int mask;
+
+    /* Test 16 candidate positions per iteration, reading up to i + 17 */
+    for (i = 0; i + 18 <= size; i += 16) {
+        const __m128i b0 = _mm_loadu_si128((const __m128i *)(buf + i));
+        const __m128i b1 = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+        const __m128i b2 = _mm_loadu_si128((const __m128i *)(buf + i + 2));
+        mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+                                        _mm_cmpeq_epi8(b1, zero)),
+                          _mm_cmpeq_epi8(b2, one)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return startcode_find_c(buf, i, size);
+}
+#elif USE_STARTCODE_NEON
+// Returns the offset of the first 00 00 01 start code prefix, or SIZE if none
+unsigned int
+startcode_find(const uint8_t *buf, unsigned int size)
+{
+    const uint8x16_t one = vdupq_n_u8(1);
+    unsigned int i;
+
+    /* Test 16 candidate positions per iteration, reading up to i + 17 */
+    for (i = 0; i + 18 <= size; i += 16) {
+        const uint8x16_t b0 = vld1q_u8(buf + i);
+        const uint8x16_t b1 = vld1q_u8(buf + i + 1);
+        const uint8x16_t b2 = vld1q_u8(buf + i + 2);
+        if (vmaxvq_u8(vandq_u8(vandq_u8(vceqzq_u8(b0), vceqzq_u8(b1)),
+                               vceqq_u8(b2, one))))
+            return startcode_find_c(buf, i, i + 18);
+    }
+    return startcode_find_c(buf, i, size);
+}
+#else
+// Returns the offset of the first 00 00 01 start code prefix, or SIZE if none
+unsigned int
+startcode_find(const uint8_t *buf, unsigned int size)
+{
+    return startcode_find_c(buf, 0, size);
+}
+#endif
+
+// Checks whether BUF begins with a start code prefix, possibly after zero bytes
+int
+startcode_check_leading(const uint8_t *buf, unsigned int size)
+{
+    unsigned int i;
+
+    /* A NAL unit header is never a zero byte, so leading zeros are
+       part of a 4-byte start code or trailing_zero_8bits */
+    for (i = 0; i < size && buf[i] == 0; i++)
+        ;
+    return i >= 2 && i < size && buf[i] == 1;
+}
@@ -0,0 +1,36 @@
+/*
+ *  startcode.h - Start code scanner
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef STARTCODE_H
+#define STARTCODE_H
+
+#include <stdint.h>
+
+// Returns the offset of the first 00 00 01 start code prefix, or SIZE if none
+unsigned int startcode_find(const uint8_t *buf, unsigned int size)
+    attribute_hidden;
+
+// Checks whether BUF begins with a start code prefix, possibly after zero
+// bytes. Only the leading bytes are looked at, so this returns 0 for a
+// NAL unit without start code even if other units follow in BUF
+int startcode_check_leading(const uint8_t *buf, unsigned int size)
+    attribute_hidden;
+
+#endif /* STARTCODE_H */
@@ -0,0 +1,169 @@
+/*
+ *  tool_driver.c - VDPAU backend for VA-API (driver loader for tools)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include "sysdeps.h"
+#include "tool_driver.h"
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x)  STRINGIFY_(x)
+
+typedef VAStatus (*VADriverInitFunc)(VADriverContextP ctx);
+
+// Load and initialize the VA driver
+int
+tool_driver_open(tool_driver_t *drv)
+{
+    VADriverInitFunc init_func;
+    VADriverContextP ctx;
+    const char *path;
+
+    memset(drv, 0, sizeof(*drv));
+
+    path = getenv("VDPAU_VIDEO_DRIVER");
+    if (!path || !path[0])
+        path = TOOL_DRIVER_PATH;
+
+    drv->handle = dlopen(path, RTLD_NOW | RTLD_GLOBAL);
+    if (!drv->handle) {
+        fprintf(stderr, "could not load driver: %s\n", dlerror());
+        return -1;
+    }
+
+    init_func = (VADriverInitFunc)dlsym(drv->handle,
+                                        STRINGIFY(VA_DRIVER_INIT_FUNC));
+    if (!init_func) {
+        fprintf(stderr, "%s: no %s entry point\n",
+                path, STRINGIFY(VA_DRIVER_INIT_FUNC));
+        tool_driver_close(drv);
+        return -1;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        tool_driver_close(drv);
+        return -1;
+    }
+    drv->ctx = ctx;
+
+    ctx->vtable = calloc(1, sizeof(*ctx->vtable));
+    if (!ctx->vtable) {
+        tool_driver_close(drv);
+        return -1;
+    }
+
+    /* The software VDPAU device does not need an X display */
+    drv->x11_dpy = XOpenDisplay(NULL);
+    if (drv->x11_dpy) {
+        ctx->native_dpy = drv->x11_dpy;
+        ctx->x11_screen = DefaultScreen(drv->x11_dpy);
+    }
+
+    if (!tool_check_status(init_func(ctx), "vaInitialize()")) {
+        if (!drv->x11_dpy)
+            fprintf(stderr, "no X display, set VDPAU_VIDEO_SOFTWARE=1 "
+                    "to use the software VDPAU device\n");
+        tool_driver_close(drv);
+        return -1;
+    }
+    return 0;
+}
+
+// Terminate and unload the VA driver
+void
+tool_driver_close(tool_driver_t *drv)
+{
+    VADriverContextP const ctx = drv->ctx;
+
+    if (ctx) {
+        if (ctx->vtable) {
+            if (ctx->pDriverData && ctx->vtable->vaTerminate)
+                ctx->vtable->vaTerminate(ctx);
+            free(ctx->vtable);
+        }
+        free(ctx);
+        drv->ctx = NULL;
+    }
+    if (drv->x11_dpy) {
+        XCloseDisplay(drv->x11_dpy);
+        drv->x11_dpy = NULL;
+    }
+    if (drv->handle) {
+        dlclose(drv->handle);
+        drv->handle = NULL;
+    }
+}
+
+// Print an error if STATUS is not VA_STATUS_SUCCESS, returns 0 then
+int
+tool_check_status(VAStatus status, const char *func)
+{
+    if (status == VA_STATUS_SUCCESS)
+        return 1;
+    fprintf(stderr, "%s failed with status 0x%08x\n", func, status);
+    return 0;
+}
+
+// Make the driver write its statistics to a new temporary file
+int
+tool_stats_enable(char *path, unsigned int path_size)
+{
+    int fd;
+
+    if (snprintf(path, path_size, "/tmp/vdpau-va-stats.XXXXXX") >= path_size)
+        return -1;
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+
+    /* Only written at vaTerminate() */
+    setenv("VDPAU_VIDEO_STATS_FILE", path, 1);
+    setenv("VDPAU_VIDEO_STATS_INTERVAL", "0", 1);
+    return 0;
+}
+
+// Read counter NAME from the statistics file PATH
+int
+tool_stats_read_counter(const char *path, const char *name, uint64_t *value)
+{
+    const size_t name_len = strlen(name);
+    char line[256];
+    FILE *fp;
+    int found = 0;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    /* Counters are listed as "NAME   VALUE" after the histograms */
+    while (!found && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, name, name_len) == 0 && line[name_len] == ' ' &&
+            sscanf(line + name_len, "%" SCNu64, value) == 1)
+            found = 1;
+    }
+    fclose(fp);
+    return found;
+}
@@ -0,0 +1,67 @@
+/*
+ *  tool_driver.h - VDPAU backend for VA-API (driver loader for tools)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef TOOL_DRIVER_H
+#define TOOL_DRIVER_H
+
+#include <va/va_backend.h>
+
+/* Tools and benchmarks load the driver module the way libva does and
+ * call it through its VA driver vtable. The module is taken from
+ * VDPAU_VIDEO_DRIVER, or else from the build tree. Driver settings
+ * are read from the environment as usual, so VDPAU_VIDEO_SOFTWARE=1
+ * runs them without an X server or a GPU.
+ */
+typedef struct {
+    void               *handle;
+    Display            *x11_dpy;
+    VADriverContextP    ctx;
+} tool_driver_t;
+
+#define TOOL_DRIVER_PATH ".libs/vdpau_drv_video.so"
+
+// Load and initialize the VA driver
+int
+tool_driver_open(tool_driver_t *drv);
+
+// Terminate and unload the VA driver
+void
+tool_driver_close(tool_driver_t *drv);
+
+// Print an error if STATUS is not VA_STATUS_SUCCESS, returns 0 then
+int
+tool_check_status(VAStatus status, const char *func);
+
+// Make the driver write its statistics (VDPAU_VIDEO_STATS_FILE) to a new
+// temporary file at vaTerminate(), PATH receives its name. This must be
+// called before tool_driver_open()
+int
+tool_stats_enable(char *path, unsigned int path_size);
+
+// Read counter NAME from the statistics file PATH, returns 0 if not found
+int
+tool_stats_read_counter(const char *path, const char *name, uint64_t *value);
+
+// Shortcut to the driver vtable entry FUNC, e.g. VA_CALL(drv, CreateImage, ...)
+#define VA_CALL(drv, func, ...) \
+    ((drv)->ctx->vtable->va##func((drv)->ctx, __VA_ARGS__))
+
+#endif /* TOOL_DRIVER_H */
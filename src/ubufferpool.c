@@ -0,0 +1,197 @@
+/*
+ *  ubufferpool.c - Pools of recycled memory blocks
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "ubufferpool.h"
+#include <pthread.h>
+
+/*
+ * Blocks are grouped in power-of-two size classes, from 64 bytes up
+ * to 16 MB. Larger requests bypass the pool. Blocks of at least one
+ * page, pooled or not, are page-aligned. Free blocks are chained
+ * through their first bytes, so the pool needs no extra bookkeeping
+ * memory.
+ */
+#define MIN_CLASS_SHIFT 6
+#define MAX_CLASS_SHIFT 24
+#define NUM_CLASSES     (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1)
+#define PAGE_SIZE_SHIFT 12
+
+typedef struct _UBufferBlock UBufferBlock;
+struct _UBufferBlock {
+    UBufferBlock *next;
+};
+
+struct _UBufferPool {
+    pthread_mutex_t   mutex;
+    UBufferBlock     *blocks[NUM_CLASSES];
+    unsigned int      max_cached_size;
+    UBufferPoolStats  stats;
+};
+
+// Returns the size class index for SIZE, or -1 if it is too large
+static int get_class(unsigned int size)
+{
+    int shift = MIN_CLASS_SHIFT;
+
+    while ((1U << shift) < size) {
+        if (++shift > MAX_CLASS_SHIFT)
+            return -1;
+    }
+    return shift - MIN_CLASS_SHIFT;
+}
+
+static void *alloc_block(unsigned int size)
+{
+    void *data;
+
+    if (size < (1U << PAGE_SIZE_SHIFT))
+        return malloc(size);
+    if (posix_memalign(&data, 1U << PAGE_SIZE_SHIFT, size) != 0)
+        return NULL;
+    return data;
+}
+
+UBufferPool *buffer_pool_new(unsigned int max_cached_size)
+{
+    UBufferPool *pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->max_cached_size = max_cached_size;
+    return pool;
+}
+
+void buffer_pool_free(UBufferPool *pool)
+{
+    if (!pool)
+        return;
+
+    buffer_pool_trim(pool, 0);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+void *buffer_pool_alloc(UBufferPool *pool, unsigned int size, unsigned int *alloc_size)
+{
+    UBufferBlock *block = NULL;
+    int class;
+
+    class = get_class(size);
+    if (class < 0) {
+        /* Too large, don't pool it */
+        *alloc_size = size;
+        return alloc_block(size);
+    }
+    size = 1U << (class + MIN_CLASS_SHIFT);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stats.num_allocs++;
+    block = pool->blocks[class];
+    if (block) {
+        pool->blocks[class] = block->next;
+        pool->stats.cached_size -= size;
+        pool->stats.num_hits++;
+    }
+    pool->stats.live_size += size;
+    if (pool->stats.live_size_max < pool->stats.live_size)
+        pool->stats.live_size_max = pool->stats.live_size;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (!block) {
+        block = alloc_block(size);
+        if (!block) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->stats.live_size -= size;
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+    }
+    *alloc_size = size;
+    return block;
+}
+
+void buffer_pool_release(UBufferPool *pool, void *data, unsigned int alloc_size)
+{
+    UBufferBlock * const block = data;
+    int class;
+
+    if (!data)
+        return;
+
+    class = get_class(alloc_size);
+    if (class < 0) {
+        free(data);
+        return;
+    }
+    ASSERT(alloc_size == 1U << (class + MIN_CLASS_SHIFT));
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stats.live_size -= alloc_size;
+    if (pool->stats.cached_size + alloc_size > pool->max_cached_size) {
+        /* High-water mark reached, give the block back to the system */
+        pool->stats.num_trimmed++;
+        pthread_mutex_unlock(&pool->mutex);
+        free(data);
+        return;
+    }
+    block->next = pool->blocks[class];
+    pool->blocks[class] = block;
+    pool->stats.cached_size += alloc_size;
+    if (pool->stats.cached_size_max < pool->stats.cached_size)
+        pool->stats.cached_size_max = pool->stats.cached_size;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void buffer_pool_trim(UBufferPool *pool, unsigned int max_cached_size)
+{
+    UBufferBlock *block;
+    int class;
+
+    if (!pool)
+        return;
+
+    /* Release the largest blocks first */
+    pthread_mutex_lock(&pool->mutex);
+    for (class = NUM_CLASSES - 1; class >= 0; class--) {
+        const unsigned int size = 1U << (class + MIN_CLASS_SHIFT);
+        while (pool->stats.cached_size > max_cached_size &&
+               (block = pool->blocks[class]) != NULL) {
+            pool->blocks[class] = block->next;
+            pool->stats.cached_size -= size;
+            pool->stats.num_trimmed++;
+            free(block);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void buffer_pool_get_stats(UBufferPool *pool, UBufferPoolStats *stats)
+{
+    if (!pool || !stats)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->mutex);
+}
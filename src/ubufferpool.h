@@ -0,0 +1,55 @@
+/*
+ *  ubufferpool.h - Pools of recycled memory blocks
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef UBUFFERPOOL_H
+#define UBUFFERPOOL_H
+
+typedef struct _UBufferPool UBufferPool;
+
+typedef struct _UBufferPoolStats UBufferPoolStats;
+struct _UBufferPoolStats {
+    uint64_t     num_allocs;            /* Total number of allocations */
+    uint64_t     num_hits;              /* Allocations served from the pool */
+    uint64_t     num_trimmed;           /* Blocks returned to the system */
+    unsigned int cached_size;           /* Bytes currently held in the pool */
+    unsigned int cached_size_max;       /* Peak of cached_size */
+    unsigned int live_size;             /* Bytes currently handed out */
+    unsigned int live_size_max;         /* Peak of live_size */
+};
+
+UBufferPool *buffer_pool_new(unsigned int max_cached_size)
+    attribute_hidden;
+
+void buffer_pool_free(UBufferPool *pool)
+    attribute_hidden;
+
+void *buffer_pool_alloc(UBufferPool *pool, unsigned int size, unsigned int *alloc_size)
+    attribute_hidden;
+
+void buffer_pool_release(UBufferPool *pool, void *data, unsigned int alloc_size)
+    attribute_hidden;
+
+void buffer_pool_trim(UBufferPool *pool, unsigned int max_cached_size)
+    attribute_hidden;
+
+void buffer_pool_get_stats(UBufferPool *pool, UBufferPoolStats *stats)
+    attribute_hidden;
+
+#endif /* UBUFFERPOOL_H */
@@ -22,12 +22,247 @@
 #include "vdpau_buffer.h"
 #include "vdpau_driver.h"
 #include "vdpau_video.h"
+#include "vdpau_image.h"
 #include "vdpau_dump.h"
 #include "utils.h"
+#include "ubufferpool.h"
 
 #define DEBUG 1
 #include "debug.h"
 
+// Default high-water mark of the VA buffer pool, in KB
+#define VDPAU_BUFFER_POOL_SIZE (32 * 1024)
+
+// Slice data arena chunks are page-aligned, the arena starts at 1 MB
+// and doubles when full, up to 64 MB
+#define SLICE_DATA_ARENA_ALIGN    4096
+#define SLICE_DATA_ARENA_SIZE_MIN (1024 * 1024)
+#define SLICE_DATA_ARENA_SIZE_MAX (64 * 1024 * 1024)
+
+// Check whether slice data buffers may be carved from a per-context arena
+static int use_slice_data_arena(void)
+{
+    static int g_use_slice_data_arena = -1;
+
+    if (g_use_slice_data_arena < 0) {
+        if (getenv_yesno("VDPAU_VIDEO_SLICE_DATA_ARENA", &g_use_slice_data_arena) < 0)
+            g_use_slice_data_arena = 1;
+    }
+    return g_use_slice_data_arena;
+}
+
+// Create pool of VA buffer data blocks
+int
+vdpau_buffer_pool_init(vdpau_driver_data_t *driver_data)
+{
+    int pool_size;
+
+    if (getenv_int("VDPAU_VIDEO_BUFFER_POOL_SIZE", &pool_size) < 0 ||
+        pool_size < 0)
+        pool_size = VDPAU_BUFFER_POOL_SIZE;
+
+    driver_data->buffer_pool = buffer_pool_new(pool_size * 1024U);
+    if (!driver_data->buffer_pool)
+        return -1;
+    return 0;
+}
+
+// Destroy pool of VA buffer data blocks
+void
+vdpau_buffer_pool_exit(vdpau_driver_data_t *driver_data)
+{
+    UBufferPoolStats stats;
+
+    if (!driver_data->buffer_pool)
+        return;
+
+    buffer_pool_get_stats(driver_data->buffer_pool, &stats);
+    D(bug("VA buffer pool: %llu allocations, %llu from pool, %llu trimmed, "
+          "peak %u KB live, %u KB cached\n",
+          (unsigned long long)stats.num_allocs,
+          (unsigned long long)stats.num_hits,
+          (unsigned long long)stats.num_trimmed,
+          stats.live_size_max / 1024, stats.cached_size_max / 1024));
+    STATS_COUNT("VA buffer pool: allocations", stats.num_allocs);
+    STATS_COUNT("VA buffer pool: from pool", stats.num_hits);
+
+    buffer_pool_free(driver_data->buffer_pool);
+    driver_data->buffer_pool = NULL;
+}
+
+// Destroy slice data arena, once unreferenced
+static void
+slice_data_arena_release(
+    vdpau_driver_data_t *driver_data,
+    slice_data_arena_t  *arena
+)
+{
+    unsigned int refcount;
+
+    pthread_mutex_lock(&arena->mutex);
+    refcount = --arena->refcount;
+    pthread_mutex_unlock(&arena->mutex);
+    if (refcount > 0)
+        return;
+
+    buffer_pool_release(driver_data->buffer_pool, arena->data, arena->alloc_size);
+    pthread_mutex_destroy(&arena->mutex);
+    free(arena->chunks);
+    free(arena);
+}
+
+// Create slice data arena of SIZE bytes
+static slice_data_arena_t *
+slice_data_arena_new(vdpau_driver_data_t *driver_data, unsigned int size)
+{
+    slice_data_arena_t *arena;
+
+    arena = calloc(1, sizeof(*arena));
+    if (!arena)
+        return NULL;
+
+    arena->data = buffer_pool_alloc(driver_data->buffer_pool, size,
+                                    &arena->alloc_size);
+    if (!arena->data) {
+        free(arena);
+        return NULL;
+    }
+    pthread_mutex_init(&arena->mutex, NULL);
+    arena->refcount = 1;
+    arena->size     = size;
+    return arena;
+}
+
+// Release context reference to the slice data arena
+void
+slice_data_arena_unref(
+    vdpau_driver_data_t *driver_data,
+    slice_data_arena_t  *arena
+)
+{
+    if (arena)
+        slice_data_arena_release(driver_data, arena);
+}
+
+// Find room for SIZE bytes past the newest chunk, wrapping around to
+// the start of the arena when the oldest chunk is far enough. Returns
+// the chunk offset, or -1 if the arena is full
+static int
+slice_data_arena_find(slice_data_arena_t *arena, unsigned int size)
+{
+    unsigned int tail;
+
+    if (arena->num_chunks == 0)
+        return size <= arena->size ? 0 : -1;
+
+    tail = arena->chunks[0].offset;
+    if (arena->chunks[arena->num_chunks - 1].offset >= tail) {
+        if (arena->head + size <= arena->size)
+            return arena->head;
+        if (size <= tail)
+            return 0;
+    }
+    else if (arena->head + size <= tail)
+        return arena->head;
+    return -1;
+}
+
+// Carve a page-aligned chunk from the context slice data arena.
+// The arena is a ring: chunks are carved past the newest one and
+// space is reclaimed as soon as the oldest chunks are freed, so
+// buffers still held by in-flight pictures do not prevent reuse. If
+// the arena is full, it is replaced with one twice as large, and the
+// old one lives on until its last chunk is freed.
+static void *
+slice_data_arena_alloc(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    unsigned int         size
+)
+{
+    slice_data_arena_t *arena = obj_context->slice_data_arena;
+    slice_data_chunk_t *chunk;
+    unsigned int arena_size;
+    void *data = NULL;
+    int offset;
+
+    if (size == 0 || size > SLICE_DATA_ARENA_SIZE_MAX)
+        return NULL;
+    size = (size + SLICE_DATA_ARENA_ALIGN - 1) & -SLICE_DATA_ARENA_ALIGN;
+
+    if (arena) {
+        pthread_mutex_lock(&arena->mutex);
+        offset = slice_data_arena_find(arena, size);
+        pthread_mutex_unlock(&arena->mutex);
+    }
+    else
+        offset = -1;
+
+    if (offset < 0) {
+        arena_size = arena ? arena->size * 2 : SLICE_DATA_ARENA_SIZE_MIN;
+        while (arena_size < size)
+            arena_size *= 2;
+        if (arena_size > SLICE_DATA_ARENA_SIZE_MAX)
+            return NULL;
+        arena = slice_data_arena_new(driver_data, arena_size);
+        if (!arena)
+            return NULL;
+        slice_data_arena_unref(driver_data, obj_context->slice_data_arena);
+        obj_context->slice_data_arena = arena;
+    }
+
+    /* Only this thread carves chunks, so the room found above is still
+       there: concurrent frees can only make more */
+    pthread_mutex_lock(&arena->mutex);
+    offset = slice_data_arena_find(arena, size);
+    chunk = realloc_buffer((void **)&arena->chunks, &arena->num_chunks_max,
+                           arena->num_chunks + 1, sizeof(*chunk));
+    if (offset >= 0 && chunk) {
+        chunk = &arena->chunks[arena->num_chunks++];
+        chunk->offset  = offset;
+        chunk->size    = size;
+        chunk->is_free = 0;
+        arena->head    = offset + size;
+        arena->refcount++;
+        data = arena->data + offset;
+    }
+    pthread_mutex_unlock(&arena->mutex);
+    return data;
+}
+
+// Return a chunk to the slice data arena
+static void
+slice_data_arena_free(
+    vdpau_driver_data_t *driver_data,
+    slice_data_arena_t  *arena,
+    void                *data
+)
+{
+    const unsigned int offset = (uint8_t *)data - arena->data;
+    unsigned int i, n;
+
+    pthread_mutex_lock(&arena->mutex);
+    for (i = 0; i < arena->num_chunks; i++) {
+        if (arena->chunks[i].offset == offset) {
+            arena->chunks[i].is_free = 1;
+            break;
+        }
+    }
+
+    /* Reclaim space up to the oldest chunk still in use */
+    for (n = 0; n < arena->num_chunks && arena->chunks[n].is_free; n++)
+        ;
+    if (n > 0) {
+        arena->num_chunks -= n;
+        memmove(arena->chunks, arena->chunks + n,
+                arena->num_chunks * sizeof(arena->chunks[0]));
+        if (arena->num_chunks == 0)
+            arena->head = 0;
+    }
+    pthread_mutex_unlock(&arena->mutex);
+    slice_data_arena_release(driver_data, arena);
+}
+
 // Destroy dead VA buffers
 void
 destroy_dead_va_buffers(
@@ -50,18 +285,20 @@ destroy_dead_va_buffers(
     obj_context->dead_buffers_count = 0;
 }
 
-// Create VA buffer object
-object_buffer_p
-create_va_buffer(
+// Create VA buffer object, optionally backed by the slice data arena
+static object_buffer_p
+create_va_buffer_full(
     vdpau_driver_data_t *driver_data,
     VAContextID         context,
     VABufferType        buffer_type,
     unsigned int        num_elements,
-    unsigned int        size
+    unsigned int        size,
+    int                 from_arena
 )
 {
     VABufferID buffer_id;
     object_buffer_p obj_buffer;
+    object_context_p obj_context = NULL;
 
     buffer_id = object_heap_allocate(&driver_data->buffer_heap);
     if (buffer_id == VA_INVALID_BUFFER)
@@ -76,10 +313,32 @@ create_va_buffer(
     obj_buffer->max_num_elements = num_elements;
     obj_buffer->num_elements     = num_elements;
     obj_buffer->buffer_size      = size * num_elements;
-    obj_buffer->buffer_data      = malloc(obj_buffer->buffer_size);
+    obj_buffer->buffer_data      = NULL;
+    obj_buffer->buffer_alloc_size = 0;
+    obj_buffer->arena            = NULL;
     obj_buffer->mtime            = 0;
+    obj_buffer->map_count        = 0;
+    obj_buffer->derived_image    = VA_INVALID_ID;
     obj_buffer->delayed_destroy  = 0;
 
+    if (from_arena)
+        obj_context = VDPAU_CONTEXT(context);
+    if (obj_context) {
+        obj_buffer->buffer_data = slice_data_arena_alloc(
+            driver_data,
+            obj_context,
+            obj_buffer->buffer_size
+        );
+        if (obj_buffer->buffer_data)
+            obj_buffer->arena = obj_context->slice_data_arena;
+    }
+    if (!obj_buffer->buffer_data)
+        obj_buffer->buffer_data = buffer_pool_alloc(
+            driver_data->buffer_pool,
+            obj_buffer->buffer_size,
+            &obj_buffer->buffer_alloc_size
+        );
+
     if (!obj_buffer->buffer_data) {
         destroy_va_buffer(driver_data, obj_buffer);
         return NULL;
@@ -87,6 +346,20 @@ create_va_buffer(
     return obj_buffer;
 }
 
+// Create VA buffer object
+object_buffer_p
+create_va_buffer(
+    vdpau_driver_data_t *driver_data,
+    VAContextID         context,
+    VABufferType        buffer_type,
+    unsigned int        num_elements,
+    unsigned int        size
+)
+{
+    return create_va_buffer_full(driver_data, context, buffer_type,
+                                 num_elements, size, 0);
+}
+
 // Destroy VA buffer object
 void
 destroy_va_buffer(
@@ -97,8 +370,18 @@ destroy_va_buffer(
     if (!obj_buffer)
         return;
 
-    if (obj_buffer->buffer_data) {
-        free(obj_buffer->buffer_data);
+    if (obj_buffer->arena) {
+        slice_data_arena_free(driver_data, obj_buffer->arena,
+                              obj_buffer->buffer_data);
+        obj_buffer->arena = NULL;
+        obj_buffer->buffer_data = NULL;
+    }
+    else if (obj_buffer->buffer_data) {
+        buffer_pool_release(
+            driver_data->buffer_pool,
+            obj_buffer->buffer_data,
+            obj_buffer->buffer_alloc_size
+        );
         obj_buffer->buffer_data = NULL;
     }
     object_heap_free(&driver_data->buffer_heap, (object_base_p)obj_buffer);
@@ -160,8 +443,14 @@ vdpau_CreateBuffer(
         return VA_STATUS_ERROR_UNSUPPORTED_BUFFERTYPE;
     }
 
+    /* Slice data to be filled in through vaMapBuffer() is carved from
+       the context arena and referenced in place by VdpBitstreamBuffers */
+    const int from_arena = (!data && type == VASliceDataBufferType &&
+                            use_slice_data_arena());
+
     object_buffer_p obj_buffer;
-    obj_buffer = create_va_buffer(driver_data, context, type, num_elements, size);
+    obj_buffer = create_va_buffer_full(driver_data, context, type,
+                                       num_elements, size, from_arena);
     if (!obj_buffer)
         return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
@@ -233,6 +522,7 @@ vdpau_MapBuffer(
         return VA_STATUS_ERROR_UNKNOWN;
 
     ++obj_buffer->mtime;
+    ++obj_buffer->map_count;
     return VA_STATUS_SUCCESS;
 }
 
@@ -250,6 +540,11 @@ vdpau_UnmapBuffer(
         return VA_STATUS_ERROR_INVALID_BUFFER;
 
     ++obj_buffer->mtime;
+
+    /* The client may have written to a derived image */
+    if (obj_buffer->map_count > 0 && --obj_buffer->map_count == 0 &&
+        obj_buffer->derived_image != VA_INVALID_ID)
+        return commit_derived_image(driver_data, obj_buffer);
     return VA_STATUS_SUCCESS;
 }
 
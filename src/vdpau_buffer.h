@@ -22,6 +22,28 @@
 #define VDPAU_BUFFER_H
 
 #include "vdpau_driver.h"
+#include <pthread.h>
+
+// Chunk carved from a slice data arena, freed in any order
+typedef struct {
+    unsigned int        offset;
+    unsigned int        size;
+    unsigned int        is_free;
+} slice_data_chunk_t;
+
+// Per-context ring arena backing slice data buffers created without data
+typedef struct slice_data_arena slice_data_arena_t;
+struct slice_data_arena {
+    pthread_mutex_t     mutex;
+    unsigned int        refcount;
+    uint8_t            *data;
+    unsigned int        size;
+    unsigned int        alloc_size;
+    unsigned int        head;           /* end of the newest chunk */
+    slice_data_chunk_t *chunks;         /* oldest chunk first */
+    unsigned int        num_chunks;
+    unsigned int        num_chunks_max;
+};
 
 typedef struct object_buffer object_buffer_t;
 struct object_buffer {
@@ -30,12 +52,31 @@ struct object_buffer {
     VABufferType        type;
     void               *buffer_data;
     unsigned int        buffer_size;
+    unsigned int        buffer_alloc_size;
+    slice_data_arena_t *arena;
     unsigned int        max_num_elements;
     unsigned int        num_elements;
     uint64_t            mtime;
+    unsigned int        map_count;
+    VAImageID           derived_image;  /* vaDeriveImage() image it backs */
     unsigned int        delayed_destroy : 1;
 };
 
+// Create pool of VA buffer data blocks
+int
+vdpau_buffer_pool_init(vdpau_driver_data_t *driver_data) attribute_hidden;
+
+// Destroy pool of VA buffer data blocks
+void
+vdpau_buffer_pool_exit(vdpau_driver_data_t *driver_data) attribute_hidden;
+
+// Release context reference to the slice data arena
+void
+slice_data_arena_unref(
+    vdpau_driver_data_t *driver_data,
+    slice_data_arena_t  *arena
+) attribute_hidden;
+
 // Destroy dead VA buffers
 void
 destroy_dead_va_buffers(
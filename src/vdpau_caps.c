@@ -0,0 +1,432 @@
+/*
+ *  vdpau_caps.c - VDPAU backend for VA-API (device capabilities)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_caps.h"
+#include <stddef.h>
+#include <unistd.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+#define VDPAU_CAPS_DRIVER_VERSION               \
+    ((VDPAU_VIDEO_MAJOR_VERSION << 24) |        \
+     (VDPAU_VIDEO_MINOR_VERSION << 16) |        \
+     (VDPAU_VIDEO_MICRO_VERSION <<  8) |        \
+     VDPAU_VIDEO_PRE_VERSION)
+
+#define BIT(n) (1U << (n))
+
+// Decoder profiles the driver can map VA profiles to
+static const VdpDecoderProfile vdpau_caps_decoder_profiles[] = {
+    VDP_DECODER_PROFILE_MPEG2_SIMPLE,
+    VDP_DECODER_PROFILE_MPEG2_MAIN,
+#if USE_VDPAU_MPEG4
+    VDP_DECODER_PROFILE_MPEG4_PART2_SP,
+    VDP_DECODER_PROFILE_MPEG4_PART2_ASP,
+#endif
+    VDP_DECODER_PROFILE_H264_BASELINE,
+    VDP_DECODER_PROFILE_H264_MAIN,
+    VDP_DECODER_PROFILE_H264_HIGH,
+    VDP_DECODER_PROFILE_VC1_SIMPLE,
+    VDP_DECODER_PROFILE_VC1_MAIN,
+    VDP_DECODER_PROFILE_VC1_ADVANCED,
+    VDP_DECODER_PROFILE_VP9_PROFILE_0,
+};
+
+// Formats and features the driver uses, as bitmasks of VDPAU enum values
+static const uint32_t vdpau_caps_ycbcr_formats =
+    BIT(VDP_YCBCR_FORMAT_NV12) | BIT(VDP_YCBCR_FORMAT_YV12) |
+    BIT(VDP_YCBCR_FORMAT_UYVY) | BIT(VDP_YCBCR_FORMAT_YUYV) |
+    BIT(VDP_YCBCR_FORMAT_V8U8Y8A8);
+
+static const uint32_t vdpau_caps_rgba_formats =
+    BIT(VDP_RGBA_FORMAT_B8G8R8A8) | BIT(VDP_RGBA_FORMAT_R8G8B8A8);
+
+static const uint32_t vdpau_caps_indexed_formats =
+    BIT(VDP_INDEXED_FORMAT_A4I4) | BIT(VDP_INDEXED_FORMAT_I4A4) |
+    BIT(VDP_INDEXED_FORMAT_A8I8) | BIT(VDP_INDEXED_FORMAT_I8A8);
+
+static const uint32_t vdpau_caps_mixer_features =
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1)     |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 1) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 2) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 3) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 4) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 5) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 6) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 7) |
+    BIT(VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + 8);
+
+static inline int is_cached(uint32_t mask, uint32_t value)
+{
+    return value < 32 && (mask & BIT(value)) != 0;
+}
+
+static void
+query_decoder(
+    vdpau_driver_data_t  *driver_data,
+    VdpDecoderProfile     profile,
+    vdpau_decoder_caps_t *caps
+)
+{
+    VdpStatus vdp_status;
+
+    caps->profile = profile;
+    vdp_status = vdpau_decoder_query_capabilities(
+        driver_data,
+        driver_data->vdp_device,
+        profile,
+        &caps->is_supported,
+        &caps->max_level,
+        &caps->max_macroblocks,
+        &caps->max_width,
+        &caps->max_height
+    );
+    if (!VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderQueryCapabilities()"))
+        caps->is_supported = VDP_FALSE;
+}
+
+static VdpBool
+query_ycbcr_format(
+    vdpau_driver_data_t *driver_data,
+    VdpChromaType        chroma_type,
+    VdpYCbCrFormat       format
+)
+{
+    VdpBool is_supported = VDP_FALSE;
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_video_surface_query_ycbcr_caps(driver_data,
+                                                      driver_data->vdp_device,
+                                                      chroma_type,
+                                                      format,
+                                                      &is_supported);
+    return vdp_status == VDP_STATUS_OK && is_supported;
+}
+
+static VdpBool
+query_rgba_format(vdpau_driver_data_t *driver_data, VdpRGBAFormat format)
+{
+    VdpBool is_supported = VDP_FALSE;
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_output_surface_query_rgba_caps(driver_data,
+                                                      driver_data->vdp_device,
+                                                      format,
+                                                      &is_supported);
+    return vdp_status == VDP_STATUS_OK && is_supported;
+}
+
+static VdpBool
+query_bitmap_format(vdpau_driver_data_t *driver_data, VdpRGBAFormat format)
+{
+    VdpBool is_supported = VDP_FALSE;
+    VdpStatus vdp_status;
+    uint32_t max_width, max_height;
+
+    vdp_status = vdpau_bitmap_surface_query_capabilities(
+        driver_data,
+        driver_data->vdp_device,
+        format,
+        &is_supported,
+        &max_width,
+        &max_height
+    );
+    return vdp_status == VDP_STATUS_OK && is_supported;
+}
+
+static VdpBool
+query_indexed_format(vdpau_driver_data_t *driver_data, VdpIndexedFormat format)
+{
+    VdpBool is_supported = VDP_FALSE;
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_output_surface_query_put_bits_indexed_capabilities(
+        driver_data,
+        driver_data->vdp_device,
+        VDP_RGBA_FORMAT_B8G8R8A8,
+        format,
+        VDP_COLOR_TABLE_FORMAT_B8G8R8X8,
+        &is_supported
+    );
+    return vdp_status == VDP_STATUS_OK && is_supported;
+}
+
+static VdpBool
+query_mixer_feature(vdpau_driver_data_t *driver_data, VdpVideoMixerFeature feature)
+{
+    VdpBool is_supported = VDP_FALSE;
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_video_mixer_query_feature_support(
+        driver_data,
+        driver_data->vdp_device,
+        feature,
+        &is_supported
+    );
+    return (VDPAU_CHECK_STATUS(vdp_status, "VdpVideoMixerQueryFeatureSupport()") &&
+            is_supported);
+}
+
+// Query all cached capabilities from the VDPAU device
+static void
+caps_query(vdpau_driver_data_t *driver_data, vdpau_caps_t *caps)
+{
+    unsigned int i;
+
+    memset(caps, 0, sizeof(*caps));
+
+    for (i = 0; i < ARRAY_ELEMS(vdpau_caps_decoder_profiles); i++)
+        query_decoder(driver_data, vdpau_caps_decoder_profiles[i],
+                      &caps->decoders[caps->num_decoders++]);
+
+    for (i = 0; i < 32; i++) {
+        if (is_cached(vdpau_caps_ycbcr_formats, i) &&
+            query_ycbcr_format(driver_data, VDP_CHROMA_TYPE_420, i))
+            caps->ycbcr_420_formats |= BIT(i);
+        if (is_cached(vdpau_caps_rgba_formats, i)) {
+            if (query_rgba_format(driver_data, i))
+                caps->rgba_formats |= BIT(i);
+            if (query_bitmap_format(driver_data, i))
+                caps->bitmap_formats |= BIT(i);
+        }
+        if (is_cached(vdpau_caps_indexed_formats, i) &&
+            query_indexed_format(driver_data, i))
+            caps->indexed_formats |= BIT(i);
+        if (is_cached(vdpau_caps_mixer_features, i) &&
+            query_mixer_feature(driver_data, i))
+            caps->mixer_features |= BIT(i);
+    }
+}
+
+static void
+caps_file_init(vdpau_caps_file_t *file, const char *info_string)
+{
+    memset(file, 0, sizeof(*file));
+    memcpy(file->magic, VDPAU_CAPS_MAGIC, sizeof(file->magic));
+    file->version        = VDPAU_CAPS_VERSION;
+    file->driver_version = VDPAU_CAPS_DRIVER_VERSION;
+    file->api_version    = VDPAU_VERSION; /* checked at vaInitialize() */
+    if (info_string)
+        strncpy(file->info_string, info_string, sizeof(file->info_string) - 1);
+}
+
+// Load capabilities from PATH, if it matches the expected header
+static int
+caps_load(const char *path, const vdpau_caps_file_t *header, vdpau_caps_t *caps)
+{
+    vdpau_caps_file_t file;
+    FILE *fp;
+    int ok;
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    ok = (fread(&file, sizeof(file), 1, fp) == 1 &&
+          memcmp(&file, header, offsetof(vdpau_caps_file_t, caps)) == 0 &&
+          file.caps.num_decoders <= VDPAU_CAPS_MAX_DECODERS);
+    fclose(fp);
+    if (!ok)
+        return 0;
+
+    *caps = file.caps;
+    return 1;
+}
+
+// Save capabilities to PATH, atomically replacing any previous file
+static void
+caps_save(const char *path, const vdpau_caps_file_t *header, const vdpau_caps_t *caps)
+{
+    vdpau_caps_file_t file;
+    char *tmp_path;
+    FILE *fp;
+    int ok;
+
+    tmp_path = malloc(strlen(path) + 16);
+    if (!tmp_path)
+        return;
+    sprintf(tmp_path, "%s.%d", path, (int)getpid());
+
+    file      = *header;
+    file.caps = *caps;
+    fp = fopen(tmp_path, "wb");
+    if (fp) {
+        ok = fwrite(&file, sizeof(file), 1, fp) == 1;
+        ok = fclose(fp) == 0 && ok;
+        if (ok && rename(tmp_path, path) == 0)
+            D(bug("saved VDPAU capabilities to %s\n", path));
+        else
+            unlink(tmp_path);
+    }
+    free(tmp_path);
+}
+
+// Fill in device capabilities, from VDPAU_VIDEO_CAPS_CACHE if possible
+int
+vdpau_caps_init(vdpau_driver_data_t *driver_data, const char *info_string)
+{
+    vdpau_caps_file_t header;
+    vdpau_caps_t *caps;
+    const char *path;
+
+    driver_data->caps = NULL;
+
+    caps = malloc(sizeof(*caps));
+    if (!caps)
+        return -1;
+
+    caps_file_init(&header, info_string);
+    path = getenv("VDPAU_VIDEO_CAPS_CACHE");
+    if (path && path[0] && caps_load(path, &header, caps))
+        D(bug("loaded VDPAU capabilities from %s\n", path));
+    else {
+        caps_query(driver_data, caps);
+        if (path && path[0])
+            caps_save(path, &header, caps);
+    }
+    driver_data->caps = caps;
+    return 0;
+}
+
+// Release device capabilities
+void
+vdpau_caps_exit(vdpau_driver_data_t *driver_data)
+{
+    free(driver_data->caps);
+    driver_data->caps = NULL;
+}
+
+// Checks whether the decoder supports PROFILE, and get its maximum size
+VdpBool
+vdpau_caps_get_decoder(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t            *pmax_width,
+    uint32_t            *pmax_height
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+    const vdpau_decoder_caps_t *decoder_caps = NULL;
+    vdpau_decoder_caps_t tmp_caps;
+    unsigned int i;
+
+    if (pmax_width)
+        *pmax_width = 0;
+    if (pmax_height)
+        *pmax_height = 0;
+
+    if (profile == (VdpDecoderProfile)-1)
+        return VDP_FALSE;
+
+    if (caps) {
+        for (i = 0; i < caps->num_decoders; i++) {
+            if (caps->decoders[i].profile == profile) {
+                decoder_caps = &caps->decoders[i];
+                break;
+            }
+        }
+    }
+    if (!decoder_caps) {
+        query_decoder(driver_data, profile, &tmp_caps);
+        decoder_caps = &tmp_caps;
+    }
+
+    if (!decoder_caps->is_supported)
+        return VDP_FALSE;
+
+    if (pmax_width)
+        *pmax_width = decoder_caps->max_width;
+    if (pmax_height)
+        *pmax_height = decoder_caps->max_height;
+    return VDP_TRUE;
+}
+
+// Checks whether video surfaces of CHROMA_TYPE support FORMAT get/put bits
+VdpBool
+vdpau_caps_has_ycbcr_format(
+    vdpau_driver_data_t *driver_data,
+    VdpChromaType        chroma_type,
+    VdpYCbCrFormat       format
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+
+    if (caps && chroma_type == VDP_CHROMA_TYPE_420 &&
+        is_cached(vdpau_caps_ycbcr_formats, format))
+        return (caps->ycbcr_420_formats & BIT(format)) != 0;
+    return query_ycbcr_format(driver_data, chroma_type, format);
+}
+
+// Checks whether output surfaces support FORMAT get/put bits
+VdpBool
+vdpau_caps_has_rgba_format(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        format
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+
+    if (caps && is_cached(vdpau_caps_rgba_formats, format))
+        return (caps->rgba_formats & BIT(format)) != 0;
+    return query_rgba_format(driver_data, format);
+}
+
+// Checks whether bitmap surfaces support FORMAT
+VdpBool
+vdpau_caps_has_bitmap_format(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        format
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+
+    if (caps && is_cached(vdpau_caps_rgba_formats, format))
+        return (caps->bitmap_formats & BIT(format)) != 0;
+    return query_bitmap_format(driver_data, format);
+}
+
+// Checks whether B8G8R8A8 output surfaces support indexed FORMAT put bits
+VdpBool
+vdpau_caps_has_indexed_format(
+    vdpau_driver_data_t *driver_data,
+    VdpIndexedFormat     format
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+
+    if (caps && is_cached(vdpau_caps_indexed_formats, format))
+        return (caps->indexed_formats & BIT(format)) != 0;
+    return query_indexed_format(driver_data, format);
+}
+
+// Checks whether the video mixer supports FEATURE
+VdpBool
+vdpau_caps_has_mixer_feature(
+    vdpau_driver_data_t *driver_data,
+    VdpVideoMixerFeature feature
+)
+{
+    const vdpau_caps_t * const caps = driver_data->caps;
+
+    if (caps && is_cached(vdpau_caps_mixer_features, feature))
+        return (caps->mixer_features & BIT(feature)) != 0;
+    return query_mixer_feature(driver_data, feature);
+}
@@ -0,0 +1,125 @@
+/*
+ *  vdpau_caps.h - VDPAU backend for VA-API (device capabilities)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_CAPS_H
+#define VDPAU_CAPS_H
+
+#include "vdpau_driver.h"
+
+/* Device capabilities are queried once at vaInitialize() time. Formats
+ * and features outside of the set the driver uses are not cached and
+ * are still queried from the VDPAU device.
+ *
+ * If VDPAU_VIDEO_CAPS_CACHE names a file, the table is loaded from it
+ * when it was written by the same driver version for a VDPAU device
+ * with the same API version and information string, and saved to it
+ * otherwise. The file is a verbatim copy of vdpau_caps_file_t.
+ */
+#define VDPAU_CAPS_MAGIC                "VDPVACAC"
+#define VDPAU_CAPS_VERSION              1
+#define VDPAU_CAPS_MAX_DECODERS         16
+#define VDPAU_CAPS_MAX_INFO_STRING      256
+
+typedef struct {
+    VdpDecoderProfile   profile;
+    VdpBool             is_supported;
+    uint32_t            max_level;
+    uint32_t            max_macroblocks;
+    uint32_t            max_width;
+    uint32_t            max_height;
+} vdpau_decoder_caps_t;
+
+/* Format and feature sets are bitmasks indexed by the VDPAU enum value */
+typedef struct vdpau_caps vdpau_caps_t;
+struct vdpau_caps {
+    vdpau_decoder_caps_t decoders[VDPAU_CAPS_MAX_DECODERS];
+    uint32_t            num_decoders;
+    uint32_t            ycbcr_420_formats;  /* video surface get/put bits */
+    uint32_t            rgba_formats;       /* output surface get/put bits */
+    uint32_t            bitmap_formats;     /* bitmap surfaces */
+    uint32_t            indexed_formats;    /* put bits indexed into B8G8R8A8 */
+    uint32_t            mixer_features;
+};
+
+typedef struct {
+    char                magic[8];
+    uint32_t            version;
+    uint32_t            driver_version;
+    uint32_t            api_version;
+    char                info_string[VDPAU_CAPS_MAX_INFO_STRING];
+    vdpau_caps_t        caps;
+} vdpau_caps_file_t;
+
+// Fill in device capabilities, from VDPAU_VIDEO_CAPS_CACHE if possible
+int
+vdpau_caps_init(vdpau_driver_data_t *driver_data, const char *info_string)
+    attribute_hidden;
+
+// Release device capabilities
+void
+vdpau_caps_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Checks whether the decoder supports PROFILE, and get its maximum size
+VdpBool
+vdpau_caps_get_decoder(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t            *pmax_width,
+    uint32_t            *pmax_height
+) attribute_hidden;
+
+// Checks whether video surfaces of CHROMA_TYPE support FORMAT get/put bits
+VdpBool
+vdpau_caps_has_ycbcr_format(
+    vdpau_driver_data_t *driver_data,
+    VdpChromaType        chroma_type,
+    VdpYCbCrFormat       format
+) attribute_hidden;
+
+// Checks whether output surfaces support FORMAT get/put bits
+VdpBool
+vdpau_caps_has_rgba_format(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        format
+) attribute_hidden;
+
+// Checks whether bitmap surfaces support FORMAT
+VdpBool
+vdpau_caps_has_bitmap_format(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        format
+) attribute_hidden;
+
+// Checks whether B8G8R8A8 output surfaces support indexed FORMAT put bits
+VdpBool
+vdpau_caps_has_indexed_format(
+    vdpau_driver_data_t *driver_data,
+    VdpIndexedFormat     format
+) attribute_hidden;
+
+// Checks whether the video mixer supports FEATURE
+VdpBool
+vdpau_caps_has_mixer_feature(
+    vdpau_driver_data_t *driver_data,
+    VdpVideoMixerFeature feature
+) attribute_hidden;
+
+#endif /* VDPAU_CAPS_H */
@@ -0,0 +1,215 @@
+/*
+ *  vdpau_capture.c - VDPAU backend for VA-API (decode trace capture)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_capture.h"
+#include "vdpau_video.h"
+#include "vdpau_buffer.h"
+#include <pthread.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+struct vdpau_capture {
+    pthread_mutex_t     lock;
+    FILE               *file;
+    unsigned int        num_pictures;
+    uint64_t            num_bytes;
+};
+
+static void
+capture_write_record(
+    vdpau_capture_t     *capture,
+    uint32_t             tag,
+    uint32_t             context,
+    const uint32_t      *header,
+    unsigned int         header_size,
+    const void          *data,
+    unsigned int         data_size
+)
+{
+    uint32_t record[3];
+
+    record[0] = tag;
+    record[1] = context;
+    record[2] = header_size + data_size;
+
+    pthread_mutex_lock(&capture->lock);
+    if (fwrite(record, sizeof(record), 1, capture->file) != 1 ||
+        (header_size > 0 && fwrite(header, header_size, 1, capture->file) != 1) ||
+        (data_size > 0 && fwrite(data, data_size, 1, capture->file) != 1))
+        D(bug("failed to write capture record %u\n", tag));
+    capture->num_bytes += sizeof(record) + header_size + data_size;
+    pthread_mutex_unlock(&capture->lock);
+}
+
+// Open capture file if VDPAU_VIDEO_CAPTURE is set. Failing to open it
+// only disables capture
+int
+vdpau_capture_init(vdpau_driver_data_t *driver_data)
+{
+    vdpau_capture_t *capture;
+    const char *path;
+    uint32_t version = VDPAU_CAPTURE_VERSION;
+
+    driver_data->capture = NULL;
+
+    path = getenv("VDPAU_VIDEO_CAPTURE");
+    if (!path || !path[0])
+        return 0;
+
+    capture = calloc(1, sizeof(*capture));
+    if (!capture)
+        return -1;
+
+    capture->file = fopen(path, "wb");
+    if (!capture->file) {
+        vdpau_error_message("could not open capture file %s, "
+                            "capture disabled\n", path);
+        free(capture);
+        return 0;
+    }
+    if (fwrite(VDPAU_CAPTURE_MAGIC, 8, 1, capture->file) != 1 ||
+        fwrite(&version, sizeof(version), 1, capture->file) != 1) {
+        vdpau_error_message("could not write capture file %s, "
+                            "capture disabled\n", path);
+        fclose(capture->file);
+        free(capture);
+        return 0;
+    }
+    pthread_mutex_init(&capture->lock, NULL);
+    driver_data->capture = capture;
+    D(bug("capturing decode session to %s\n", path));
+    return 0;
+}
+
+// Close capture file
+void
+vdpau_capture_exit(vdpau_driver_data_t *driver_data)
+{
+    vdpau_capture_t * const capture = driver_data->capture;
+
+    if (!capture)
+        return;
+
+    D(bug("captured %u pictures, %llu bytes\n",
+          capture->num_pictures, (unsigned long long)capture->num_bytes));
+
+    fclose(capture->file);
+    pthread_mutex_destroy(&capture->lock);
+    free(capture);
+    driver_data->capture = NULL;
+}
+
+// Record a new decode context and its render targets
+void
+capture_create_context(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context
+)
+{
+    vdpau_capture_t * const capture = driver_data->capture;
+    object_config_p obj_config;
+    uint32_t header[5];
+
+    if (!capture)
+        return;
+
+    obj_config = VDPAU_CONFIG(obj_context->config_id);
+    header[0] = obj_config ? obj_config->profile : -1;
+    header[1] = obj_context->picture_width;
+    header[2] = obj_context->picture_height;
+    header[3] = obj_context->flags;
+    header[4] = obj_context->num_render_targets;
+    capture_write_record(capture, VDPAU_CAPTURE_TAG_CONTEXT,
+                         obj_context->base.id, header, sizeof(header),
+                         obj_context->render_targets,
+                         obj_context->num_render_targets *
+                         sizeof(obj_context->render_targets[0]));
+}
+
+// Record the start of a picture
+void
+capture_begin_picture(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    object_surface_p     obj_surface
+)
+{
+    vdpau_capture_t * const capture = driver_data->capture;
+    object_config_p obj_config;
+    uint32_t header[4];
+
+    if (!capture)
+        return;
+
+    obj_config = VDPAU_CONFIG(obj_context->config_id);
+    header[0] = obj_config ? obj_config->profile : -1;
+    header[1] = obj_context->picture_width;
+    header[2] = obj_context->picture_height;
+    header[3] = obj_surface->base.id;
+    capture_write_record(capture, VDPAU_CAPTURE_TAG_BEGIN,
+                         obj_context->base.id, header, sizeof(header),
+                         NULL, 0);
+}
+
+// Record a VA buffer submitted for the current picture
+void
+capture_buffer(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    object_buffer_p      obj_buffer
+)
+{
+    vdpau_capture_t * const capture = driver_data->capture;
+    uint32_t header[4];
+
+    if (!capture)
+        return;
+
+    header[0] = obj_buffer->type;
+    header[1] = (obj_buffer->max_num_elements > 0 ?
+                 obj_buffer->buffer_size / obj_buffer->max_num_elements : 0);
+    header[2] = obj_buffer->num_elements;
+    header[3] = obj_buffer->max_num_elements;
+    capture_write_record(capture, VDPAU_CAPTURE_TAG_BUFFER,
+                         obj_context->base.id, header, sizeof(header),
+                         obj_buffer->buffer_data, obj_buffer->buffer_size);
+}
+
+// Record the end of a picture
+void
+capture_end_picture(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context
+)
+{
+    vdpau_capture_t * const capture = driver_data->capture;
+
+    if (!capture)
+        return;
+
+    capture_write_record(capture, VDPAU_CAPTURE_TAG_END,
+                         obj_context->base.id, NULL, 0, NULL, 0);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->num_pictures++;
+    pthread_mutex_unlock(&capture->lock);
+}
@@ -0,0 +1,96 @@
+/*
+ *  vdpau_capture.h - VDPAU backend for VA-API (decode trace capture)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_CAPTURE_H
+#define VDPAU_CAPTURE_H
+
+#include "vdpau_driver.h"
+
+/* Capture files record the VA buffers submitted for decoding, so that
+ * a decode session can be re-driven later without a player. All fields
+ * are 32-bit words in host byte order.
+ *
+ *   file header:   magic "VDPVACAP", version
+ *   record header: tag, context, payload size
+ *
+ *   VDPAU_CAPTURE_TAG_CONTEXT: profile, width, height, flags,
+ *                              num render targets, render targets
+ *   VDPAU_CAPTURE_TAG_BEGIN:   profile, width, height, render target
+ *   VDPAU_CAPTURE_TAG_BUFFER:  buffer type, element size, num elements,
+ *                              max num elements, buffer data
+ *   VDPAU_CAPTURE_TAG_END:     (no payload)
+ *
+ * Buffer data holds max num elements of element size bytes, so that
+ * vaCreateBuffer() and vaBufferSetNumElements() can be replayed as is.
+ */
+#define VDPAU_CAPTURE_MAGIC             "VDPVACAP"
+#define VDPAU_CAPTURE_VERSION           2
+
+enum {
+    VDPAU_CAPTURE_TAG_BEGIN     = 1,
+    VDPAU_CAPTURE_TAG_BUFFER,
+    VDPAU_CAPTURE_TAG_END,
+    VDPAU_CAPTURE_TAG_CONTEXT
+};
+
+typedef struct vdpau_capture vdpau_capture_t;
+
+// Open capture file if VDPAU_VIDEO_CAPTURE is set. Failing to open it
+// only disables capture
+int
+vdpau_capture_init(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Close capture file
+void
+vdpau_capture_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Record a new decode context and its render targets
+void
+capture_create_context(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context
+) attribute_hidden;
+
+// Record the start of a picture
+void
+capture_begin_picture(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    object_surface_p     obj_surface
+) attribute_hidden;
+
+// Record a VA buffer submitted for the current picture
+void
+capture_buffer(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    object_buffer_p      obj_buffer
+) attribute_hidden;
+
+// Record the end of a picture
+void
+capture_end_picture(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context
+) attribute_hidden;
+
+#endif /* VDPAU_CAPTURE_H */
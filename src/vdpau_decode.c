@@ -22,11 +22,17 @@
 #include "vdpau_decode.h"
 #include "vdpau_driver.h"
 #include "vdpau_buffer.h"
+#include "vdpau_caps.h"
+#include "vdpau_capture.h"
+#include "vdpau_decoder_cache.h"
+#include "vdpau_decode_worker.h"
 #include "vdpau_video.h"
 #include "vdpau_dump.h"
+#include "vdpau_timeline.h"
 #include "utils.h"
 #include "put_bits.h"
-#include "map.h" // https://github.com/rxi/map
+#include "startcode.h"
+#include "vdpau_vp9_qlookup.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -99,25 +105,7 @@ is_supported_profile(
     VdpDecoderProfile    profile
 )
 {
-    VdpBool is_supported = VDP_FALSE;
-    VdpStatus vdp_status;
-    uint32_t max_level, max_references, max_width, max_height;
-
-    if (profile == (VdpDecoderProfile)-1)
-        return VDP_FALSE;
-
-    vdp_status = vdpau_decoder_query_capabilities(
-        driver_data,
-        driver_data->vdp_device,
-        profile,
-        &is_supported,
-        &max_level,
-        &max_references,
-        &max_width,
-        &max_height
-    );
-    return (VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderQueryCapabilities()") &&
-            is_supported);
+    return vdpau_caps_get_decoder(driver_data, profile, NULL, NULL);
 }
 
 // Checks decoder for profile/entrypoint is available
@@ -180,41 +168,45 @@ static inline int get_num_ref_frames(object_context_p obj_context)
 }
 
 // Ensure VDPAU decoder is created for the specified number of reference frames
-static VdpStatus
+VdpStatus
 ensure_decoder_with_max_refs(
     vdpau_driver_data_t *driver_data,
     object_context_p     obj_context,
     int                  max_ref_frames
 )
 {
-    VdpStatus vdp_status;
+    int level_max_ref_frames;
 
+    level_max_ref_frames = get_max_ref_frames(obj_context->vdp_profile,
+                                              obj_context->picture_width,
+                                              obj_context->picture_height);
     if (max_ref_frames < 0)
-        max_ref_frames =
-            get_max_ref_frames(obj_context->vdp_profile,
-                               obj_context->picture_width,
-                               obj_context->picture_height);
+        max_ref_frames = level_max_ref_frames;
 
     if (obj_context->vdp_decoder == VDP_INVALID_HANDLE ||
         obj_context->max_ref_frames < max_ref_frames) {
-        obj_context->max_ref_frames = max_ref_frames;
-
         if (obj_context->vdp_decoder != VDP_INVALID_HANDLE) {
+            /* Queued decode jobs still reference the old decoder */
+            if (obj_context->decode_worker)
+                decode_worker_sync(obj_context->decode_worker);
             vdpau_decoder_destroy(driver_data, obj_context->vdp_decoder);
             obj_context->vdp_decoder = VDP_INVALID_HANDLE;
         }
 
-        vdp_status = vdpau_decoder_create(
+        /* Avoid recreating the decoder mid-stream as references grow */
+        if (decoder_cache_preallocate(driver_data) &&
+            max_ref_frames < level_max_ref_frames)
+            max_ref_frames = level_max_ref_frames;
+
+        return decoder_cache_acquire(
             driver_data,
-            driver_data->vdp_device,
             obj_context->vdp_profile,
             obj_context->picture_width,
             obj_context->picture_height,
             max_ref_frames,
-            &obj_context->vdp_decoder
+            &obj_context->vdp_decoder,
+            &obj_context->max_ref_frames
         );
-        if (!VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderCreate()"))
-            return vdp_status;
     }
     return VDP_STATUS_OK;
 }
@@ -256,6 +248,70 @@ alloc_VdpBitstreamBuffer(object_context_p obj_context)
     return &vdp_bitstream_buffers[obj_context->vdp_bitstream_buffers_count++];
 }
 
+// Checks whether bitstream hunks are assembled into a single buffer
+static int use_bitstream_assembly(void)
+{
+    static int g_use_bitstream_assembly = -1;
+
+    if (g_use_bitstream_assembly < 0) {
+        if (getenv_yesno("VDPAU_VIDEO_BITSTREAM_ASSEMBLY", &g_use_bitstream_assembly) < 0)
+            g_use_bitstream_assembly = 0;
+    }
+    return g_use_bitstream_assembly;
+}
+
+// Grow the bitstream assembly buffer for SIZE more bytes. Buffer lives until vaDestroyContext()
+static uint8_t *
+reserve_bitstream_data(object_context_p obj_context, unsigned int size)
+{
+    uint8_t *bitstream_data = obj_context->bitstream_data;
+    unsigned int size_max;
+
+    size_max = obj_context->bitstream_data_size + size;
+    if (size_max > obj_context->bitstream_data_size_max) {
+        size_max = MAX(size_max, 2 * obj_context->bitstream_data_size_max);
+        bitstream_data = realloc(bitstream_data, size_max);
+        if (!bitstream_data)
+            return NULL;
+        obj_context->bitstream_data          = bitstream_data;
+        obj_context->bitstream_data_size_max = size_max;
+
+        /* The only VdpBitstreamBuffer points to the assembly buffer */
+        if (obj_context->vdp_bitstream_buffers_count > 0)
+            obj_context->vdp_bitstream_buffers[0].bitstream = bitstream_data;
+    }
+    return bitstream_data + obj_context->bitstream_data_size;
+}
+
+// Append hunk to the single VDPAU buffer of the picture
+static int
+assemble_VdpBitstreamBuffer(
+    object_context_p obj_context,
+    const uint8_t   *buffer,
+    uint32_t         buffer_size
+)
+{
+    VdpBitstreamBuffer *bitstream_buffer;
+    uint8_t *bitstream_data;
+
+    bitstream_data = reserve_bitstream_data(obj_context, buffer_size);
+    if (!bitstream_data)
+        return -1;
+    memcpy(bitstream_data, buffer, buffer_size);
+    obj_context->bitstream_data_size += buffer_size;
+
+    if (obj_context->vdp_bitstream_buffers_count == 0) {
+        bitstream_buffer = alloc_VdpBitstreamBuffer(obj_context);
+        if (!bitstream_buffer)
+            return -1;
+        bitstream_buffer->struct_version = VDP_BITSTREAM_BUFFER_VERSION;
+        bitstream_buffer->bitstream      = obj_context->bitstream_data;
+    }
+    obj_context->vdp_bitstream_buffers[0].bitstream_bytes =
+        obj_context->bitstream_data_size;
+    return 0;
+}
+
 // Append VASliceDataBuffer hunk into VDPAU buffer
 static int
 append_VdpBitstreamBuffer(
@@ -266,6 +322,20 @@ append_VdpBitstreamBuffer(
 {
     VdpBitstreamBuffer *bitstream_buffer;
 
+    if (use_bitstream_assembly())
+        return assemble_VdpBitstreamBuffer(obj_context, buffer, buffer_size);
+
+    /* Join hunks that directly follow each other, e.g. batched slices */
+    if (obj_context->vdp_bitstream_buffers_count > 0) {
+        bitstream_buffer = &obj_context->vdp_bitstream_buffers[
+            obj_context->vdp_bitstream_buffers_count - 1];
+        if ((const uint8_t *)bitstream_buffer->bitstream +
+            bitstream_buffer->bitstream_bytes == buffer) {
+            bitstream_buffer->bitstream_bytes += buffer_size;
+            return 0;
+        }
+    }
+
     bitstream_buffer = alloc_VdpBitstreamBuffer(obj_context);
     if (!bitstream_buffer)
         return -1;
@@ -276,6 +346,42 @@ append_VdpBitstreamBuffer(
     return 0;
 }
 
+// Get slice data from VASliceDataBuffer, clamped to the end of the buffer
+static const uint8_t *
+get_slice_data(
+    object_buffer_p     obj_buffer,
+    unsigned int        slice_data_offset,
+    unsigned int       *slice_data_size
+)
+{
+    const unsigned int buffer_size = obj_buffer->buffer_size;
+
+    if (slice_data_offset > buffer_size) {
+        D(bug("slice data offset %u is past the end of the buffer (%u bytes)\n",
+              slice_data_offset, buffer_size));
+        return NULL;
+    }
+    if (*slice_data_size > buffer_size - slice_data_offset) {
+        D(bug("slice data size %u exceeds the buffer, clamped to %u bytes\n",
+              *slice_data_size, buffer_size - slice_data_offset));
+        *slice_data_size = buffer_size - slice_data_offset;
+    }
+    return (const uint8_t *)obj_buffer->buffer_data + slice_data_offset;
+}
+
+// Checks whether slice data begins with a start code, possibly after zero bytes
+static int
+has_start_code(const uint8_t *buf, unsigned int size)
+{
+    const int ret = startcode_check_leading(buf, size);
+
+    /* Scanning the whole slice is only worth it to report batched NAL units */
+    D(if (!ret && debug_enabled() && startcode_find(buf, size) < size)
+          bug("slice data holds several NAL units, the first one at "
+              "offset 0 has no start code\n"));
+    return ret;
+}
+
 // Initialize VdpReferenceFrameH264 to default values
 static void init_VdpReferenceFrameH264(VdpReferenceFrameH264 *rf)
 {
@@ -354,31 +460,6 @@ static const uint8_t ff_mpeg4_default_non_intra_matrix[64] = {
     23, 24, 25, 27, 28, 30, 31, 33,
 };
 
-/* VP9 8-Bit Quantization Coefficients, reverse lookup
- * From <https://chromium.googlesource.com/chromium/src/+/master/media/filters/vp9_parser.cc>
- * XXX: Is there a better way to do this?
- * VA-API provides only the coefficients after looking them up in an array, but
- * VDPAU wants the raw indices (qpYAc, qpYDc, qpChDc, qpChAc).
- * 
- * So we have to derive the original indices using reverse lookup below.
- * Duplicate coefficients are matched to the first index in which they occur.
- * That's why there is less than 256 entries, for DC.
- * This is *not* a perfect reverse lookup, but seems close enough.
- * These are fed into a makeshift hash table for faster lookup.
- */
-static const int16_t vp9_dcq_8bit_coeff[239] = {4, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 87, 88, 90, 92, 93, 95, 96, 98, 99, 101, 102, 104, 105, 107, 108, 110, 111, 113, 114, 116, 117, 118, 120, 121, 123, 125, 127, 129, 131, 134, 136, 138, 140, 142, 144, 146, 148, 150, 152, 154, 156, 158, 161, 164, 166, 169, 172, 174, 177, 180, 182, 185, 187, 190, 192, 195, 199, 202, 205, 208, 211, 214, 217, 220, 223, 226, 230, 233, 237, 240, 243, 247, 250, 253, 257, 261, 265, 269, 272, 276, 280, 284, 288, 292, 296, 300, 304, 309, 313, 317, 322, 326, 330, 335, 340, 344, 349, 354, 359, 364, 369, 374, 379, 384, 389, 395, 400, 406, 411, 417, 423, 429, 435, 441, 447, 454, 461, 467, 475, 482, 489, 497, 505, 513, 522, 530, 539, 549, 559, 569, 579, 590, 602, 614, 626, 640, 654, 668, 684, 700, 717, 736, 755, 775, 796, 819, 843, 869, 896, 925, 955, 988, 1022, 1058, 1098, 1139, 1184, 1232, 1282, 1336};
-
-static const int16_t vp9_dcq_8bit_idx[239] = {0, 1, 3, 4, 5, 6, 8, 9, 10, 11, 12, 13, 14, 16, 17, 18, 19, 20, 21, 22,   24, 25, 26, 27, 28, 29, 31, 32, 33, 34, 35, 36, 38, 39, 40, 41, 42, 44, 45, 46, 47, 48, 50, 51, 52, 53, 54, 56, 57, 58, 59, 61, 62, 63, 64, 65, 67, 68, 69, 70, 72, 73, 74, 75, 77, 78, 79, 80, 82, 83, 84, 85, 87, 88, 89, 91, 92, 93, 94, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239, 240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255};
-
-static const int16_t vp9_acq_8bit_coeff[256] = {4, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126, 128, 130, 132, 134, 136, 138, 140, 142, 144, 146, 148, 150, 152, 155, 158, 161, 164, 167, 170, 173, 176, 179, 182, 185, 188, 191, 194, 197, 200, 203, 207, 211, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255, 260, 265, 270, 275, 280, 285, 290, 295, 300, 305, 311, 317, 323, 329, 335, 341, 347, 353, 359, 366, 373, 380, 387, 394, 401, 408, 416, 424, 432, 440, 448, 456, 465, 474, 483, 492, 501, 510, 520, 530, 540, 550, 560, 571, 582, 593, 604, 615, 627, 639, 651, 663, 676, 689, 702, 715, 729, 743, 757, 771, 786, 801, 816, 832, 848, 864, 881, 898, 915, 933, 951, 969, 988, 1007, 1026, 1046, 1066, 1087, 1108, 1129, 1151, 1173, 1196, 1219, 1243, 1267, 1292, 1317, 1343, 1369, 1396, 1423, 1451, 1479, 1508, 1537, 1567, 1597, 1628, 1660, 1692, 1725, 1759, 1793, 1828};
-
-static const int16_t vp9_acq_8bit_idx[256] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239, 240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255};
-
-// Hash tables
-static map_int_t g_vp9DcQReverseLookup;
-static map_int_t g_vp9AcQReverseLookup;
-static bool g_vp9QuantMapsSetup = false;
-
 // Compute integer log2
 static inline int ilog2(uint32_t v)
 {
@@ -471,8 +552,14 @@ translate_VASliceDataBuffer_MPEG2(
     /* Check we have the start code */
     for (i = 0; i < obj_context->last_slice_params_count; i++) {
         VASliceParameterBufferMPEG2 * const slice_param = &slice_params[i];
-        uint8_t * const buf = (uint8_t *)obj_buffer->buffer_data + slice_param->slice_data_offset;
-        if (memcmp(buf, start_code_prefix, sizeof(start_code_prefix)) != 0) {
+        unsigned int slice_data_size = slice_param->slice_data_size;
+        const uint8_t * const buf = get_slice_data(obj_buffer,
+                                                   slice_param->slice_data_offset,
+                                                   &slice_data_size);
+        if (!buf)
+            return 0;
+        if (slice_data_size < sizeof(start_code_prefix) ||
+            memcmp(buf, start_code_prefix, sizeof(start_code_prefix)) != 0) {
             if (append_VdpBitstreamBuffer(obj_context,
                                           start_code_prefix,
                                           sizeof(start_code_prefix)) < 0)
@@ -486,7 +573,7 @@ translate_VASliceDataBuffer_MPEG2(
         }
         if (append_VdpBitstreamBuffer(obj_context,
                                       buf,
-                                      slice_param->slice_data_size) < 0)
+                                      slice_data_size) < 0)
             return 0;
     }
     return 1;
@@ -500,6 +587,13 @@ translate_VASliceDataBuffer(
     object_buffer_p     obj_buffer
 )
 {
+    /* Reserve room for all slices and their generated start codes and
+       headers at once, so that the hunks are copied without reallocation */
+    if (use_bitstream_assembly() &&
+        !reserve_bitstream_data(obj_context, obj_buffer->buffer_size +
+                                4 * obj_context->last_slice_params_count + 32))
+        return 0;
+
     if (obj_context->vdp_codec == VDP_CODEC_H264) {
         /* Check we have the start code */
         /* XXX: check for other codecs too? */
@@ -509,8 +603,14 @@ translate_VASliceDataBuffer(
         unsigned int i;
         for (i = 0; i < obj_context->last_slice_params_count; i++) {
             VASliceParameterBufferH264 * const slice_param = &slice_params[i];
-            uint8_t *buf = (uint8_t *)obj_buffer->buffer_data + slice_param->slice_data_offset;
-            if (memcmp(buf, start_code_prefix, sizeof(start_code_prefix)) != 0) {
+            unsigned int slice_data_size = slice_param->slice_data_size;
+            const uint8_t * const buf = get_slice_data(obj_buffer,
+                                                       slice_param->slice_data_offset,
+                                                       &slice_data_size);
+            if (!buf)
+                return 0;
+            /* Batched NAL units after the first one keep their own start codes */
+            if (!has_start_code(buf, slice_data_size)) {
                 if (append_VdpBitstreamBuffer(obj_context,
                                               start_code_prefix,
                                               sizeof(start_code_prefix)) < 0)
@@ -518,7 +618,7 @@ translate_VASliceDataBuffer(
             }
             if (append_VdpBitstreamBuffer(obj_context,
                                           buf,
-                                          slice_param->slice_data_size) < 0)
+                                          slice_data_size) < 0)
                 return 0;
         }
         return 1;
@@ -533,11 +633,17 @@ translate_VASliceDataBuffer(
         unsigned int i;
         for (i = 0; i < obj_context->last_slice_params_count; i++) {
             VASliceParameterBufferVP9 * const slice_param = &slice_params[i];
-            uint8_t *buf = (uint8_t *)obj_buffer->buffer_data + slice_param->slice_data_offset;
+            unsigned int slice_data_size = slice_param->slice_data_size;
+            const uint8_t * const buf = get_slice_data(obj_buffer,
+                                                       slice_param->slice_data_offset,
+                                                       &slice_data_size);
+            if (!buf)
+                return 0;
             if (trace_enabled())
                 trace_print("translate_VASliceDataBuffer: VP9: process slice param #%d\n", i);
 
-            if (memcmp(buf, start_code_prefix, sizeof(start_code_prefix)) != 0) {
+            if (slice_data_size < sizeof(start_code_prefix) ||
+                memcmp(buf, start_code_prefix, sizeof(start_code_prefix)) != 0) {
                 if (append_VdpBitstreamBuffer(obj_context,
                                               start_code_prefix,
                                               sizeof(start_code_prefix)) < 0)
@@ -545,7 +651,7 @@ translate_VASliceDataBuffer(
             }
             if (append_VdpBitstreamBuffer(obj_context,
                                           buf,
-                                          slice_param->slice_data_size) < 0) {
+                                          slice_data_size) < 0) {
                 D(bug("ERROR: append_VdpBitstreamBuffer\n"));
                 return 0;
             }
@@ -1287,10 +1393,10 @@ translate_VASliceParameterBufferVP9(
     // same. [except for minor index lookup differences due to
     // duplications in the DC table].
 
-    int *val = map_get(&g_vp9AcQReverseLookup, seg->luma_ac_quant_scale);
+    int val = vp9_ac_qindex(seg->luma_ac_quant_scale);
     int q_index = 0;
-    if (val) {
-        q_index = *val;
+    if (val >= 0) {
+        q_index = val;
         if (trace_enabled())
             trace_print("luma_ac_quant_scale=%d ==> q_index=%d\n", seg->luma_ac_quant_scale, q_index);
     } else {
@@ -1298,10 +1404,10 @@ translate_VASliceParameterBufferVP9(
     }
     pic_info->qpYAc = q_index;
     
-    val = map_get(&g_vp9DcQReverseLookup, seg->luma_dc_quant_scale);
+    val = vp9_dc_qindex(seg->luma_dc_quant_scale);
     int delta_q_y_dc = 0;
-    if (val) {
-        delta_q_y_dc = *val - q_index;
+    if (val >= 0) {
+        delta_q_y_dc = val - q_index;
         if (trace_enabled())
             trace_print("luma_dc_quant_scale=%d ==> delta_q_y_dc=%d\n", seg->luma_dc_quant_scale, delta_q_y_dc);
     } else {
@@ -1309,10 +1415,10 @@ translate_VASliceParameterBufferVP9(
     }
     pic_info->qpYDc = delta_q_y_dc;
 
-    val = map_get(&g_vp9DcQReverseLookup, seg->chroma_dc_quant_scale);
+    val = vp9_dc_qindex(seg->chroma_dc_quant_scale);
     int delta_q_uv_dc = 0;
-    if (val) {
-        delta_q_uv_dc = *val - q_index;
+    if (val >= 0) {
+        delta_q_uv_dc = val - q_index;
         if (trace_enabled())
             trace_print("chroma_dc_quant_scale=%d ==> delta_q_uv_dc=%d\n", seg->chroma_dc_quant_scale, delta_q_uv_dc);
     } else {
@@ -1320,10 +1426,10 @@ translate_VASliceParameterBufferVP9(
     }
     pic_info->qpChDc = delta_q_uv_dc;
 
-    val = map_get(&g_vp9AcQReverseLookup, seg->chroma_ac_quant_scale);
+    val = vp9_ac_qindex(seg->chroma_ac_quant_scale);
     int delta_q_uv_ac = 0;
-    if (val) {
-        delta_q_uv_ac = *val - q_index;
+    if (val >= 0) {
+        delta_q_uv_ac = val - q_index;
         if (trace_enabled())
             trace_print("chroma_ac_quant_scale=%d ==> delta_q_uv_ac=%d\n", seg->chroma_ac_quant_scale, delta_q_uv_ac);
     } else {
@@ -1352,12 +1458,6 @@ translate_VASliceParameterBufferVP9(
     return 1;
 }
 
-// Translate VA buffer
-typedef int
-(*translate_buffer_func_t)(vdpau_driver_data_t *driver_data,
-                           object_context_p    obj_context,
-                           object_buffer_p     obj_buffer);
-
 typedef struct translate_buffer_info translate_buffer_info_t;
 struct translate_buffer_info {
     VdpCodec codec;
@@ -1365,12 +1465,9 @@ struct translate_buffer_info {
     translate_buffer_func_t func;
 };
 
-static int
-translate_buffer(
-    vdpau_driver_data_t *driver_data,
-    object_context_p    obj_context,
-    object_buffer_p     obj_buffer
-)
+// Resolves the buffer translation functions for the context codec
+void
+init_translate_buffer_funcs(object_context_p obj_context)
 {
     static const translate_buffer_info_t translate_info[] = {
 #define _(CODEC, TYPE)                                  \
@@ -1397,13 +1494,35 @@ translate_buffer(
         { 0, 0, NULL }
     };
     const translate_buffer_info_t *tbip;
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_ELEMS(obj_context->translate_buffer_funcs); i++)
+        obj_context->translate_buffer_funcs[i] = NULL;
+
     for (tbip = translate_info; tbip->func != NULL; tbip++) {
         if (tbip->codec && tbip->codec != obj_context->vdp_codec)
             continue;
-        if (tbip->type != obj_buffer->type)
-            continue;
-        return tbip->func(driver_data, obj_context, obj_buffer);
+        ASSERT(tbip->type < ARRAY_ELEMS(obj_context->translate_buffer_funcs));
+        obj_context->translate_buffer_funcs[tbip->type] = tbip->func;
     }
+}
+
+// Translate VA buffer
+static int
+translate_buffer(
+    vdpau_driver_data_t *driver_data,
+    object_context_p    obj_context,
+    object_buffer_p     obj_buffer
+)
+{
+    const unsigned int type = obj_buffer->type;
+    translate_buffer_func_t func = NULL;
+
+    if (type < ARRAY_ELEMS(obj_context->translate_buffer_funcs))
+        func = obj_context->translate_buffer_funcs[type];
+    if (func)
+        return func(driver_data, obj_context, obj_buffer);
+
     D(bug("ERROR: no translate function found for %s%s\n",
           string_of_VABufferType(obj_buffer->type),
           obj_context->vdp_codec ? string_of_VdpCodec(obj_context->vdp_codec) : NULL));
@@ -1524,6 +1643,8 @@ vdpau_BeginPicture(
     if (!obj_surface)
         return VA_STATUS_ERROR_INVALID_SURFACE;
 
+    TIMELINE_SCOPE(timeline, "vaBeginPicture", context, render_target);
+
     obj_surface->va_surface_status           = VASurfaceRendering;
     obj_context->last_pic_param              = NULL;
     obj_context->last_slice_params           = NULL;
@@ -1531,6 +1652,9 @@ vdpau_BeginPicture(
     obj_context->current_render_target       = obj_surface->base.id;
     obj_context->gen_slice_data_size         = 0;
     obj_context->vdp_bitstream_buffers_count = 0;
+    obj_context->bitstream_data_size         = 0;
+
+    capture_begin_picture(driver_data, obj_context, obj_surface);
 
     switch (obj_context->vdp_codec) {
     case VDP_CODEC_MPEG1:
@@ -1546,20 +1670,6 @@ vdpau_BeginPicture(
         obj_context->vdp_picture_info.vc1.slice_count = 0;
         break;
     case VDP_CODEC_VP9:
-        // XXX: setting up these maps elsewhere would be more proper
-        if (!g_vp9QuantMapsSetup) {
-            map_init(&g_vp9DcQReverseLookup);
-            for (int i = 0; i < sizeof(vp9_dcq_8bit_coeff) / sizeof(int16_t); i++)
-            {
-                map_set(&g_vp9DcQReverseLookup, vp9_dcq_8bit_coeff[i], vp9_dcq_8bit_idx[i]);
-            }
-            map_init(&g_vp9AcQReverseLookup);
-            for (int i = 0; i < sizeof(vp9_acq_8bit_coeff) / sizeof(int16_t); i++)
-            {
-                map_set(&g_vp9AcQReverseLookup, vp9_acq_8bit_coeff[i], vp9_acq_8bit_idx[i]);
-            }
-            g_vp9QuantMapsSetup = true;
-        }
         break;
     default:
         return VA_STATUS_ERROR_UNKNOWN;
@@ -1594,13 +1704,15 @@ vdpau_RenderPicture(
     /* Verify that we got valid buffer references */
     for (i = 0; i < num_buffers; i++) {
         object_buffer_p obj_buffer = VDPAU_BUFFER(buffers[i]);
-
-        D(bug("... buffers[%d]->type: %s (%d)\n", i, string_of_VABufferType(obj_buffer->type), obj_buffer->type));
-
         if (!obj_buffer)
             return VA_STATUS_ERROR_INVALID_BUFFER;
+
+        D(bug("... buffers[%d]->type: %s (%d)\n", i, string_of_VABufferType(obj_buffer->type), obj_buffer->type));
     }
 
+    for (i = 0; i < num_buffers; i++)
+        capture_buffer(driver_data, obj_context, VDPAU_BUFFER(buffers[i]));
+
     /* Translate buffers */
     for (i = 0; i < num_buffers; i++) {
         object_buffer_p obj_buffer = VDPAU_BUFFER(buffers[i]);
@@ -1651,6 +1763,12 @@ vdpau_EndPicture(
     if (!obj_surface)
         return VA_STATUS_ERROR_INVALID_SURFACE;
 
+    TIMELINE_SCOPE(timeline, "vaEndPicture", context, obj_surface->base.id);
+    if (timeline.start)
+        obj_surface->timeline_flow = timeline.flow_start = timeline_new_flow();
+
+    invalidate_surface_copies(obj_surface);
+
     if (trace_enabled()) {
         switch (obj_context->vdp_codec) {
         case VDP_CODEC_MPEG1:
@@ -1677,6 +1795,7 @@ vdpau_EndPicture(
         for (i = 0; i < obj_context->vdp_bitstream_buffers_count; i++)
             dump_VdpBitstreamBuffer(&obj_context->vdp_bitstream_buffers[i]);
     }
+    capture_end_picture(driver_data, obj_context);
 
     D(bug("rendering to surface %x\n", obj_context->current_render_target));
     VAStatus va_status;
@@ -1688,19 +1807,30 @@ vdpau_EndPicture(
     );
 
     D(bug("vdp_status after ensure = %d\n", vdp_status));
-    if (vdp_status == VDP_STATUS_OK)
-        vdp_status = vdpau_decoder_render(
-            driver_data,
-            obj_context->vdp_decoder,
-            obj_surface->vdp_surface,
-            (VdpPictureInfo*)&obj_context->vdp_picture_info,
-            obj_context->vdp_bitstream_buffers_count,
-            obj_context->vdp_bitstream_buffers
+    if (vdp_status == VDP_STATUS_OK && obj_context->decode_worker) {
+        va_status = decode_worker_submit(
+            obj_context->decode_worker,
+            obj_context,
+            obj_surface
         );
-    va_status = vdpau_get_VAStatus(vdp_status);
-    D(bug("vdp_status after render = %d\n", vdp_status));
+        D(bug("va_status after submit = %d\n", va_status));
+    }
+    else {
+        if (vdp_status == VDP_STATUS_OK)
+            vdp_status = vdpau_decoder_render(
+                driver_data,
+                obj_context->vdp_decoder,
+                obj_surface->vdp_surface,
+                (VdpPictureInfo*)&obj_context->vdp_picture_info,
+                obj_context->vdp_bitstream_buffers_count,
+                obj_context->vdp_bitstream_buffers
+            );
+        va_status = vdpau_get_VAStatus(vdp_status);
+        D(bug("vdp_status after render = %d\n", vdp_status));
+    }
 
-    /* XXX: assume we are done with rendering right away */
+    /* Completion is tracked per surface: VDPAU serializes later operations
+       on the surface, and the decode worker signals queued jobs */
     obj_context->current_render_target = VA_INVALID_SURFACE;
 
     /* Release pending buffers */
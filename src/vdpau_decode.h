@@ -32,6 +32,15 @@ typedef enum {
     VDP_CODEC_VP9
 } VdpCodec;
 
+// Translates a VA buffer into VDPAU picture info or bitstream buffers
+typedef int
+(*translate_buffer_func_t)(vdpau_driver_data_t *driver_data,
+                           object_context_p    obj_context,
+                           object_buffer_p     obj_buffer);
+
+// Number of VABufferType values with a translation function
+#define VDPAU_MAX_TRANSLATE_BUFFER_TYPES (VASliceDataBufferType + 1)
+
 // Translates VdpDecoderProfile to VdpCodec
 VdpCodec get_VdpCodec(VdpDecoderProfile profile)
     attribute_hidden;
@@ -40,6 +49,11 @@ VdpCodec get_VdpCodec(VdpDecoderProfile profile)
 VdpDecoderProfile get_VdpDecoderProfile(VAProfile profile)
     attribute_hidden;
 
+// Resolves the buffer translation functions for the context codec
+void
+init_translate_buffer_funcs(object_context_p obj_context)
+    attribute_hidden;
+
 // Checks decoder for profile/entrypoint is available
 VAStatus
 check_decoder(
@@ -48,6 +62,14 @@ check_decoder(
     VAEntrypoint         entrypoint
 ) attribute_hidden;
 
+// Ensure VDPAU decoder is created for the specified number of reference frames
+VdpStatus
+ensure_decoder_with_max_refs(
+    vdpau_driver_data_t *driver_data,
+    object_context_p     obj_context,
+    int                  max_ref_frames
+) attribute_hidden;
+
 // vaQueryConfigProfiles
 VAStatus
 vdpau_QueryConfigProfiles(
@@ -0,0 +1,275 @@
+/*
+ *  vdpau_decode_worker.c - VDPAU backend for VA-API (asynchronous decode)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_decode_worker.h"
+#include "vdpau_buffer.h"
+#include "vdpau_video.h"
+#include "uasyncqueue.h"
+#include "utils.h"
+#include <pthread.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+// Default number of picture slots, i.e. decode jobs that may be pending at once
+#define DECODE_WORKER_DEPTH 4
+
+/* A picture slot owns the storage of one submitted picture until the
+   picture is decoded and the slot is reused by a later vaEndPicture() */
+typedef struct decode_slot decode_slot_t;
+struct decode_slot {
+    unsigned int                seq;    /* 0 once retired */
+    unsigned int                quit;
+    VdpDecoder                  vdp_decoder;
+    object_surface_p            obj_surface;
+    union vdp_picture_info      vdp_picture_info;
+    VdpBitstreamBuffer         *vdp_bitstream_buffers;
+    unsigned int                vdp_bitstream_buffers_count;
+    unsigned int                vdp_bitstream_buffers_count_max;
+    uint8_t                    *gen_slice_data;
+    unsigned int                gen_slice_data_size_max;
+    uint8_t                    *bitstream_data;
+    unsigned int                bitstream_data_size_max;
+    VABufferID                 *dead_buffers;
+    uint32_t                    dead_buffers_count;
+    uint32_t                    dead_buffers_count_max;
+};
+
+struct decode_worker {
+    vdpau_driver_data_t        *driver_data;
+    pthread_t                   thread;
+    UAsyncQueue                *jobs;
+    pthread_mutex_t             mutex;
+    pthread_cond_t              cond;
+    decode_slot_t              *slots;
+    unsigned int                num_slots;
+    unsigned int                next_slot;
+    decode_slot_t               quit_slot;
+    unsigned int                submitted_seq;
+    unsigned int                completed_seq;
+};
+
+#define SWAP(a, b) do {                         \
+        typeof(a) tmp_ = (a);                   \
+        (a) = (b);                              \
+        (b) = tmp_;                             \
+    } while (0)
+
+// Check whether decode jobs are to be submitted from a worker thread
+int decode_worker_enabled(void)
+{
+    static int g_decode_worker_enabled = -1;
+
+    if (g_decode_worker_enabled < 0) {
+        if (getenv_yesno("VDPAU_VIDEO_ASYNC_DECODE", &g_decode_worker_enabled) < 0)
+            g_decode_worker_enabled = 0;
+    }
+    return g_decode_worker_enabled;
+}
+
+// Sequence numbers wrap around, compare them as such
+static inline int seq_is_done(unsigned int completed_seq, unsigned int seq)
+{
+    return (int)(completed_seq - seq) >= 0;
+}
+
+// Release the VA buffers of a decoded picture
+static void
+decode_slot_retire(vdpau_driver_data_t *driver_data, decode_slot_t *slot)
+{
+    object_buffer_p obj_buffer;
+    unsigned int i;
+
+    for (i = 0; i < slot->dead_buffers_count; i++) {
+        obj_buffer = VDPAU_BUFFER(slot->dead_buffers[i]);
+        ASSERT(obj_buffer);
+        destroy_va_buffer(driver_data, obj_buffer);
+    }
+    slot->dead_buffers_count = 0;
+    slot->seq = 0;
+}
+
+// Hand the picture storage of the context over to SLOT, and the previous
+// storage of SLOT over to the context for the next picture
+static void
+decode_slot_swap(decode_slot_t *slot, object_context_p obj_context)
+{
+    SWAP(slot->vdp_bitstream_buffers, obj_context->vdp_bitstream_buffers);
+    SWAP(slot->vdp_bitstream_buffers_count, obj_context->vdp_bitstream_buffers_count);
+    SWAP(slot->vdp_bitstream_buffers_count_max, obj_context->vdp_bitstream_buffers_count_max);
+    SWAP(slot->gen_slice_data, obj_context->gen_slice_data);
+    SWAP(slot->gen_slice_data_size_max, obj_context->gen_slice_data_size_max);
+    SWAP(slot->bitstream_data, obj_context->bitstream_data);
+    SWAP(slot->bitstream_data_size_max, obj_context->bitstream_data_size_max);
+    SWAP(slot->dead_buffers, obj_context->dead_buffers);
+    SWAP(slot->dead_buffers_count, obj_context->dead_buffers_count);
+    SWAP(slot->dead_buffers_count_max, obj_context->dead_buffers_count_max);
+    obj_context->vdp_bitstream_buffers_count = 0;
+    obj_context->gen_slice_data_size         = 0;
+    obj_context->bitstream_data_size         = 0;
+    slot->vdp_picture_info = obj_context->vdp_picture_info;
+}
+
+static void *decode_worker_thread(void *arg)
+{
+    decode_worker_t * const worker = arg;
+    vdpau_driver_data_t * const driver_data = worker->driver_data;
+    decode_slot_t *slot;
+    VdpStatus vdp_status;
+
+    for (;;) {
+        slot = async_queue_pop(worker->jobs);
+        if (!slot)
+            continue;
+        if (slot->quit)
+            break;
+
+        vdp_status = vdpau_decoder_render(
+            driver_data,
+            slot->vdp_decoder,
+            slot->obj_surface->vdp_surface,
+            (VdpPictureInfo *)&slot->vdp_picture_info,
+            slot->vdp_bitstream_buffers_count,
+            slot->vdp_bitstream_buffers
+        );
+        VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderRender()");
+        surface_decode_end(slot->obj_surface, slot->seq,
+                           vdpau_get_VAStatus(vdp_status));
+
+        /* The slot is retired by the submitter, once it needs it again */
+        pthread_mutex_lock(&worker->mutex);
+        worker->completed_seq = slot->seq;
+        pthread_cond_broadcast(&worker->cond);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return NULL;
+}
+
+// Create decode worker thread
+decode_worker_t *
+decode_worker_new(vdpau_driver_data_t *driver_data)
+{
+    decode_worker_t *worker;
+    int max_pending;
+
+    worker = calloc(1, sizeof(*worker));
+    if (!worker)
+        return NULL;
+
+    if (getenv_int("VDPAU_VIDEO_ASYNC_DECODE_DEPTH", &max_pending) < 0 ||
+        max_pending < 1)
+        max_pending = DECODE_WORKER_DEPTH;
+
+    worker->driver_data     = driver_data;
+    worker->num_slots       = max_pending;
+    worker->quit_slot.quit  = 1;
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+
+    worker->slots = calloc(worker->num_slots, sizeof(worker->slots[0]));
+    if (!worker->slots)
+        goto error;
+    worker->jobs = async_queue_new();
+    if (!worker->jobs)
+        goto error;
+    if (pthread_create(&worker->thread, NULL, decode_worker_thread, worker) != 0)
+        goto error;
+    return worker;
+
+error:
+    free(worker->slots);
+    async_queue_free(worker->jobs);
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->mutex);
+    free(worker);
+    return NULL;
+}
+
+// Wait for all pending jobs and destroy decode worker thread
+void
+decode_worker_free(decode_worker_t *worker)
+{
+    unsigned int i;
+
+    if (!worker)
+        return;
+
+    async_queue_push(worker->jobs, &worker->quit_slot);
+    pthread_join(worker->thread, NULL);
+
+    for (i = 0; i < worker->num_slots; i++) {
+        decode_slot_t * const slot = &worker->slots[i];
+        decode_slot_retire(worker->driver_data, slot);
+        free(slot->vdp_bitstream_buffers);
+        free(slot->gen_slice_data);
+        free(slot->bitstream_data);
+        free(slot->dead_buffers);
+    }
+    free(worker->slots);
+    async_queue_free(worker->jobs);
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->mutex);
+    free(worker);
+}
+
+// Queue a decode job built from the current context state
+VAStatus
+decode_worker_submit(
+    decode_worker_t     *worker,
+    object_context_p     obj_context,
+    object_surface_p     obj_surface
+)
+{
+    decode_slot_t * const slot = &worker->slots[worker->next_slot];
+
+    /* Throttle the submitter so that it runs at most num_slots jobs
+       ahead, i.e. wait for the picture submitted from this slot */
+    pthread_mutex_lock(&worker->mutex);
+    while (slot->seq && !seq_is_done(worker->completed_seq, slot->seq))
+        pthread_cond_wait(&worker->cond, &worker->mutex);
+    pthread_mutex_unlock(&worker->mutex);
+    decode_slot_retire(worker->driver_data, slot);
+
+    if (++worker->submitted_seq == 0)   /* 0 means "no pending job" */
+        ++worker->submitted_seq;
+    if (++worker->next_slot == worker->num_slots)
+        worker->next_slot = 0;
+
+    /* VA buffers and generated data now live until the slot retires */
+    decode_slot_swap(slot, obj_context);
+    slot->seq         = worker->submitted_seq;
+    slot->vdp_decoder = obj_context->vdp_decoder;
+    slot->obj_surface = obj_surface;
+
+    surface_decode_begin(obj_surface, slot->seq);
+    async_queue_push(worker->jobs, slot);
+    return VA_STATUS_SUCCESS;
+}
+
+// Wait for all pending decode jobs to complete
+void
+decode_worker_sync(decode_worker_t *worker)
+{
+    pthread_mutex_lock(&worker->mutex);
+    while (!seq_is_done(worker->completed_seq, worker->submitted_seq))
+        pthread_cond_wait(&worker->cond, &worker->mutex);
+    pthread_mutex_unlock(&worker->mutex);
+}
@@ -0,0 +1,55 @@
+/*
+ *  vdpau_decode_worker.h - VDPAU backend for VA-API (asynchronous decode)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_DECODE_WORKER_H
+#define VDPAU_DECODE_WORKER_H
+
+#include "vdpau_driver.h"
+
+typedef struct decode_worker decode_worker_t;
+
+// Check whether decode jobs are to be submitted from a worker thread
+int decode_worker_enabled(void)
+    attribute_hidden;
+
+// Create decode worker thread
+decode_worker_t *
+decode_worker_new(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Wait for all pending jobs and destroy decode worker thread
+void
+decode_worker_free(decode_worker_t *worker)
+    attribute_hidden;
+
+// Queue a decode job built from the current context state
+VAStatus
+decode_worker_submit(
+    decode_worker_t     *worker,
+    object_context_p     obj_context,
+    object_surface_p     obj_surface
+) attribute_hidden;
+
+// Wait for all pending decode jobs to complete
+void
+decode_worker_sync(decode_worker_t *worker)
+    attribute_hidden;
+
+#endif /* VDPAU_DECODE_WORKER_H */
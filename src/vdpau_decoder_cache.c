@@ -0,0 +1,280 @@
+/*
+ *  vdpau_decoder_cache.c - VDPAU backend for VA-API (decoder cache)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_decoder_cache.h"
+#include "utils.h"
+#include <pthread.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+/* Default number of idle decoders kept, and for how long (in ms) */
+#define VDPAU_DECODER_CACHE_SIZE        2
+#define VDPAU_DECODER_CACHE_TIMEOUT     10000
+
+typedef struct {
+    VdpDecoderProfile   profile;
+    uint32_t            width;
+    uint32_t            height;
+    int                 max_refs;
+    VdpDecoder          decoder;
+    uint64_t            release_time;
+} decoder_cache_entry_t;
+
+struct vdpau_decoder_cache {
+    pthread_mutex_t         lock;
+    decoder_cache_entry_t  *entries;
+    unsigned int            num_entries;
+    unsigned int            num_entries_max;
+    unsigned int            max_entries;
+    uint64_t                timeout;        /* usec */
+    int                     preallocate;
+    uint64_t                num_hits;
+    uint64_t                num_misses;
+    uint64_t                num_evictions;
+};
+
+static decoder_cache_entry_t *
+decoder_cache_lookup(
+    vdpau_decoder_cache_t *cache,
+    VdpDecoderProfile      profile,
+    uint32_t               width,
+    uint32_t               height
+)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->num_entries; i++) {
+        decoder_cache_entry_t * const entry = &cache->entries[i];
+        if (entry->profile == profile &&
+            entry->width == width && entry->height == height)
+            return entry;
+    }
+    return NULL;
+}
+
+// Destroy the decoder of ENTRY and remove it from the cache
+static void
+decoder_cache_evict(
+    vdpau_driver_data_t   *driver_data,
+    vdpau_decoder_cache_t *cache,
+    decoder_cache_entry_t *entry
+)
+{
+    vdpau_decoder_destroy(driver_data, entry->decoder);
+    *entry = cache->entries[--cache->num_entries];
+    cache->num_evictions++;
+}
+
+// Drop expired decoders, then the least recently used ones over the limit
+static void
+decoder_cache_trim(vdpau_driver_data_t *driver_data, vdpau_decoder_cache_t *cache)
+{
+    const uint64_t now = get_ticks_usec();
+    decoder_cache_entry_t *entry, *lru_entry;
+    unsigned int i;
+
+    for (i = 0; i < cache->num_entries; ) {
+        entry = &cache->entries[i];
+        if (entry->release_time + cache->timeout <= now)
+            decoder_cache_evict(driver_data, cache, entry);
+        else
+            i++;
+    }
+
+    while (cache->num_entries > cache->max_entries) {
+        lru_entry = &cache->entries[0];
+        for (i = 1; i < cache->num_entries; i++) {
+            entry = &cache->entries[i];
+            if (entry->release_time < lru_entry->release_time)
+                lru_entry = entry;
+        }
+        decoder_cache_evict(driver_data, cache, lru_entry);
+    }
+}
+
+// Create cache of idle VDPAU decoders
+int
+vdpau_decoder_cache_init(vdpau_driver_data_t *driver_data)
+{
+    vdpau_decoder_cache_t *cache;
+    int value;
+
+    driver_data->decoder_cache = NULL;
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return -1;
+
+    if (getenv_int("VDPAU_VIDEO_DECODER_CACHE_SIZE", &value) < 0 || value < 0)
+        value = VDPAU_DECODER_CACHE_SIZE;
+    cache->max_entries = value;
+    if (getenv_int("VDPAU_VIDEO_DECODER_CACHE_TIMEOUT", &value) < 0 || value < 0)
+        value = VDPAU_DECODER_CACHE_TIMEOUT;
+    cache->timeout = (uint64_t)value * 1000;
+    if (getenv_yesno("VDPAU_VIDEO_DECODER_PREALLOCATE", &value) < 0)
+        value = 0;
+    cache->preallocate = value;
+
+    pthread_mutex_init(&cache->lock, NULL);
+    driver_data->decoder_cache = cache;
+    return 0;
+}
+
+// Destroy cache of idle VDPAU decoders
+void
+vdpau_decoder_cache_exit(vdpau_driver_data_t *driver_data)
+{
+    vdpau_decoder_cache_t * const cache = driver_data->decoder_cache;
+
+    if (!cache)
+        return;
+
+    D(bug("decoder cache: %llu hits, %llu misses, %llu evictions\n",
+          (unsigned long long)cache->num_hits,
+          (unsigned long long)cache->num_misses,
+          (unsigned long long)cache->num_evictions));
+
+    while (cache->num_entries > 0)
+        decoder_cache_evict(driver_data, cache, &cache->entries[0]);
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+    driver_data->decoder_cache = NULL;
+}
+
+// Checks whether decoders are created for the level maximum of references
+int
+decoder_cache_preallocate(vdpau_driver_data_t *driver_data)
+{
+    vdpau_decoder_cache_t * const cache = driver_data->decoder_cache;
+
+    return cache && cache->preallocate;
+}
+
+// Get a decoder supporting at least MAX_REFS reference frames
+VdpStatus
+decoder_cache_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t             width,
+    uint32_t             height,
+    int                  max_refs,
+    VdpDecoder          *decoder,
+    int                 *pmax_refs
+)
+{
+    vdpau_decoder_cache_t * const cache = driver_data->decoder_cache;
+    decoder_cache_entry_t *entry;
+    VdpDecoder vdp_decoder = VDP_INVALID_HANDLE;
+    VdpStatus vdp_status;
+
+    if (cache) {
+        pthread_mutex_lock(&cache->lock);
+        entry = decoder_cache_lookup(cache, profile, width, height);
+        if (entry && entry->max_refs >= max_refs) {
+            vdp_decoder = entry->decoder;
+            max_refs    = entry->max_refs;
+            *entry      = cache->entries[--cache->num_entries];
+            cache->num_hits++;
+        }
+        else {
+            /* A smaller idle decoder would only be recreated later */
+            if (entry)
+                decoder_cache_evict(driver_data, cache, entry);
+            cache->num_misses++;
+        }
+        decoder_cache_trim(driver_data, cache);
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    if (vdp_decoder == VDP_INVALID_HANDLE) {
+        vdp_status = vdpau_decoder_create(
+            driver_data,
+            driver_data->vdp_device,
+            profile,
+            width, height,
+            max_refs,
+            &vdp_decoder
+        );
+        if (!VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderCreate()"))
+            return vdp_status;
+    }
+
+    *decoder = vdp_decoder;
+    if (pmax_refs)
+        *pmax_refs = max_refs;
+    return VDP_STATUS_OK;
+}
+
+// Return DECODER, created for MAX_REFS reference frames, to the cache
+void
+decoder_cache_release(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t             width,
+    uint32_t             height,
+    int                  max_refs,
+    VdpDecoder           decoder
+)
+{
+    vdpau_decoder_cache_t * const cache = driver_data->decoder_cache;
+    decoder_cache_entry_t *entry;
+
+    if (decoder == VDP_INVALID_HANDLE)
+        return;
+
+    if (!cache || cache->max_entries == 0) {
+        vdpau_decoder_destroy(driver_data, decoder);
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry = decoder_cache_lookup(cache, profile, width, height);
+    if (entry) {
+        /* Keep the decoder with the most reference frames */
+        if (entry->max_refs >= max_refs) {
+            vdpau_decoder_destroy(driver_data, decoder);
+            decoder  = entry->decoder;
+            max_refs = entry->max_refs;
+        }
+        else
+            vdpau_decoder_destroy(driver_data, entry->decoder);
+    }
+    else {
+        entry = realloc_buffer((void **)&cache->entries, &cache->num_entries_max,
+                               cache->num_entries + 1, sizeof(*entry));
+        if (entry)
+            entry = &cache->entries[cache->num_entries++];
+    }
+    if (!entry)
+        vdpau_decoder_destroy(driver_data, decoder);
+    else {
+        entry->profile      = profile;
+        entry->width        = width;
+        entry->height       = height;
+        entry->max_refs     = max_refs;
+        entry->decoder      = decoder;
+        entry->release_time = get_ticks_usec();
+    }
+    decoder_cache_trim(driver_data, cache);
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,71 @@
+/*
+ *  vdpau_decoder_cache.h - VDPAU backend for VA-API (decoder cache)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_DECODER_CACHE_H
+#define VDPAU_DECODER_CACHE_H
+
+#include "vdpau_driver.h"
+
+/* VdpDecoders released by vaDestroyContext() are kept per (profile, width,
+ * height) so that the next context of the same stream geometry, e.g. after
+ * an adaptive streaming rendition switch, adopts one instead of going through
+ * VdpDecoderCreate() again. Only the decoder with the largest number of
+ * reference frames is kept for a given key. */
+typedef struct vdpau_decoder_cache vdpau_decoder_cache_t;
+
+// Create cache of idle VDPAU decoders
+int
+vdpau_decoder_cache_init(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Destroy cache of idle VDPAU decoders
+void
+vdpau_decoder_cache_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Checks whether decoders are created for the level maximum of references
+int
+decoder_cache_preallocate(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Get a decoder supporting at least MAX_REFS reference frames
+VdpStatus
+decoder_cache_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t             width,
+    uint32_t             height,
+    int                  max_refs,
+    VdpDecoder          *decoder,
+    int                 *pmax_refs
+) attribute_hidden;
+
+// Return DECODER, created for MAX_REFS reference frames, to the cache
+void
+decoder_cache_release(
+    vdpau_driver_data_t *driver_data,
+    VdpDecoderProfile    profile,
+    uint32_t             width,
+    uint32_t             height,
+    int                  max_refs,
+    VdpDecoder           decoder
+) attribute_hidden;
+
+#endif /* VDPAU_DECODER_CACHE_H */
@@ -22,10 +22,18 @@
 #include <ctype.h>
 #include "vdpau_driver.h"
 #include "vdpau_buffer.h"
+#include "vdpau_caps.h"
+#include "vdpau_capture.h"
 #include "vdpau_decode.h"
+#include "vdpau_decoder_cache.h"
 #include "vdpau_image.h"
 #include "vdpau_subpic.h"
+#include "vdpau_surface_pool.h"
+#include "vdpau_timeline.h"
+#include "vdpau_trace.h"
 #include "vdpau_mixer.h"
+#include "vdpau_output_pool.h"
+#include "vdpau_soft.h"
 #include "vdpau_video.h"
 #include "vdpau_video_x11.h"
 #if USE_GLX
@@ -156,13 +164,20 @@ destroy_heap(
 static void
 vdpau_common_Terminate(vdpau_driver_data_t *driver_data)
 {
+    vdpau_capture_exit(driver_data);
+    vdpau_caps_exit(driver_data);
     DESTROY_HEAP(buffer,      destroy_buffer_cb);
+    vdpau_buffer_pool_exit(driver_data);
     DESTROY_HEAP(image,       NULL);
     DESTROY_HEAP(subpicture,  NULL);
     DESTROY_HEAP(output,      NULL);
     DESTROY_HEAP(surface,     NULL);
+    vdpau_surface_pool_exit(driver_data);
+    vdpau_output_pool_exit(driver_data);
     DESTROY_HEAP(context,     NULL);
+    vdpau_decoder_cache_exit(driver_data);
     DESTROY_HEAP(config,      NULL);
+    video_mixer_cache_exit(driver_data);
     DESTROY_HEAP(mixer,       destroy_mixer_cb);
 #if USE_GLX
     DESTROY_HEAP(glx_surface, NULL);
@@ -173,6 +188,9 @@ vdpau_common_Terminate(vdpau_driver_data_t *driver_data)
         driver_data->vdp_device = VDP_INVALID_HANDLE;
     }
     vdpau_gate_exit(driver_data);
+    vdpau_stats_exit();
+    vdpau_trace_exit();
+    vdpau_timeline_exit();
 
     if (!driver_data->x_fallback && driver_data->vdp_dpy) {
         XCloseDisplay(driver_data->vdp_dpy);
@@ -184,6 +202,31 @@ vdpau_common_Terminate(vdpau_driver_data_t *driver_data)
 static VAStatus
 vdpau_common_Initialize(vdpau_driver_data_t *driver_data)
 {
+    VdpStatus vdp_status;
+    driver_data->vdp_device = VDP_INVALID_HANDLE;
+
+    /* First, so that vdpau_common_Terminate() always has a reference */
+    if (vdpau_stats_init() < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    if (vdpau_trace_init() < 0)
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+    if (vdpau_timeline_init() < 0)
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    if (vdpau_soft_enabled()) {
+        /* The software device needs no X server, reuse whatever
+           display we were given and never close it */
+        driver_data->x_fallback = true;
+        driver_data->vdp_dpy = driver_data->x11_dpy;
+        vdp_status = vdpau_soft_device_create(
+            &driver_data->vdp_device,
+            &driver_data->vdp_get_proc_address
+        );
+        if (vdp_status != VDP_STATUS_OK)
+            return VA_STATUS_ERROR_UNKNOWN;
+        goto init_gate;
+    }
+
     if (!driver_data->x11_dpy) {
         /* vaGetDisplayDRM() doesn't fill ->x11_dpy */
         return VA_STATUS_ERROR_UNKNOWN;
@@ -200,8 +243,6 @@ vdpau_common_Initialize(vdpau_driver_data_t *driver_data)
         printf("Failed to create dedicated X11 display!\n");
     }
         
-    VdpStatus vdp_status;
-    driver_data->vdp_device = VDP_INVALID_HANDLE;
     vdp_status = vdp_device_create_x11(
         driver_data->vdp_dpy,
         driver_data->x11_screen,
@@ -211,6 +252,7 @@ vdpau_common_Initialize(vdpau_driver_data_t *driver_data)
     if (vdp_status != VDP_STATUS_OK)
         return VA_STATUS_ERROR_UNKNOWN;
 
+init_gate:
     if (vdpau_gate_init(driver_data) < 0)
         return VA_STATUS_ERROR_UNKNOWN;
 
@@ -259,6 +301,27 @@ vdpau_common_Initialize(vdpau_driver_data_t *driver_data)
         sprintf(&driver_data->va_vendor[len], ".pre%d", VDPAU_VIDEO_PRE_VERSION);
     }
 
+    if (vdpau_buffer_pool_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (vdpau_capture_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (vdpau_caps_init(driver_data, impl_string) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (video_mixer_cache_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (vdpau_surface_pool_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (vdpau_output_pool_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    if (vdpau_decoder_cache_init(driver_data) < 0)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
     CREATE_HEAP(config,         CONFIG);
     CREATE_HEAP(context,        CONTEXT);
     CREATE_HEAP(surface,        SURFACE);
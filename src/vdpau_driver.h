@@ -26,11 +26,14 @@
 #include "vaapi_compat.h"
 #include "vdpau_gate.h"
 #include "object_heap.h"
+#include "ubufferpool.h"
+#include "vdpau_stats.h"
 
 
 #define VDPAU_DRIVER_DATA_INIT                           \
         struct vdpau_driver_data *driver_data =          \
-            (struct vdpau_driver_data *)ctx->pDriverData
+            (struct vdpau_driver_data *)ctx->pDriverData;\
+        STATS_SCOPE(stats_timer, __func__)
 
 #define VDPAU_OBJECT(id, type) \
     ((object_##type##_p)object_heap_lookup(&driver_data->type##_heap, (id)))
@@ -89,6 +92,13 @@ struct vdpau_driver_data {
     struct object_heap          image_heap;
     struct object_heap          subpicture_heap;
     struct object_heap          mixer_heap;
+    UBufferPool                *buffer_pool;
+    struct vdpau_capture       *capture;
+    struct vdpau_caps          *caps;
+    struct vdpau_mixer_cache   *mixer_cache;
+    struct vdpau_handle_pool   *surface_pool;
+    struct vdpau_handle_pool   *output_pool;
+    struct vdpau_decoder_cache *decoder_cache;
     Display                    *x11_dpy;
     int                         x11_screen;
     Display                    *vdp_dpy;
@@ -97,9 +97,10 @@ const char *string_of_VdpCodec(VdpCodec codec)
 #define DUMPu(S, M)         TRACE("." #M " = %u,\n", S->M)
 #define DUMPx(S, M)         TRACE("." #M " = 0x%08x,\n", S->M)
 #define DUMPp(S, M)         TRACE("." #M " = %p,\n", S->M)
-#define DUMPm(S, M, I, J)   dump_matrix_NxM(#M, (uint8_t *)S->M, I, J, I * J)
-#define DUMPm16(S, M, I, J) dump_matrix_NxM_short(#M, (uint16_t *)S->M, I, J, I * J)
-#define DUMPm32(S, M, I, J) dump_matrix_NxM_int(#M, (uint32_t *)S->M, I, J, I * J)
+#define DUMPm(S, M, I, J)   dump_matrix_NxM(#M, S->M, 1, I, J, I * J)
+#define DUMPm16(S, M, I, J) dump_matrix_NxM(#M, S->M, 2, I, J, I * J)
+#define DUMPm32(S, M, I, J) dump_matrix_NxM(#M, S->M, 4, I, J, I * J)
+#define DUMPb(B, I, J)      dump_matrix_NxM("buffer", (B)->bitstream, 1, I, J, (B)->bitstream_bytes)
 #else
 #define trace_enabled()     (0)
 #define do_nothing()        do { } while (0)
@@ -112,85 +113,59 @@ const char *string_of_VdpCodec(VdpCodec codec)
 #define DUMPm(S, M, I, J)   do_nothing()
 #define DUMPm16(S, M, I, J) do_nothing()
 #define DUMPm32(S, M, I, J) do_nothing()
+#define DUMPb(B, I, J)      do_nothing()
 #endif
 
-// Dumps matrix[N][M] = N rows x M columns (uint8_t)
-static void
-dump_matrix_NxM(const char *label, const uint8_t *matrix, int N, int M, int L)
-{
-    int i, j, n = 0;
-
-    TRACE(".%s = {\n", label);
-    INDENT(1);
-    for (j = 0; j < N; j++) {
-        for (i = 0; i < M; i++, n++) {
-            if (n >= L)
-                break;
-            if (i > 0)
-                TRACE(", ");
-            TRACE("0x%02x", matrix[n]);
-        }
-        if (j < (N - 1))
-            TRACE(",");
-        TRACE("\n");
-        if (n >= L)
-            break;
-    }
-    INDENT(-1);
-    TRACE("}\n");
-}
-
-// Dumps matrix[N][M] = N rows x M columns (uint16_t)
-static void
-dump_matrix_NxM_short(const char *label, const uint16_t *matrix, int N, int M, int L)
-{
-    int i, j, n = 0;
+#if USE_TRACER
+/* Matrix rows are traced up to MATRIX_ROW_VALUES values at a time, so
+   that a binary trace gets a few records per row instead of several per
+   value. Formats are indexed by the number of values minus one */
+#define MATRIX_ROW_VALUES       6
+#define HEX1                    "0x%02x"
+#define HEX2                    HEX1 ", " HEX1
+#define HEX3                    HEX2 ", " HEX1
+#define HEX4                    HEX3 ", " HEX1
+#define HEX5                    HEX4 ", " HEX1
+#define HEX6                    HEX5 ", " HEX1
+#define HEX_FORMATS(SUFFIX) \
+    { HEX1 SUFFIX, HEX2 SUFFIX, HEX3 SUFFIX, HEX4 SUFFIX, HEX5 SUFFIX, HEX6 SUFFIX }
 
-    TRACE(".%s = {\n", label);
-    INDENT(1);
-    for (j = 0; j < N; j++) {
-        for (i = 0; i < M; i++, n++) {
-            if (n >= L)
-                break;
-            if (i > 0)
-                TRACE(", ");
-            TRACE("0x%02x", matrix[n]);
-        }
-        if (j < (N - 1))
-            TRACE(",");
-        TRACE("\n");
-        if (n >= L)
-            break;
-    }
-    INDENT(-1);
-    TRACE("}\n");
-}
+static const char * const matrix_formats[3][MATRIX_ROW_VALUES] = {
+    HEX_FORMATS(", "),                  /* more values in this row */
+    HEX_FORMATS(",\n"),                 /* end of row, more rows */
+    HEX_FORMATS("\n"),                  /* end of the last row */
+};
 
-// Dumps matrix[N][M] = N rows x M columns (uint32_t)
+// Dumps matrix[N][M] = N rows x M columns of SIZE-byte unsigned values
 static void
-dump_matrix_NxM_int(const char *label, const uint32_t *matrix, int N, int M, int L)
+dump_matrix_NxM(const char *label, const void *matrix, int size, int N, int M, int L)
 {
-    int i, j, n = 0;
+    unsigned int v[MATRIX_ROW_VALUES];
+    int i, j, k, n = 0, row_end, suffix;
 
     TRACE(".%s = {\n", label);
     INDENT(1);
-    for (j = 0; j < N; j++) {
-        for (i = 0; i < M; i++, n++) {
-            if (n >= L)
-                break;
-            if (i > 0)
-                TRACE(", ");
-            TRACE("0x%02x", matrix[n]);
+    for (j = 0; j < N && n < L; j++) {
+        row_end = MIN(n + M, L);
+        while (n < row_end) {
+            for (k = 0; k < MATRIX_ROW_VALUES && n < row_end; k++, n++) {
+                switch (size) {
+                case 1: v[k] = ((const uint8_t  *)matrix)[n]; break;
+                case 2: v[k] = ((const uint16_t *)matrix)[n]; break;
+                default: v[k] = ((const uint32_t *)matrix)[n]; break;
+                }
+            }
+            suffix = n < row_end ? 0 : j < (N - 1) ? 1 : 2;
+            for (i = k; i < MATRIX_ROW_VALUES; i++)
+                v[i] = 0;
+            TRACE(matrix_formats[suffix][k - 1],
+                  v[0], v[1], v[2], v[3], v[4], v[5]);
         }
-        if (j < (N - 1))
-            TRACE(",");
-        TRACE("\n");
-        if (n >= L)
-            break;
     }
     INDENT(-1);
     TRACE("}\n");
 }
+#endif
 
 // Dumps VdpPictureInfoMPEG1Or2
 void dump_VdpPictureInfoMPEG1Or2(VdpPictureInfoMPEG1Or2 *pic_info)
@@ -504,13 +479,11 @@ void dump_VdpPictureInfoVP9(VdpPictureInfoVP9 *pic_info)
 // Dumps VdpBitstreamBuffer
 void dump_VdpBitstreamBuffer(VdpBitstreamBuffer *bitstream_buffer)
 {
-    const uint8_t *buffer = bitstream_buffer->bitstream;
-    const uint32_t size   = bitstream_buffer->bitstream_bytes;
-
     INDENT(1);
-    TRACE("VdpBitstreamBuffer (%d bytes) = {\n", size);
+    TRACE("VdpBitstreamBuffer (%d bytes) = {\n",
+          bitstream_buffer->bitstream_bytes);
     INDENT(1);
-    dump_matrix_NxM("buffer", buffer, 10, 15, size);
+    DUMPb(bitstream_buffer, 10, 15);
     INDENT(-1);
     TRACE("};\n");
     INDENT(-1);
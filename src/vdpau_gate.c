@@ -157,10 +157,12 @@ int vdpau_check_status(
     return 1;
 }
 
-#define VDPAU_INVOKE_(retval, func, ...)               \
+#define VDPAU_INVOKE_(retval, func, ...) ({         \
+    STATS_SCOPE(stats_timer, "vdp_" #func);            \
     (driver_data && driver_data->vdp_vtable.vdp_##func \
      ? driver_data->vdp_vtable.vdp_##func(__VA_ARGS__) \
-     : (retval))
+     : (retval));                                      \
+})
 
 #define VDPAU_INVOKE(func, ...)                        \
     VDPAU_INVOKE_(VDP_STATUS_INVALID_POINTER,          \
@@ -0,0 +1,285 @@
+/*
+ *  vdpau_handle_pool.c - VDPAU backend for VA-API (VDPAU handle pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include "sysdeps.h"
+#include "vdpau_handle_pool.h"
+#include "utils.h"
+#include <pthread.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+typedef struct {
+    uint32_t            format;
+    uint32_t            width;
+    uint32_t            height;
+    uint32_t           *handles;
+    unsigned int        num_handles;
+    unsigned int        num_handles_max;
+    uint64_t            release_time;
+} handle_pool_bucket_t;
+
+struct vdpau_handle_pool {
+    pthread_mutex_t          lock;
+    const char              *name;
+    handle_pool_create_func  create;
+    handle_pool_destroy_func destroy;
+    handle_pool_bucket_t    *buckets;
+    unsigned int             num_buckets;
+    unsigned int             num_buckets_max;
+    unsigned int             num_handles;
+    unsigned int             max_handles;
+    uint64_t                 timeout;       /* usec */
+    uint64_t                 num_created;
+    uint64_t                 num_recycled;
+    uint64_t                 num_trimmed;
+};
+
+static handle_pool_bucket_t *
+handle_pool_lookup(
+    vdpau_handle_pool_t *pool,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height
+)
+{
+    unsigned int i;
+
+    for (i = 0; i < pool->num_buckets; i++) {
+        handle_pool_bucket_t * const bucket = &pool->buckets[i];
+        if (bucket->format == format &&
+            bucket->width == width && bucket->height == height)
+            return bucket;
+    }
+    return NULL;
+}
+
+// Destroy the N oldest handles of BUCKET
+static void
+handle_pool_trim_bucket(
+    vdpau_driver_data_t  *driver_data,
+    vdpau_handle_pool_t  *pool,
+    handle_pool_bucket_t *bucket,
+    unsigned int          n
+)
+{
+    unsigned int i;
+
+    if (n > bucket->num_handles)
+        n = bucket->num_handles;
+
+    for (i = 0; i < n; i++)
+        pool->destroy(driver_data, bucket->handles[i]);
+    memmove(bucket->handles, bucket->handles + n,
+            (bucket->num_handles - n) * sizeof(bucket->handles[0]));
+    bucket->num_handles -= n;
+    pool->num_handles   -= n;
+    pool->num_trimmed   += n;
+}
+
+// Drop expired buckets, then the least recently used handles over the limit
+static void
+handle_pool_trim(vdpau_driver_data_t *driver_data, vdpau_handle_pool_t *pool)
+{
+    const uint64_t now = get_ticks_usec();
+    handle_pool_bucket_t *bucket, *lru_bucket;
+    unsigned int i;
+
+    for (i = 0; i < pool->num_buckets; i++) {
+        bucket = &pool->buckets[i];
+        if (bucket->release_time + pool->timeout <= now)
+            handle_pool_trim_bucket(driver_data, pool, bucket,
+                                    bucket->num_handles);
+    }
+
+    while (pool->num_handles > pool->max_handles) {
+        lru_bucket = NULL;
+        for (i = 0; i < pool->num_buckets; i++) {
+            bucket = &pool->buckets[i];
+            if (bucket->num_handles > 0 &&
+                (!lru_bucket || bucket->release_time < lru_bucket->release_time))
+                lru_bucket = bucket;
+        }
+        if (!lru_bucket)
+            break;
+        handle_pool_trim_bucket(driver_data, pool, lru_bucket,
+                                pool->num_handles - pool->max_handles);
+    }
+
+    /* Compact empty buckets away */
+    for (i = 0; i < pool->num_buckets; ) {
+        bucket = &pool->buckets[i];
+        if (bucket->num_handles > 0) {
+            i++;
+            continue;
+        }
+        free(bucket->handles);
+        *bucket = pool->buckets[--pool->num_buckets];
+    }
+}
+
+// Create a pool keeping up to MAX_HANDLES idle handles for TIMEOUT ms
+vdpau_handle_pool_t *
+handle_pool_new(
+    const char              *name,
+    unsigned int             max_handles,
+    unsigned int             timeout,
+    handle_pool_create_func  create,
+    handle_pool_destroy_func destroy
+)
+{
+    vdpau_handle_pool_t *pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->name        = name;
+    pool->create      = create;
+    pool->destroy     = destroy;
+    pool->max_handles = max_handles;
+    pool->timeout     = (uint64_t)timeout * 1000;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+// Destroy the pool and all its idle handles
+void
+handle_pool_free(vdpau_driver_data_t *driver_data, vdpau_handle_pool_t *pool)
+{
+    unsigned int i;
+
+    if (!pool)
+        return;
+
+    D(bug("%s pool: %llu created, %llu recycled, %llu trimmed\n",
+          pool->name,
+          (unsigned long long)pool->num_created,
+          (unsigned long long)pool->num_recycled,
+          (unsigned long long)pool->num_trimmed));
+
+    for (i = 0; i < pool->num_buckets; i++) {
+        handle_pool_bucket_t * const bucket = &pool->buckets[i];
+        handle_pool_trim_bucket(driver_data, pool, bucket, bucket->num_handles);
+        free(bucket->handles);
+    }
+    free(pool->buckets);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Get NUM_HANDLES handles, recycled ones first
+VdpStatus
+handle_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    vdpau_handle_pool_t *pool,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height,
+    uint32_t            *handles,
+    unsigned int         num_handles
+)
+{
+    handle_pool_bucket_t *bucket;
+    unsigned int i, n = 0;
+    VdpStatus vdp_status;
+
+    pthread_mutex_lock(&pool->lock);
+    bucket = handle_pool_lookup(pool, format, width, height);
+    if (bucket) {
+        /* Most recently released handles are at the end */
+        n = MIN(num_handles, bucket->num_handles);
+        bucket->num_handles -= n;
+        memcpy(handles, bucket->handles + bucket->num_handles,
+               n * sizeof(handles[0]));
+        pool->num_handles  -= n;
+        pool->num_recycled += n;
+    }
+    pool->num_created += num_handles - n;
+    handle_pool_trim(driver_data, pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = n; i < num_handles; i++) {
+        vdp_status = pool->create(driver_data, format, width, height,
+                                  &handles[i]);
+        if (vdp_status != VDP_STATUS_OK) {
+            handle_pool_release(driver_data, pool, format, width, height,
+                                handles, i);
+            return vdp_status;
+        }
+    }
+    return VDP_STATUS_OK;
+}
+
+// Return NUM_HANDLES handles to the pool, or destroy them
+void
+handle_pool_release(
+    vdpau_driver_data_t *driver_data,
+    vdpau_handle_pool_t *pool,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height,
+    const uint32_t      *handles,
+    unsigned int         num_handles
+)
+{
+    handle_pool_bucket_t *bucket;
+    unsigned int i;
+
+    if (num_handles == 0)
+        return;
+
+    if (pool->max_handles == 0) {
+        for (i = 0; i < num_handles; i++)
+            pool->destroy(driver_data, handles[i]);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    bucket = handle_pool_lookup(pool, format, width, height);
+    if (!bucket) {
+        bucket = realloc_buffer((void **)&pool->buckets, &pool->num_buckets_max,
+                                pool->num_buckets + 1, sizeof(*bucket));
+        if (bucket) {
+            bucket = &pool->buckets[pool->num_buckets++];
+            memset(bucket, 0, sizeof(*bucket));
+            bucket->format = format;
+            bucket->width  = width;
+            bucket->height = height;
+        }
+    }
+    if (!bucket ||
+        !realloc_buffer((void **)&bucket->handles, &bucket->num_handles_max,
+                        bucket->num_handles + num_handles,
+                        sizeof(bucket->handles[0]))) {
+        for (i = 0; i < num_handles; i++)
+            pool->destroy(driver_data, handles[i]);
+    }
+    else {
+        memcpy(bucket->handles + bucket->num_handles, handles,
+               num_handles * sizeof(handles[0]));
+        bucket->num_handles += num_handles;
+        bucket->release_time = get_ticks_usec();
+        pool->num_handles   += num_handles;
+    }
+    handle_pool_trim(driver_data, pool);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,89 @@
+/*
+ *  vdpau_handle_pool.h - VDPAU backend for VA-API (VDPAU handle pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef VDPAU_HANDLE_POOL_H
+#define VDPAU_HANDLE_POOL_H
+
+#include "vdpau_driver.h"
+
+/* VDPAU handles released by their user are kept per (format, width,
+ * height) so that the next request of the same kind does not go through
+ * the VDPAU create function again. Idle handles are destroyed after a
+ * timeout, and the least recently released ones over a size limit. The
+ * pool is told how to create and destroy its handles, e.g. video
+ * surfaces of a chroma type or output surfaces of an RGBA format. */
+typedef struct vdpau_handle_pool vdpau_handle_pool_t;
+
+// Create a VDPAU handle of the given format and size
+typedef VdpStatus (*handle_pool_create_func)(
+    vdpau_driver_data_t *driver_data,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height,
+    uint32_t            *handle
+);
+
+// Destroy a VDPAU handle
+typedef void (*handle_pool_destroy_func)(
+    vdpau_driver_data_t *driver_data,
+    uint32_t             handle
+);
+
+// Create a pool keeping up to MAX_HANDLES idle handles for TIMEOUT ms
+vdpau_handle_pool_t *
+handle_pool_new(
+    const char              *name,
+    unsigned int             max_handles,
+    unsigned int             timeout,
+    handle_pool_create_func  create,
+    handle_pool_destroy_func destroy
+) attribute_hidden;
+
+// Destroy the pool and all its idle handles
+void
+handle_pool_free(vdpau_driver_data_t *driver_data, vdpau_handle_pool_t *pool)
+    attribute_hidden;
+
+// Get NUM_HANDLES handles, recycled ones first
+VdpStatus
+handle_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    vdpau_handle_pool_t *pool,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height,
+    uint32_t            *handles,
+    unsigned int         num_handles
+) attribute_hidden;
+
+// Return NUM_HANDLES handles to the pool, or destroy them
+void
+handle_pool_release(
+    vdpau_driver_data_t *driver_data,
+    vdpau_handle_pool_t *pool,
+    uint32_t             format,
+    uint32_t             width,
+    uint32_t             height,
+    const uint32_t      *handles,
+    unsigned int         num_handles
+) attribute_hidden;
+
+#endif /* VDPAU_HANDLE_POOL_H */
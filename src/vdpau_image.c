@@ -22,11 +22,21 @@
 #include "vdpau_image.h"
 #include "vdpau_video.h"
 #include "vdpau_buffer.h"
+#include "vdpau_caps.h"
 #include "vdpau_mixer.h"
+#include "vdpau_output_pool.h"
+#include "utils.h"
+#include "yuv2rgb.h"
 
 #define DEBUG 1
 #include "debug.h"
 
+/* Default alignment of image plane pitches (in bytes), image buffers
+   themselves are page-aligned */
+#define IMAGE_PITCH_ALIGN       64
+#define IMAGE_BUFFER_ALIGN      4096
+
+#define ALIGN_UP(x, a)          (((x) + (a) - 1) & ~((a) - 1))
 
 // List of supported image formats
 typedef struct {
@@ -105,30 +115,70 @@ is_supported_format(
     uint32_t             format
 )
 {
-    VdpBool is_supported = VDP_FALSE;
-    VdpStatus vdp_status;
-
     switch (type) {
     case VDP_IMAGE_FORMAT_TYPE_YCBCR:
-        vdp_status =
-            vdpau_video_surface_query_ycbcr_caps(driver_data,
-                                                 driver_data->vdp_device,
-                                                 VDP_CHROMA_TYPE_420,
-                                                 format,
-                                                 &is_supported);
-        break;
+        return vdpau_caps_has_ycbcr_format(driver_data,
+                                           VDP_CHROMA_TYPE_420, format);
     case VDP_IMAGE_FORMAT_TYPE_RGBA:
-        vdp_status =
-            vdpau_output_surface_query_rgba_caps(driver_data,
-                                                 driver_data->vdp_device,
-                                                 format,
-                                                 &is_supported);
-        break;
+        return vdpau_caps_has_rgba_format(driver_data, format);
     default:
-        vdp_status = VDP_STATUS_INVALID_VALUE;
         break;
     }
-    return vdp_status == VDP_STATUS_OK && is_supported;
+    return VDP_FALSE;
+}
+
+// Check whether RGBA images are converted from NV12 on the CPU
+static int use_cpu_rgba_conversion(void)
+{
+    static int g_use_cpu_rgba_conversion = -1;
+
+    if (g_use_cpu_rgba_conversion < 0) {
+        if (getenv_yesno("VDPAU_VIDEO_CPU_RGBA", &g_use_cpu_rgba_conversion) < 0)
+            g_use_cpu_rgba_conversion = 0;
+    }
+    return g_use_cpu_rgba_conversion;
+}
+
+// Get the alignment of image plane pitches, a power of two
+unsigned int
+get_image_pitch_alignment(void)
+{
+    static int g_pitch_align = -1;
+
+    if (g_pitch_align < 0) {
+        int value;
+        if (getenv_int("VDPAU_VIDEO_IMAGE_PITCH_ALIGN", &value) < 0 ||
+            value < 1 || value > IMAGE_BUFFER_ALIGN || (value & (value - 1)))
+            value = IMAGE_PITCH_ALIGN;
+        g_pitch_align = value;
+    }
+    return g_pitch_align;
+}
+
+// Compute aligned plane pitches and offsets of a planar 4:2:0 image with
+// NUM_PLANES planes (2 for NV12), returns the image size
+static unsigned int
+get_ycbcr_420_layout(
+    unsigned int        num_planes,
+    unsigned int        width,
+    unsigned int        height,
+    unsigned int       *pitches,
+    unsigned int       *offsets
+)
+{
+    const unsigned int align   = get_image_pitch_alignment();
+    const unsigned int width2  = (width  + 1) / 2;
+    const unsigned int height2 = (height + 1) / 2;
+    unsigned int i;
+
+    /* Pitches are aligned, so are plane offsets */
+    pitches[0] = ALIGN_UP(width, align);
+    offsets[0] = 0;
+    for (i = 1; i < num_planes; i++) {
+        pitches[i] = ALIGN_UP(num_planes == 2 ? 2 * width2 : width2, align);
+        offsets[i] = offsets[i - 1] + pitches[i - 1] * (i == 1 ? height : height2);
+    }
+    return offsets[num_planes - 1] + pitches[num_planes - 1] * height2;
 }
 
 // vaQueryImageFormats
@@ -175,7 +225,8 @@ vdpau_CreateImage(
     VDPAU_DRIVER_DATA_INIT;
 
     VAStatus va_status = VA_STATUS_ERROR_OPERATION_FAILED;
-    unsigned int i, width2, height2, size2, size;
+    const unsigned int align = get_image_pitch_alignment();
+    unsigned int i;
 
     if (!format || !out_image)
         return VA_STATUS_ERROR_INVALID_PARAMETER;
@@ -205,30 +256,19 @@ vdpau_CreateImage(
     image->image_id       = image_id;
     image->buf            = VA_INVALID_ID;
 
-    size    = width * height;
-    width2  = (width  + 1) / 2;
-    height2 = (height + 1) / 2;
-    size2   = width2 * height2;
-
     switch (format->fourcc) {
     case VA_FOURCC('N','V','1','2'):
         image->num_planes = 2;
-        image->pitches[0] = width;
-        image->offsets[0] = 0;
-        image->pitches[1] = width;
-        image->offsets[1] = size;
-        image->data_size  = size + 2 * size2;
+        image->data_size  = get_ycbcr_420_layout(2, width, height,
+                                                 image->pitches,
+                                                 image->offsets);
         break;
     case VA_FOURCC('Y','V','1','2'):
     case VA_FOURCC('I','4','2','0'):
         image->num_planes = 3;
-        image->pitches[0] = width;
-        image->offsets[0] = 0;
-        image->pitches[1] = width2;
-        image->offsets[1] = size;
-        image->pitches[2] = width2;
-        image->offsets[2] = size + size2;
-        image->data_size  = size + 2 * size2;
+        image->data_size  = get_ycbcr_420_layout(3, width, height,
+                                                 image->pitches,
+                                                 image->offsets);
         break;
     case VA_FOURCC('A','R','G','B'):
     case VA_FOURCC('A','B','G','R'):
@@ -237,21 +277,21 @@ vdpau_CreateImage(
     case VA_FOURCC('U','Y','V','Y'):
     case VA_FOURCC('Y','U','Y','V'):
         image->num_planes = 1;
-        image->pitches[0] = width * 4;
+        image->pitches[0] = ALIGN_UP(width * 4, align);
         image->offsets[0] = 0;
         image->data_size  = image->offsets[0] + image->pitches[0] * height;
         break;
     case VA_FOURCC('I','A','4','4'):
     case VA_FOURCC('A','I','4','4'):
         image->num_planes = 1;
-        image->pitches[0] = width;
+        image->pitches[0] = ALIGN_UP(width, align);
         image->offsets[0] = 0;
         image->data_size  = image->offsets[0] + image->pitches[0] * height;
         break;
     case VA_FOURCC('I','A','8','8'):
     case VA_FOURCC('A','I','8','8'):
         image->num_planes = 1;
-        image->pitches[0] = width * 2;
+        image->pitches[0] = ALIGN_UP(width * 2, align);
         image->offsets[0] = 0;
         image->data_size  = image->offsets[0] + image->pitches[0] * height;
         break;
@@ -259,31 +299,22 @@ vdpau_CreateImage(
         goto error;
     }
 
-    /* Allocate more bytes to align image data base on 16-byte boundaries */
-    /* XXX: align other planes too? */
-    static const int ALIGN = 16;
-
+    /* The buffer pool returns page-aligned blocks from one page up */
     va_status = vdpau_CreateBuffer(ctx, 0, VAImageBufferType,
-                                   image->data_size + ALIGN, 1, NULL,
-                                   &image->buf);
+                                   ALIGN_UP(image->data_size, IMAGE_BUFFER_ALIGN),
+                                   1, NULL, &image->buf);
     if (va_status != VA_STATUS_SUCCESS)
         goto error;
 
     object_buffer_p obj_buffer = VDPAU_BUFFER(image->buf);
     if (!obj_buffer)
         goto error;
+    ASSERT(((uintptr_t)obj_buffer->buffer_data) % IMAGE_BUFFER_ALIGN == 0);
 
-    int align = ((uintptr_t)obj_buffer->buffer_data) % ALIGN;
-    if (align) {
-        align = ALIGN - align;
-        for (i = 0; i < image->num_planes; i++)
-            image->offsets[i] += align;
-    }
-
-    obj_image->vdp_rgba_output_surface = VDP_INVALID_HANDLE;
     obj_image->vdp_format_type  = m->vdp_format_type;
     obj_image->vdp_format       = m->vdp_format;
     obj_image->vdp_palette      = NULL;
+    obj_image->derived_surface  = VA_INVALID_SURFACE;
 
     image->image_id             = image_id;
     image->format               = *format;
@@ -317,9 +348,16 @@ vdpau_DestroyImage(
     if (!obj_image)
         return VA_STATUS_ERROR_INVALID_IMAGE;
 
-    if (obj_image->vdp_rgba_output_surface != VDP_INVALID_HANDLE)
-        vdpau_output_surface_destroy(driver_data,
-                                     obj_image->vdp_rgba_output_surface);
+    /* Derived images live as long as their surface, but writes made
+       through a buffer mapping that is still open must land there */
+    if (obj_image->derived_surface != VA_INVALID_SURFACE) {
+        object_buffer_p obj_buffer = VDPAU_BUFFER(obj_image->image.buf);
+        if (obj_buffer && obj_buffer->map_count > 0) {
+            obj_buffer->map_count = 0;
+            return commit_derived_image(driver_data, obj_buffer);
+        }
+        return VA_STATUS_SUCCESS;
+    }
 
     if (obj_image->vdp_palette) {
         free(obj_image->vdp_palette);
@@ -331,18 +369,6 @@ vdpau_DestroyImage(
     return vdpau_DestroyBuffer(ctx, buf);
 }
 
-// vaDeriveImage
-VAStatus
-vdpau_DeriveImage(
-    VADriverContextP    ctx,
-    VASurfaceID         surface,
-    VAImage             *image
-)
-{
-    /* TODO */
-    return VA_STATUS_ERROR_OPERATION_FAILED;
-}
-
 // Set image palette
 static VAStatus
 set_image_palette(
@@ -387,6 +413,191 @@ vdpau_SetImagePalette(
     return set_image_palette(driver_data, obj_image, palette);
 }
 
+// Checks whether RECT lies within a WIDTH x HEIGHT area
+static inline int
+is_rect_inside(const VARectangle *rect, unsigned int width, unsigned int height)
+{
+    return (rect->x >= 0 && rect->y >= 0 &&
+            rect->x + rect->width  <= width &&
+            rect->y + rect->height <= height);
+}
+
+// Checks whether the image is in a planar 4:2:0 format
+static inline int
+is_ycbcr_420_image(object_image_p obj_image)
+{
+    return (obj_image->vdp_format_type == VDP_IMAGE_FORMAT_TYPE_YCBCR &&
+            (obj_image->vdp_format == VDP_YCBCR_FORMAT_NV12 ||
+             obj_image->vdp_format == VDP_YCBCR_FORMAT_YV12));
+}
+
+// Copy a block of WIDTH x HEIGHT bytes
+static void
+copy_plane(
+    uint8_t       *dst,
+    unsigned int   dst_stride,
+    const uint8_t *src,
+    unsigned int   src_stride,
+    unsigned int   width,
+    unsigned int   height
+)
+{
+    unsigned int y;
+
+    if (width == dst_stride && width == src_stride) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+    for (y = 0; y < height; y++) {
+        memcpy(dst, src, width);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+// Copy a block of WIDTH x HEIGHT pixels between 4:2:0 planes of FORMAT.
+// If FULL_ROWS is set, the block spans whole rows of both buffers
+static void
+copy_ycbcr_420(
+    uint32_t             vdp_format,
+    uint8_t            **dst,
+    const unsigned int  *dst_stride,
+    unsigned int         dst_x,
+    unsigned int         dst_y,
+    uint8_t            **src,
+    const unsigned int  *src_stride,
+    unsigned int         src_x,
+    unsigned int         src_y,
+    unsigned int         width,
+    unsigned int         height,
+    int                  full_rows
+)
+{
+    /* NV12 interleaves U and V samples in a single chroma plane */
+    const unsigned int num_planes = vdp_format == VDP_YCBCR_FORMAT_NV12 ? 2 : 3;
+    const unsigned int cpp        = vdp_format == VDP_YCBCR_FORMAT_NV12 ? 2 : 1;
+    unsigned int i, plane_width;
+
+    for (i = 0; i < num_planes; i++) {
+        plane_width = i == 0 ? width : ((width + 1) / 2) * cpp;
+
+        /* Rows padded to the same pitch are copied with their padding
+           in one go */
+        if (full_rows && dst_stride[i] == src_stride[i])
+            plane_width = dst_stride[i];
+
+        if (i == 0)
+            copy_plane(dst[0] + dst_y * dst_stride[0] + dst_x, dst_stride[0],
+                       src[0] + src_y * src_stride[0] + src_x, src_stride[0],
+                       plane_width, height);
+        else
+            copy_plane(dst[i] + (dst_y / 2) * dst_stride[i] + (dst_x / 2) * cpp,
+                       dst_stride[i],
+                       src[i] + (src_y / 2) * src_stride[i] + (src_x / 2) * cpp,
+                       src_stride[i],
+                       plane_width, (height + 1) / 2);
+    }
+}
+
+// Get the staging copy of the whole surface in FORMAT, reading it back if needed
+static VAStatus
+get_staging_buffer(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface,
+    uint32_t             vdp_format,
+    uint8_t            **planes,
+    unsigned int        *pitches
+)
+{
+    const unsigned int num_planes = vdp_format == VDP_YCBCR_FORMAT_NV12 ? 2 : 3;
+    unsigned int i, size, offsets[3];
+    VdpStatus vdp_status;
+    void *data;
+
+    /* Same layout as images of the surface size */
+    size = get_ycbcr_420_layout(num_planes,
+                                obj_surface->width, obj_surface->height,
+                                pitches, offsets);
+
+    if (obj_surface->staging_size < size) {
+        if (posix_memalign(&data, IMAGE_BUFFER_ALIGN, size) != 0)
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        free(obj_surface->staging_data);
+        obj_surface->staging_data  = data;
+        obj_surface->staging_size  = size;
+        obj_surface->staging_valid = 0;
+    }
+
+    for (i = 0; i < num_planes; i++)
+        planes[i] = obj_surface->staging_data + offsets[i];
+
+    if (obj_surface->staging_valid && obj_surface->staging_format == vdp_format)
+        return VA_STATUS_SUCCESS;
+
+    vdp_status = vdpau_video_surface_get_bits_ycbcr(
+        driver_data,
+        obj_surface->vdp_surface,
+        vdp_format,
+        planes, pitches
+    );
+    if (vdp_status != VDP_STATUS_OK)
+        return vdpau_get_VAStatus(vdp_status);
+
+    obj_surface->staging_format = vdp_format;
+    obj_surface->staging_valid  = 1;
+    return VA_STATUS_SUCCESS;
+}
+
+// Convert the surface to an RGBA image on the CPU. Returns 0 if the
+// conversion is not possible, so that the video mixer is used instead.
+// Only the default BT.601 CSC matrix is implemented, procamp attributes
+// set through vaSetDisplayAttributes() also need the video mixer
+static int
+get_image_rgba_cpu(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface,
+    object_image_p       obj_image,
+    const VARectangle   *rect,
+    uint8_t             *dst,
+    unsigned int         dst_stride,
+    VAStatus            *pva_status
+)
+{
+    uint8_t *staging[3];
+    unsigned int staging_stride[3];
+
+#ifdef WORDS_BIGENDIAN
+    /* Pixels are written in little-endian byte order */
+    return 0;
+#endif
+
+    if (obj_surface->vdp_chroma_type != VDP_CHROMA_TYPE_420 ||
+        !vdpau_caps_has_ycbcr_format(driver_data, VDP_CHROMA_TYPE_420,
+                                     VDP_YCBCR_FORMAT_NV12))
+        return 0;
+
+    if (!video_mixer_has_default_csc(driver_data, 0))
+        return 0;
+
+    if (!is_rect_inside(rect, obj_surface->width, obj_surface->height) ||
+        rect->width  > obj_image->image.width ||
+        rect->height > obj_image->image.height)
+        return 0;
+
+    /* The NV12 readback is shared with sub-rectangle vaGetImage() and
+       skipped if the surface did not change */
+    *pva_status = get_staging_buffer(driver_data, obj_surface,
+                                     VDP_YCBCR_FORMAT_NV12,
+                                     staging, staging_stride);
+    if (*pva_status == VA_STATUS_SUCCESS)
+        nv12_to_rgb32(dst, dst_stride,
+                      staging[0], staging_stride[0],
+                      staging[1], staging_stride[1],
+                      rect->x, rect->y, rect->width, rect->height,
+                      obj_image->vdp_format == VDP_RGBA_FORMAT_R8G8B8A8);
+    return 1;
+}
+
 // Get image from surface
 static VAStatus
 get_image(
@@ -397,15 +608,20 @@ get_image(
 )
 {
     VAImage * const image = &obj_image->image;
+    VAStatus va_status;
     VdpStatus vdp_status;
-    uint8_t *src[3];
-    unsigned int src_stride[3];
+    uint8_t *src[3], *staging[3];
+    unsigned int src_stride[3], staging_stride[3];
     int i;
 
     object_buffer_p obj_buffer = VDPAU_BUFFER(image->buf);
     if (!obj_buffer)
         return VA_STATUS_ERROR_INVALID_BUFFER;
 
+    va_status = sync_surface_decode(driver_data, obj_surface);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
     switch (image->format.fourcc) {
     case VA_FOURCC('I','4','2','0'):
         src[0] = (uint8_t *)obj_buffer->buffer_data + image->offsets[0];
@@ -425,12 +641,31 @@ get_image(
 
     switch (obj_image->vdp_format_type) {
     case VDP_IMAGE_FORMAT_TYPE_YCBCR: {
-        /* VDPAU only supports full video surface readback */
+        /* VDPAU only supports full video surface readback, crop from a
+           copy of the whole surface otherwise */
         if (rect->x != 0 ||
             rect->y != 0 ||
             obj_surface->width  != rect->width ||
-            obj_surface->height != rect->height)
-            return VA_STATUS_ERROR_OPERATION_FAILED;
+            obj_surface->height != rect->height) {
+            if (!is_ycbcr_420_image(obj_image) ||
+                !is_rect_inside(rect, obj_surface->width, obj_surface->height) ||
+                rect->width > image->width || rect->height > image->height)
+                return VA_STATUS_ERROR_OPERATION_FAILED;
+
+            va_status = get_staging_buffer(driver_data, obj_surface,
+                                           obj_image->vdp_format,
+                                           staging, staging_stride);
+            if (va_status != VA_STATUS_SUCCESS)
+                return va_status;
+
+            copy_ycbcr_420(obj_image->vdp_format,
+                           src, src_stride, 0, 0,
+                           staging, staging_stride, rect->x, rect->y,
+                           rect->width, rect->height,
+                           rect->width == obj_surface->width &&
+                           image->width == obj_surface->width);
+            return VA_STATUS_SUCCESS;
+        }
 
         vdp_status = vdpau_video_surface_get_bits_ycbcr(
             driver_data,
@@ -441,18 +676,21 @@ get_image(
         break;
     }
     case VDP_IMAGE_FORMAT_TYPE_RGBA: {
-        if (obj_image->vdp_rgba_output_surface == VA_INVALID_ID) {
-            vdp_status = vdpau_output_surface_create(
-                driver_data,
-                driver_data->vdp_device,
-                obj_image->vdp_format,
-                obj_image->image.width,
-                obj_image->image.height,
-                &obj_image->vdp_rgba_output_surface
-            );
-            if (vdp_status != VDP_STATUS_OK)
-                return vdpau_get_VAStatus(vdp_status);
-        }
+        if (use_cpu_rgba_conversion() &&
+            get_image_rgba_cpu(driver_data, obj_surface, obj_image, rect,
+                               src[0], src_stride[0], &va_status))
+            return va_status;
+
+        VdpOutputSurface vdp_output_surface;
+        vdp_status = output_pool_acquire(
+            driver_data,
+            obj_image->vdp_format,
+            obj_image->image.width,
+            obj_image->image.height,
+            &vdp_output_surface
+        );
+        if (vdp_status != VDP_STATUS_OK)
+            return vdpau_get_VAStatus(vdp_status);
 
         VdpRect vdp_rect;
         vdp_rect.x0 = rect->x;
@@ -464,19 +702,24 @@ get_image(
             obj_surface->video_mixer,
             obj_surface,
             VDP_INVALID_HANDLE,
-            obj_image->vdp_rgba_output_surface,
+            vdp_output_surface,
             &vdp_rect,
             &vdp_rect,
             0
         );
-        if (vdp_status != VDP_STATUS_OK)
-            return vdpau_get_VAStatus(vdp_status);
-
-        vdp_status = vdpau_output_surface_get_bits_native(
+        if (vdp_status == VDP_STATUS_OK)
+            vdp_status = vdpau_output_surface_get_bits_native(
+                driver_data,
+                vdp_output_surface,
+                &vdp_rect,
+                src, src_stride
+            );
+        output_pool_release(
             driver_data,
-            obj_image->vdp_rgba_output_surface,
-            &vdp_rect,
-            src, src_stride
+            obj_image->vdp_format,
+            obj_image->image.width,
+            obj_image->image.height,
+            vdp_output_surface
         );
         break;
     }
@@ -516,6 +759,142 @@ vdpau_GetImage(
     return get_image(driver_data, obj_surface, obj_image, &rect);
 }
 
+// Read the surface back into its derived image. This goes through the
+// staging copy, which commit_derived_image() compares the image with
+static VAStatus
+read_derived_image(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface,
+    object_image_p       obj_image
+)
+{
+    uint8_t *staging[3];
+    unsigned int staging_stride[3];
+    VAStatus va_status;
+
+    object_buffer_p obj_buffer = VDPAU_BUFFER(obj_image->image.buf);
+    if (!obj_buffer)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    va_status = sync_surface_decode(driver_data, obj_surface);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    va_status = get_staging_buffer(driver_data, obj_surface,
+                                   obj_image->vdp_format,
+                                   staging, staging_stride);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    /* Derived images have the surface size, hence the staging layout */
+    memcpy(obj_buffer->buffer_data, obj_surface->staging_data,
+           obj_image->image.data_size);
+    return VA_STATUS_SUCCESS;
+}
+
+// Returns the format of derived images, NV12 if VDPAU can read it back
+static const VAImageFormat *
+get_derived_image_format(vdpau_driver_data_t *driver_data)
+{
+    static const uint32_t fourccs[] = {
+        VA_FOURCC('N','V','1','2'),
+        VA_FOURCC('Y','V','1','2'),
+    };
+    unsigned int i, j;
+
+    for (i = 0; i < ARRAY_ELEMS(fourccs); i++) {
+        for (j = 0; j < ARRAY_ELEMS(vdpau_image_formats_map); j++) {
+            const vdpau_image_format_map_t * const m = &vdpau_image_formats_map[j];
+            if (m->va_format.fourcc == fourccs[i] &&
+                is_supported_format(driver_data, m->vdp_format_type, m->vdp_format))
+                return &m->va_format;
+        }
+    }
+    return NULL;
+}
+
+// vaDeriveImage
+VAStatus
+vdpau_DeriveImage(
+    VADriverContextP    ctx,
+    VASurfaceID         surface,
+    VAImage             *image
+)
+{
+    VDPAU_DRIVER_DATA_INIT;
+
+    VAStatus va_status;
+
+    if (!image)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    object_surface_p obj_surface = VDPAU_SURFACE(surface);
+    if (!obj_surface)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    /* VDPAU surfaces cannot be mapped, so the image is a copy of the
+       surface that is kept until it is destroyed and only read back again
+       once the surface changed. vaMapBuffer() does not tell reads from
+       writes, so the image is compared with the staging copy it was read
+       from when its buffer is unmapped, and only written back to the
+       surface if it differs, see commit_derived_image() */
+    object_image_p obj_image = VDPAU_IMAGE(obj_surface->derived_image);
+    if (!obj_image) {
+        if (obj_surface->vdp_chroma_type != VDP_CHROMA_TYPE_420)
+            return VA_STATUS_ERROR_OPERATION_FAILED;
+
+        const VAImageFormat * const format = get_derived_image_format(driver_data);
+        if (!format)
+            return VA_STATUS_ERROR_OPERATION_FAILED;
+
+        VAImage derived_image;
+        va_status = vdpau_CreateImage(ctx, (VAImageFormat *)format,
+                                      obj_surface->width, obj_surface->height,
+                                      &derived_image);
+        if (va_status != VA_STATUS_SUCCESS)
+            return va_status;
+
+        obj_image = VDPAU_IMAGE(derived_image.image_id);
+        if (!obj_image)
+            return VA_STATUS_ERROR_INVALID_IMAGE;
+
+        object_buffer_p obj_buffer = VDPAU_BUFFER(derived_image.buf);
+        if (!obj_buffer)
+            return VA_STATUS_ERROR_INVALID_BUFFER;
+
+        obj_buffer->derived_image        = derived_image.image_id;
+        obj_image->derived_surface       = surface;
+        obj_surface->derived_image       = derived_image.image_id;
+        obj_surface->derived_image_valid = 0;
+    }
+
+    if (!obj_surface->derived_image_valid) {
+        va_status = read_derived_image(driver_data, obj_surface, obj_image);
+        if (va_status != VA_STATUS_SUCCESS)
+            return va_status;
+        obj_surface->derived_image_valid = 1;
+    }
+
+    *image = obj_image->image;
+    return VA_STATUS_SUCCESS;
+}
+
+// Destroy the image cached by vaDeriveImage() for the surface
+void
+destroy_derived_image(VADriverContextP ctx, object_surface_p obj_surface)
+{
+    vdpau_driver_data_t * const driver_data = ctx->pDriverData;
+
+    object_image_p obj_image = VDPAU_IMAGE(obj_surface->derived_image);
+    obj_surface->derived_image       = VA_INVALID_ID;
+    obj_surface->derived_image_valid = 0;
+    if (!obj_image)
+        return;
+
+    obj_image->derived_surface = VA_INVALID_SURFACE;
+    vdpau_DestroyImage(ctx, obj_image->base.id);
+}
+
 // Put image to surface
 static VAStatus
 put_image(
@@ -527,9 +906,10 @@ put_image(
 )
 {
     VAImage * const image = &obj_image->image;
+    VAStatus va_status;
     VdpStatus vdp_status;
-    uint8_t *src[3];
-    unsigned int src_stride[3];
+    uint8_t *src[3], *staging[3];
+    unsigned int src_stride[3], staging_stride[3];
     int i;
 
 #if 0
@@ -540,28 +920,36 @@ put_image(
 #endif
 
     /* RGBA to video surface requires color space conversion */
-    if (obj_image->vdp_rgba_output_surface != VDP_INVALID_HANDLE)
+    if (obj_image->vdp_format_type == VDP_IMAGE_FORMAT_TYPE_RGBA)
         return VA_STATUS_ERROR_OPERATION_FAILED;
 
-    /* VDPAU does not support partial video surface updates */
-    if (src_rect->x != 0 ||
-        src_rect->y != 0 ||
-        src_rect->width != image->width ||
-        src_rect->height != image->height)
-        return VA_STATUS_ERROR_OPERATION_FAILED;
-    if (dst_rect->x != 0 ||
-        dst_rect->y != 0 ||
-        dst_rect->width != obj_surface->width ||
-        dst_rect->height != obj_surface->height)
-        return VA_STATUS_ERROR_OPERATION_FAILED;
+    /* No scaling */
     if (src_rect->width != dst_rect->width ||
         src_rect->height != dst_rect->height)
         return VA_STATUS_ERROR_OPERATION_FAILED;
+    if (!is_rect_inside(src_rect, image->width, image->height) ||
+        !is_rect_inside(dst_rect, obj_surface->width, obj_surface->height))
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    /* VDPAU does not support partial video surface updates, these go
+       through a copy of the whole surface */
+    const int is_partial = (src_rect->x != 0 ||
+                            src_rect->y != 0 ||
+                            dst_rect->x != 0 ||
+                            dst_rect->y != 0 ||
+                            dst_rect->width != obj_surface->width ||
+                            dst_rect->height != obj_surface->height);
+    if (is_partial && !is_ycbcr_420_image(obj_image))
+        return VA_STATUS_ERROR_OPERATION_FAILED;
 
     object_buffer_p obj_buffer = VDPAU_BUFFER(image->buf);
     if (!obj_buffer)
         return VA_STATUS_ERROR_INVALID_BUFFER;
 
+    va_status = sync_surface_decode(driver_data, obj_surface);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
     switch (image->format.fourcc) {
     case VA_FOURCC('I','4','2','0'):
         src[0] = (uint8_t *)obj_buffer->buffer_data + image->offsets[0];
@@ -583,13 +971,92 @@ put_image(
     if (obj_image->vdp_format_type != VDP_IMAGE_FORMAT_TYPE_YCBCR)
         return VA_STATUS_ERROR_OPERATION_FAILED;
 
+    if (!is_partial) {
+        invalidate_surface_copies(obj_surface);
+        vdp_status = vdpau_video_surface_put_bits_ycbcr(
+            driver_data,
+            obj_surface->vdp_surface,
+            obj_image->vdp_format,
+            src, src_stride
+        );
+        return vdpau_get_VAStatus(vdp_status);
+    }
+
+    va_status = get_staging_buffer(driver_data, obj_surface,
+                                   obj_image->vdp_format,
+                                   staging, staging_stride);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    invalidate_surface_copies(obj_surface);
+    copy_ycbcr_420(obj_image->vdp_format,
+                   staging, staging_stride, dst_rect->x, dst_rect->y,
+                   src, src_stride, src_rect->x, src_rect->y,
+                   dst_rect->width, dst_rect->height,
+                   dst_rect->width == obj_surface->width &&
+                   image->width == obj_surface->width);
+
     vdp_status = vdpau_video_surface_put_bits_ycbcr(
         driver_data,
         obj_surface->vdp_surface,
         obj_image->vdp_format,
-        src, src_stride
+        staging, staging_stride
     );
-    return vdpau_get_VAStatus(vdp_status);
+    if (vdp_status != VDP_STATUS_OK)
+        return vdpau_get_VAStatus(vdp_status);
+
+    /* The staging copy now matches the surface again */
+    obj_surface->staging_format = obj_image->vdp_format;
+    obj_surface->staging_valid  = 1;
+    return VA_STATUS_SUCCESS;
+}
+
+// Write a derived image back to its surface, once its buffer is unmapped,
+// unless the client did not change it
+VAStatus
+commit_derived_image(
+    vdpau_driver_data_t *driver_data,
+    object_buffer_p      obj_buffer
+)
+{
+    object_image_p obj_image = VDPAU_IMAGE(obj_buffer->derived_image);
+    if (!obj_image)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    object_surface_p obj_surface = VDPAU_SURFACE(obj_image->derived_surface);
+    if (!obj_surface)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    const unsigned int size = obj_image->image.data_size;
+    const int has_staging   = (obj_surface->staging_valid &&
+                               obj_surface->staging_format == obj_image->vdp_format);
+
+    /* The staging copy is what the image was read from, and what the
+       surface still holds: the image was only read if they match */
+    if (has_staging &&
+        memcmp(obj_buffer->buffer_data, obj_surface->staging_data, size) == 0) {
+        obj_surface->derived_image_valid = 1;
+        return VA_STATUS_SUCCESS;
+    }
+
+    VARectangle rect;
+    rect.x      = 0;
+    rect.y      = 0;
+    rect.width  = obj_surface->width;
+    rect.height = obj_surface->height;
+    VAStatus va_status = put_image(driver_data, obj_surface, obj_image,
+                                   &rect, &rect);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    /* The image is what the surface holds now, no need to read it back */
+    obj_surface->derived_image_valid = 1;
+    if (obj_surface->staging_size >= size) {
+        memcpy(obj_surface->staging_data, obj_buffer->buffer_data, size);
+        obj_surface->staging_format = obj_image->vdp_format;
+        obj_surface->staging_valid  = 1;
+    }
+    return VA_STATUS_SUCCESS;
 }
 
 // vaPutImage
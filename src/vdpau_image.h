@@ -35,10 +35,15 @@ struct object_image {
     VAImage             image;
     VdpImageFormatType  vdp_format_type;
     uint32_t            vdp_format;
-    VdpOutputSurface    vdp_rgba_output_surface;
     uint32_t           *vdp_palette;
+    VASurfaceID         derived_surface;    /* surface this image shadows */
 };
 
+// Get the alignment of image plane pitches, a power of two
+unsigned int
+get_image_pitch_alignment(void)
+    attribute_hidden;
+
 // vaQueryImageFormats
 VAStatus
 vdpau_QueryImageFormats(
@@ -72,6 +77,19 @@ vdpau_DeriveImage(
     VAImage            *image
 ) attribute_hidden;
 
+// Write a derived image back to its surface, once its buffer is unmapped,
+// unless the client did not change it
+VAStatus
+commit_derived_image(
+    vdpau_driver_data_t *driver_data,
+    object_buffer_p      obj_buffer
+) attribute_hidden;
+
+// Destroy the image cached by vaDeriveImage() for the surface
+void
+destroy_derived_image(VADriverContextP ctx, object_surface_p obj_surface)
+    attribute_hidden;
+
 // vaSetImagePalette
 VAStatus
 vdpau_SetImagePalette(
@@ -21,14 +21,29 @@
 #include "sysdeps.h"
 #include "vdpau_mixer.h"
 #include "vdpau_video.h"
+#include "vdpau_caps.h"
+#include "utils.h"
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
 #endif
 #include <math.h>
 
+#define DEBUG 1
+#include "debug.h"
+
 #define VDPAU_MAX_VIDEO_MIXER_PARAMS    4
 #define VDPAU_MAX_VIDEO_MIXER_FEATURES  20
 
+/* Default number of idle mixers kept, and for how long (in ms) */
+#define VDPAU_MIXER_CACHE_SIZE          4
+#define VDPAU_MIXER_CACHE_TIMEOUT       10000
+
+static void
+video_mixer_free(
+    vdpau_driver_data_t *driver_data,
+    object_mixer_p       obj_mixer
+);
+
 static inline int
 video_mixer_check_params(
     object_mixer_p       obj_mixer,
@@ -55,17 +70,7 @@ video_mixer_has_feature(
     VdpVideoMixerFeature feature
 )
 {
-    VdpBool is_supported = VDP_FALSE;
-    VdpStatus status;
-
-    status = vdpau_video_mixer_query_feature_support(
-        driver_data,
-        driver_data->vdp_device,
-        feature,
-        &is_supported
-    );
-    return (VDPAU_CHECK_STATUS(status, "VdpVideoMixerQueryFeatureSupport()") &&
-            is_supported);
+    return vdpau_caps_has_mixer_feature(driver_data, feature);
 }
 
 object_mixer_p
@@ -92,6 +97,12 @@ video_mixer_create(
     obj_mixer->vdp_bgcolor_mtime = 0;
     obj_mixer->hqscaling_level   = 0;
     obj_mixer->va_scale          = 0;
+    obj_mixer->hash_next         = NULL;
+    obj_mixer->idle_prev         = NULL;
+    obj_mixer->idle_next         = NULL;
+    obj_mixer->idle_time         = 0;
+    obj_mixer->is_cached         = 0;
+    obj_mixer->is_idle           = 0;
 
     VdpProcamp * const procamp   = &obj_mixer->vdp_procamp;
     procamp->struct_version      = VDP_PROCAMP_VERSION;
@@ -131,32 +142,203 @@ video_mixer_create(
         &obj_mixer->vdp_video_mixer
     );
     if (!VDPAU_CHECK_STATUS(vdp_status, "VdpVideoMixerCreate()")) {
-        video_mixer_destroy(driver_data, obj_mixer);
+        video_mixer_free(driver_data, obj_mixer);
         return NULL;
     }
     return obj_mixer;
 }
 
+static inline unsigned int
+video_mixer_hash(
+    unsigned int         width,
+    unsigned int         height,
+    VdpChromaType        chroma_type
+)
+{
+    return ((width * 31 + height) * 31 + chroma_type) %
+        VDPAU_MIXER_CACHE_BUCKETS;
+}
+
+static void
+mixer_cache_remove_idle(vdpau_mixer_cache_t *cache, object_mixer_p obj_mixer)
+{
+    if (!obj_mixer->is_idle)
+        return;
+
+    if (obj_mixer->idle_prev)
+        obj_mixer->idle_prev->idle_next = obj_mixer->idle_next;
+    else
+        cache->idle_head = obj_mixer->idle_next;
+    if (obj_mixer->idle_next)
+        obj_mixer->idle_next->idle_prev = obj_mixer->idle_prev;
+    else
+        cache->idle_tail = obj_mixer->idle_prev;
+    obj_mixer->idle_prev = NULL;
+    obj_mixer->idle_next = NULL;
+    obj_mixer->is_idle   = 0;
+    cache->num_idle--;
+}
+
+static void
+mixer_cache_add_idle(vdpau_mixer_cache_t *cache, object_mixer_p obj_mixer)
+{
+    /* The past surfaces may be destroyed while the mixer sits idle */
+    video_mixer_init_deint_surfaces(obj_mixer);
+
+    obj_mixer->idle_time = get_ticks_usec();
+    obj_mixer->idle_prev = NULL;
+    obj_mixer->idle_next = cache->idle_head;
+    if (cache->idle_head)
+        cache->idle_head->idle_prev = obj_mixer;
+    else
+        cache->idle_tail = obj_mixer;
+    cache->idle_head = obj_mixer;
+    obj_mixer->is_idle = 1;
+    cache->num_idle++;
+}
+
+static void
+mixer_cache_unlink(vdpau_mixer_cache_t *cache, object_mixer_p obj_mixer)
+{
+    object_mixer_p *pnext;
+
+    if (!obj_mixer->is_cached)
+        return;
+
+    mixer_cache_remove_idle(cache, obj_mixer);
+
+    pnext = &cache->buckets[video_mixer_hash(obj_mixer->width,
+                                             obj_mixer->height,
+                                             obj_mixer->vdp_chroma_type)];
+    while (*pnext && *pnext != obj_mixer)
+        pnext = &(*pnext)->hash_next;
+    if (*pnext)
+        *pnext = obj_mixer->hash_next;
+    obj_mixer->hash_next = NULL;
+    obj_mixer->is_cached = 0;
+}
+
+static void
+video_mixer_free(
+    vdpau_driver_data_t *driver_data,
+    object_mixer_p       obj_mixer
+)
+{
+    if (obj_mixer->vdp_video_mixer != VDP_INVALID_HANDLE) {
+        vdpau_video_mixer_destroy(driver_data, obj_mixer->vdp_video_mixer);
+        obj_mixer->vdp_video_mixer = VDP_INVALID_HANDLE;
+    }
+    object_heap_free(&driver_data->mixer_heap, (object_base_p)obj_mixer);
+}
+
+// Evict idle mixers beyond the size limit, or idle for too long
+static void
+mixer_cache_evict(vdpau_driver_data_t *driver_data, vdpau_mixer_cache_t *cache)
+{
+    const uint64_t now = get_ticks_usec();
+    object_mixer_p obj_mixer;
+
+    while ((obj_mixer = cache->idle_tail) != NULL) {
+        if (cache->num_idle <= cache->max_idle &&
+            obj_mixer->idle_time + cache->idle_timeout > now)
+            break;
+        mixer_cache_unlink(cache, obj_mixer);
+        video_mixer_free(driver_data, obj_mixer);
+        cache->num_evictions++;
+    }
+}
+
+int
+video_mixer_cache_init(vdpau_driver_data_t *driver_data)
+{
+    vdpau_mixer_cache_t *cache;
+    int value;
+
+    driver_data->mixer_cache = NULL;
+
+    cache = calloc(1, sizeof(*cache));
+    if (!cache)
+        return -1;
+
+    if (getenv_int("VDPAU_VIDEO_MIXER_CACHE_SIZE", &value) < 0 || value < 0)
+        value = VDPAU_MIXER_CACHE_SIZE;
+    cache->max_idle = value;
+    if (getenv_int("VDPAU_VIDEO_MIXER_CACHE_TIMEOUT", &value) < 0 || value < 0)
+        value = VDPAU_MIXER_CACHE_TIMEOUT;
+    cache->idle_timeout = (uint64_t)value * 1000;
+
+    pthread_mutex_init(&cache->lock, NULL);
+    driver_data->mixer_cache = cache;
+    return 0;
+}
+
+void
+video_mixer_cache_exit(vdpau_driver_data_t *driver_data)
+{
+    vdpau_mixer_cache_t * const cache = driver_data->mixer_cache;
+    object_mixer_p obj_mixer;
+
+    if (!cache)
+        return;
+
+    D(bug("video mixer cache: %u hits, %u misses, %u evictions\n",
+          cache->num_hits, cache->num_misses, cache->num_evictions));
+
+    /* Mixers still referenced by surfaces are reclaimed with the heap */
+    while ((obj_mixer = cache->idle_tail) != NULL) {
+        mixer_cache_unlink(cache, obj_mixer);
+        video_mixer_free(driver_data, obj_mixer);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+    driver_data->mixer_cache = NULL;
+}
+
 object_mixer_p
 video_mixer_create_cached(
     vdpau_driver_data_t *driver_data,
     object_surface_p     obj_surface
 )
 {
+    vdpau_mixer_cache_t * const cache = driver_data->mixer_cache;
     object_mixer_p obj_mixer = obj_surface->video_mixer;
+    unsigned int hash;
 
     if (obj_mixer)
         return video_mixer_ref(driver_data, obj_mixer);
 
-    object_heap_iterator iter;
-    object_base_p obj = object_heap_first(&driver_data->mixer_heap, &iter);
-    while (obj) {
-        obj_mixer = (object_mixer_p)obj;
+    if (!cache)
+        return video_mixer_create(driver_data, obj_surface);
+
+    hash = video_mixer_hash(obj_surface->width, obj_surface->height,
+                            obj_surface->vdp_chroma_type);
+
+    pthread_mutex_lock(&cache->lock);
+    for (obj_mixer = cache->buckets[hash]; obj_mixer;
+         obj_mixer = obj_mixer->hash_next) {
         if (video_mixer_check_params(obj_mixer, obj_surface))
-            return video_mixer_ref(driver_data, obj_mixer);
-        obj = object_heap_next(&driver_data->mixer_heap, &iter);
+            break;
+    }
+    if (obj_mixer) {
+        /* A revived mixer must not reference the previous stream */
+        if (obj_mixer->is_idle)
+            video_mixer_init_deint_surfaces(obj_mixer);
+        mixer_cache_remove_idle(cache, obj_mixer);
+        ++obj_mixer->refcount;
+        cache->num_hits++;
+    }
+    else {
+        obj_mixer = video_mixer_create(driver_data, obj_surface);
+        if (obj_mixer) {
+            obj_mixer->hash_next = cache->buckets[hash];
+            obj_mixer->is_cached = 1;
+            cache->buckets[hash] = obj_mixer;
+        }
+        cache->num_misses++;
     }
-    return video_mixer_create(driver_data, obj_surface);
+    mixer_cache_evict(driver_data, cache);
+    pthread_mutex_unlock(&cache->lock);
+    return obj_mixer;
 }
 
 void
@@ -165,14 +347,17 @@ video_mixer_destroy(
     object_mixer_p       obj_mixer
 )
 {
+    vdpau_mixer_cache_t * const cache = driver_data->mixer_cache;
+
     if (!obj_mixer)
         return;
 
-    if (obj_mixer->vdp_video_mixer != VDP_INVALID_HANDLE) {
-        vdpau_video_mixer_destroy(driver_data, obj_mixer->vdp_video_mixer);
-        obj_mixer->vdp_video_mixer = VDP_INVALID_HANDLE;
+    if (cache) {
+        pthread_mutex_lock(&cache->lock);
+        mixer_cache_unlink(cache, obj_mixer);
+        pthread_mutex_unlock(&cache->lock);
     }
-    object_heap_free(&driver_data->mixer_heap, (object_base_p)obj_mixer);
+    video_mixer_free(driver_data, obj_mixer);
 }
 
 object_mixer_p
@@ -181,8 +366,16 @@ video_mixer_ref(
     object_mixer_p       obj_mixer
 )
 {
-    if (obj_mixer)
-        ++obj_mixer->refcount;
+    vdpau_mixer_cache_t * const cache = driver_data->mixer_cache;
+
+    if (!obj_mixer)
+        return NULL;
+
+    if (cache)
+        pthread_mutex_lock(&cache->lock);
+    ++obj_mixer->refcount;
+    if (cache)
+        pthread_mutex_unlock(&cache->lock);
     return obj_mixer;
 }
 
@@ -192,8 +385,24 @@ video_mixer_unref(
     object_mixer_p       obj_mixer
 )
 {
-    if (obj_mixer && --obj_mixer->refcount == 0)
-        video_mixer_destroy(driver_data, obj_mixer);
+    vdpau_mixer_cache_t * const cache = driver_data->mixer_cache;
+
+    if (!obj_mixer)
+        return;
+
+    if (!cache || !obj_mixer->is_cached) {
+        if (--obj_mixer->refcount == 0)
+            video_mixer_destroy(driver_data, obj_mixer);
+        return;
+    }
+
+    /* Keep the last reference in the cache, see mixer_cache_evict() */
+    pthread_mutex_lock(&cache->lock);
+    if (--obj_mixer->refcount == 0) {
+        mixer_cache_add_idle(cache, obj_mixer);
+        mixer_cache_evict(driver_data, cache);
+    }
+    pthread_mutex_unlock(&cache->lock);
 }
 
 static VdpStatus
@@ -272,6 +481,36 @@ video_mixer_update_csc_matrix(
     return VDP_STATUS_OK;
 }
 
+// Checks whether video_mixer_render() with FLAGS would convert with the
+// default BT.601 CSC matrix, i.e. with neutral procamp attributes
+int
+video_mixer_has_default_csc(
+    vdpau_driver_data_t *driver_data,
+    unsigned int         flags
+)
+{
+    unsigned int i;
+
+    if (flags & (VA_SRC_SMPTE_240|VA_SRC_BT709))
+        return 0;
+
+    for (i = 0; i < driver_data->va_display_attrs_count; i++) {
+        VADisplayAttribute * const attr = &driver_data->va_display_attrs[i];
+        switch (attr->type) {
+        case VADisplayAttribBrightness:
+        case VADisplayAttribContrast:
+        case VADisplayAttribSaturation:
+        case VADisplayAttribHue:
+            if (attr->value != 0)
+                return 0;
+            break;
+        default:
+            break;
+        }
+    }
+    return 1;
+}
+
 VdpStatus
 video_mixer_set_background_color(
     vdpau_driver_data_t *driver_data,
@@ -387,6 +626,9 @@ video_mixer_render(
     unsigned int         flags
 )
 {
+    if (sync_surface_decode(driver_data, obj_surface) != VA_STATUS_SUCCESS)
+        return VDP_STATUS_ERROR;
+
     VdpColorStandard vdp_colorspace;
     if (flags & VA_SRC_SMPTE_240)
         vdp_colorspace = VDP_COLOR_STANDARD_SMPTE_240M;
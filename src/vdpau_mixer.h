@@ -22,9 +22,29 @@
 #define VDPAU_MIXER_H
 
 #include "vdpau_driver.h"
+#include <pthread.h>
 
 #define VDPAU_MAX_VIDEO_MIXER_DEINT_SURFACES 3
 
+/* Mixers are shared by all surfaces with the same size and chroma type.
+ * Once the last surface goes away, a mixer is kept idle for a while so
+ * that surfaces of the same geometry created later can reuse it. */
+#define VDPAU_MIXER_CACHE_BUCKETS       64
+
+typedef struct vdpau_mixer_cache vdpau_mixer_cache_t;
+struct vdpau_mixer_cache {
+    pthread_mutex_t             lock;
+    object_mixer_p              buckets[VDPAU_MIXER_CACHE_BUCKETS];
+    object_mixer_p              idle_head;      /* most recently released */
+    object_mixer_p              idle_tail;
+    unsigned int                num_idle;
+    unsigned int                max_idle;
+    uint64_t                    idle_timeout;   /* usec */
+    unsigned int                num_hits;
+    unsigned int                num_misses;
+    unsigned int                num_evictions;
+};
+
 typedef struct object_mixer object_mixer_t;
 struct object_mixer {
     struct object_base          base;
@@ -40,8 +60,22 @@ struct object_mixer {
     uint64_t                    vdp_procamp_mtime;
     uint64_t                    vdp_bgcolor_mtime;
     VdpVideoSurface             deint_surfaces[VDPAU_MAX_VIDEO_MIXER_DEINT_SURFACES];
+    object_mixer_p              hash_next;
+    object_mixer_p              idle_prev;
+    object_mixer_p              idle_next;
+    uint64_t                    idle_time;
+    unsigned int                is_cached       : 1;
+    unsigned int                is_idle         : 1;
 };
 
+int
+video_mixer_cache_init(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+void
+video_mixer_cache_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
 object_mixer_p
 video_mixer_create(
     vdpau_driver_data_t *driver_data,
@@ -72,6 +106,12 @@ video_mixer_unref(
     object_mixer_p       obj_mixer
 ) attribute_hidden;
 
+int
+video_mixer_has_default_csc(
+    vdpau_driver_data_t *driver_data,
+    unsigned int         flags
+) attribute_hidden;
+
 VdpStatus
 video_mixer_set_background_color(
     vdpau_driver_data_t *driver_data,
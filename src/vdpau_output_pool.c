@@ -0,0 +1,131 @@
+/*
+ *  vdpau_output_pool.c - VDPAU backend for VA-API (RGBA output surface pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_output_pool.h"
+#include "utils.h"
+
+/* Default number of idle output surfaces kept, and for how long (in ms) */
+#define VDPAU_OUTPUT_POOL_SIZE          4
+#define VDPAU_OUTPUT_POOL_TIMEOUT       5000
+
+// Create a VDPAU output surface for the pool
+static VdpStatus
+output_pool_create(
+    vdpau_driver_data_t *driver_data,
+    uint32_t             rgba_format,
+    uint32_t             width,
+    uint32_t             height,
+    uint32_t            *surface
+)
+{
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_output_surface_create(
+        driver_data,
+        driver_data->vdp_device,
+        rgba_format,
+        width, height,
+        surface
+    );
+    VDPAU_CHECK_STATUS(vdp_status, "VdpOutputSurfaceCreate()");
+    return vdp_status;
+}
+
+// Destroy a VDPAU output surface of the pool
+static void
+output_pool_destroy(vdpau_driver_data_t *driver_data, uint32_t surface)
+{
+    vdpau_output_surface_destroy(driver_data, surface);
+}
+
+// Create pool of RGBA output surfaces
+int
+vdpau_output_pool_init(vdpau_driver_data_t *driver_data)
+{
+    unsigned int max_surfaces, timeout;
+    int value;
+
+    if (getenv_int("VDPAU_VIDEO_OUTPUT_POOL_SIZE", &value) < 0 || value < 0)
+        value = VDPAU_OUTPUT_POOL_SIZE;
+    max_surfaces = value;
+    if (getenv_int("VDPAU_VIDEO_OUTPUT_POOL_TIMEOUT", &value) < 0 || value < 0)
+        value = VDPAU_OUTPUT_POOL_TIMEOUT;
+    timeout = value;
+
+    driver_data->output_pool = handle_pool_new(
+        "RGBA output surface",
+        max_surfaces, timeout,
+        output_pool_create,
+        output_pool_destroy
+    );
+    if (!driver_data->output_pool)
+        return -1;
+    return 0;
+}
+
+// Destroy pool of RGBA output surfaces
+void
+vdpau_output_pool_exit(vdpau_driver_data_t *driver_data)
+{
+    handle_pool_free(driver_data, driver_data->output_pool);
+    driver_data->output_pool = NULL;
+}
+
+// Get an output surface of the given format and size, a recycled one first
+VdpStatus
+output_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        rgba_format,
+    uint32_t             width,
+    uint32_t             height,
+    VdpOutputSurface    *surface
+)
+{
+    return handle_pool_acquire(
+        driver_data,
+        driver_data->output_pool,
+        rgba_format,
+        width, height,
+        surface, 1
+    );
+}
+
+// Return an output surface to the pool, or destroy it
+void
+output_pool_release(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        rgba_format,
+    uint32_t             width,
+    uint32_t             height,
+    VdpOutputSurface     surface
+)
+{
+    if (surface == VDP_INVALID_HANDLE)
+        return;
+
+    handle_pool_release(
+        driver_data,
+        driver_data->output_pool,
+        rgba_format,
+        width, height,
+        &surface, 1
+    );
+}
@@ -0,0 +1,63 @@
+/*
+ *  vdpau_output_pool.h - VDPAU backend for VA-API (RGBA output surface pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef VDPAU_OUTPUT_POOL_H
+#define VDPAU_OUTPUT_POOL_H
+
+#include "vdpau_driver.h"
+#include "vdpau_handle_pool.h"
+
+/* VdpOutputSurfaces used to read video surfaces back as RGBA images are
+ * shared by all images and kept per (format, width, height), so that
+ * short-lived images do not go through VdpOutputSurfaceCreate() on every
+ * vaGetImage(). */
+
+// Create pool of RGBA output surfaces
+int
+vdpau_output_pool_init(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Destroy pool of RGBA output surfaces
+void
+vdpau_output_pool_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Get an output surface of the given format and size, a recycled one first
+VdpStatus
+output_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        rgba_format,
+    uint32_t             width,
+    uint32_t             height,
+    VdpOutputSurface    *surface
+) attribute_hidden;
+
+// Return an output surface to the pool, or destroy it
+void
+output_pool_release(
+    vdpau_driver_data_t *driver_data,
+    VdpRGBAFormat        rgba_format,
+    uint32_t             width,
+    uint32_t             height,
+    VdpOutputSurface     surface
+) attribute_hidden;
+
+#endif /* VDPAU_OUTPUT_POOL_H */
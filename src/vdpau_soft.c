@@ -0,0 +1,2215 @@
+/*
+ *  vdpau_soft.c - VDPAU backend for VA-API (software VDPAU device)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_soft.h"
+#include "vdpau_decode.h"
+#include "object_heap.h"
+#include "vdpau_stats.h"
+#include "utils.h"
+#include <pthread.h>
+#include <math.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+#define SOFT_DEVICE_HANDLE              1
+#define SOFT_MAX_SURFACE_SIZE           8192
+#define SOFT_MAX_DECODER_SIZE           4096
+#define SOFT_MAX_MIXER_FEATURES         16
+#define SOFT_QUEUE_DEPTH                64
+#define SOFT_VSYNC_PERIOD               16666667 /* ns, 60 Hz */
+
+#define SOFT_VIDEO_SURFACE_ID_OFFSET    0x01000000
+#define SOFT_OUTPUT_SURFACE_ID_OFFSET   0x02000000
+#define SOFT_BITMAP_SURFACE_ID_OFFSET   0x03000000
+#define SOFT_MIXER_ID_OFFSET            0x04000000
+#define SOFT_QUEUE_TARGET_ID_OFFSET     0x05000000
+#define SOFT_QUEUE_ID_OFFSET            0x06000000
+#define SOFT_DECODER_ID_OFFSET          0x07000000
+
+typedef struct soft_video_surface  soft_video_surface_t;
+typedef struct soft_video_surface *soft_video_surface_p;
+typedef struct soft_rgba_surface   soft_rgba_surface_t;
+typedef struct soft_rgba_surface  *soft_output_surface_p;
+typedef struct soft_rgba_surface  *soft_bitmap_surface_p;
+typedef struct soft_mixer          soft_mixer_t;
+typedef struct soft_mixer         *soft_mixer_p;
+typedef struct soft_queue_target   soft_queue_target_t;
+typedef struct soft_queue_target  *soft_queue_target_p;
+typedef struct soft_queue          soft_queue_t;
+typedef struct soft_queue         *soft_queue_p;
+typedef struct soft_decoder        soft_decoder_t;
+typedef struct soft_decoder       *soft_decoder_p;
+
+struct soft_video_surface {
+    struct object_base          base;
+    VdpChromaType               chroma_type;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    chroma_width;
+    uint32_t                    chroma_height;
+    uint8_t                    *planes[3];      /* Y, Cb, Cr */
+};
+
+struct soft_rgba_surface {
+    struct object_base          base;
+    VdpRGBAFormat               rgba_format;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint8_t                    *pixels;         /* 4 bytes per pixel, native order */
+};
+
+struct soft_mixer {
+    struct object_base          base;
+    uint32_t                    width;
+    uint32_t                    height;
+    VdpChromaType               chroma_type;
+    VdpColor                    background_color;
+    VdpCSCMatrix                csc_matrix;
+    VdpVideoMixerFeature        features[SOFT_MAX_MIXER_FEATURES];
+    VdpBool                     feature_enables[SOFT_MAX_MIXER_FEATURES];
+    unsigned int                num_features;
+};
+
+struct soft_queue_target {
+    struct object_base          base;
+    Drawable                    drawable;
+};
+
+typedef struct {
+    VdpOutputSurface            surface;
+    VdpTime                     time;
+} soft_queue_entry_t;
+
+struct soft_queue {
+    struct object_base          base;
+    VdpPresentationQueueTarget  target;
+    VdpColor                    background_color;
+    pthread_mutex_t             lock;
+    pthread_cond_t              cond;
+    VdpTime                     epoch;
+    soft_queue_entry_t          entries[SOFT_QUEUE_DEPTH];
+    unsigned int                num_entries;    /* total number of displays */
+};
+
+struct soft_decoder {
+    struct object_base          base;
+    VdpDecoderProfile           profile;
+    uint32_t                    width;
+    uint32_t                    height;
+    uint32_t                    max_references;
+};
+
+typedef struct {
+    unsigned int                refcount;
+    struct object_heap          video_surface_heap;
+    struct object_heap          output_surface_heap;
+    struct object_heap          bitmap_surface_heap;
+    struct object_heap          mixer_heap;
+    struct object_heap          queue_target_heap;
+    struct object_heap          queue_heap;
+    struct object_heap          decoder_heap;
+} soft_device_t;
+
+/* VDPAU object handles carry no device, so all devices share a
+   process-wide set of handle heaps */
+static pthread_mutex_t g_soft_device_lock = PTHREAD_MUTEX_INITIALIZER;
+static soft_device_t   g_soft_device;
+
+#define SOFT_OBJECT(id, type) \
+    ((soft_##type##_p)object_heap_lookup(&g_soft_device.type##_heap, id))
+
+#define SOFT_VIDEO_SURFACE(id)  SOFT_OBJECT(id, video_surface)
+#define SOFT_OUTPUT_SURFACE(id) SOFT_OBJECT(id, output_surface)
+#define SOFT_BITMAP_SURFACE(id) SOFT_OBJECT(id, bitmap_surface)
+#define SOFT_MIXER(id)          SOFT_OBJECT(id, mixer)
+#define SOFT_QUEUE_TARGET(id)   SOFT_OBJECT(id, queue_target)
+#define SOFT_QUEUE(id)          SOFT_OBJECT(id, queue)
+#define SOFT_DECODER(id)        SOFT_OBJECT(id, decoder)
+
+// Check whether the software VDPAU device was requested
+int vdpau_soft_enabled(void)
+{
+    static int g_soft_enabled = -1;
+
+    if (g_soft_enabled < 0) {
+        if (getenv_yesno("VDPAU_VIDEO_SOFTWARE", &g_soft_enabled) < 0)
+            g_soft_enabled = 0;
+    }
+    return g_soft_enabled;
+}
+
+// Get current time in nanoseconds
+static inline VdpTime soft_get_time(void)
+{
+    return get_ticks_usec() * 1000;
+}
+
+static inline int clamp_u8(float v)
+{
+    if (v <= 0.0f)
+        return 0;
+    if (v >= 1.0f)
+        return 255;
+    return (int)(v * 255.0f + 0.5f);
+}
+
+static inline int is_valid_rgba_format(VdpRGBAFormat format)
+{
+    return (format == VDP_RGBA_FORMAT_B8G8R8A8 ||
+            format == VDP_RGBA_FORMAT_R8G8B8A8);
+}
+
+// Normalize RECT against a WIDTH x HEIGHT surface, NULL means whole surface
+static int
+get_rect(const VdpRect *rect, uint32_t width, uint32_t height, VdpRect *out)
+{
+    if (!rect) {
+        out->x0 = 0;
+        out->y0 = 0;
+        out->x1 = width;
+        out->y1 = height;
+        return 1;
+    }
+    if (rect->x0 > rect->x1 || rect->y0 > rect->y1 ||
+        rect->x1 > width || rect->y1 > height)
+        return 0;
+    *out = *rect;
+    return 1;
+}
+
+/* ====================================================================== */
+/* === RGBA pixels                                                    === */
+/* ====================================================================== */
+
+typedef struct {
+    float r, g, b, a;
+} soft_pixel_t;
+
+static inline void
+get_pixel(const soft_rgba_surface_t *s, uint32_t x, uint32_t y, soft_pixel_t *p)
+{
+    const uint8_t * const src = s->pixels + 4 * (y * s->width + x);
+
+    if (s->rgba_format == VDP_RGBA_FORMAT_B8G8R8A8) {
+        p->b = src[0] / 255.0f;
+        p->g = src[1] / 255.0f;
+        p->r = src[2] / 255.0f;
+    }
+    else {
+        p->r = src[0] / 255.0f;
+        p->g = src[1] / 255.0f;
+        p->b = src[2] / 255.0f;
+    }
+    p->a = src[3] / 255.0f;
+}
+
+static inline void
+put_pixel(soft_rgba_surface_t *s, uint32_t x, uint32_t y, const soft_pixel_t *p)
+{
+    uint8_t * const dst = s->pixels + 4 * (y * s->width + x);
+
+    if (s->rgba_format == VDP_RGBA_FORMAT_B8G8R8A8) {
+        dst[0] = clamp_u8(p->b);
+        dst[1] = clamp_u8(p->g);
+        dst[2] = clamp_u8(p->r);
+    }
+    else {
+        dst[0] = clamp_u8(p->r);
+        dst[1] = clamp_u8(p->g);
+        dst[2] = clamp_u8(p->b);
+    }
+    dst[3] = clamp_u8(p->a);
+}
+
+static void
+fill_rect(soft_rgba_surface_t *s, const VdpRect *rect, const VdpColor *color)
+{
+    soft_pixel_t p;
+    uint32_t x, y;
+
+    p.r = color->red;
+    p.g = color->green;
+    p.b = color->blue;
+    p.a = color->alpha;
+    for (y = rect->y0; y < rect->y1; y++)
+        for (x = rect->x0; x < rect->x1; x++)
+            put_pixel(s, x, y, &p);
+}
+
+static float
+get_blend_factor(
+    uint32_t            factor,
+    const soft_pixel_t *src,
+    const soft_pixel_t *dst,
+    const VdpColor     *constant,
+    int                 component   /* 0..2: color, 3: alpha */
+)
+{
+    const float s[4] = { src->r, src->g, src->b, src->a };
+    const float d[4] = { dst->r, dst->g, dst->b, dst->a };
+    const float c[4] = { constant->red, constant->green,
+                         constant->blue, constant->alpha };
+
+    switch (factor) {
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO:
+        return 0.0f;
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE:
+        return 1.0f;
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_COLOR:
+        return s[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_COLOR:
+        return 1.0f - s[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA:
+        return s[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:
+        return 1.0f - s[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_DST_ALPHA:
+        return d[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:
+        return 1.0f - d[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_DST_COLOR:
+        return d[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_DST_COLOR:
+        return 1.0f - d[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA_SATURATE:
+        if (component == 3)
+            return 1.0f;
+        return s[3] < 1.0f - d[3] ? s[3] : 1.0f - d[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_CONSTANT_COLOR:
+        return c[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR:
+        return 1.0f - c[component];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_CONSTANT_ALPHA:
+        return c[3];
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA:
+        return 1.0f - c[3];
+    }
+    return 0.0f;
+}
+
+static inline float
+blend_component(uint32_t equation, float s, float sf, float d, float df)
+{
+    switch (equation) {
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_SUBTRACT:
+        return s * sf - d * df;
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_REVERSE_SUBTRACT:
+        return d * df - s * sf;
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MIN:
+        return s < d ? s : d;
+    case VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_MAX:
+        return s > d ? s : d;
+    }
+    return s * sf + d * df;
+}
+
+static void
+blend_pixel(
+    const VdpOutputSurfaceRenderBlendState *blend_state,
+    const soft_pixel_t                     *src,
+    soft_pixel_t                           *dst
+)
+{
+    const VdpColor * const constant = &blend_state->blend_constant;
+    const soft_pixel_t d = *dst;
+    float sf, df;
+
+#define BLEND(c, i, factor, equation) do {                                  \
+        sf = get_blend_factor(blend_state->blend_factor_source_##factor,    \
+                              src, &d, constant, i);                        \
+        df = get_blend_factor(blend_state->blend_factor_destination_##factor, \
+                              src, &d, constant, i);                        \
+        dst->c = blend_component(blend_state->blend_equation_##equation,    \
+                                 src->c, sf, d.c, df);                      \
+    } while (0)
+
+    BLEND(r, 0, color, color);
+    BLEND(g, 1, color, color);
+    BLEND(b, 2, color, color);
+    BLEND(a, 3, alpha, alpha);
+#undef BLEND
+}
+
+// Scale SRC_RECT of SRC onto DST_RECT of DST (nearest), optionally blending
+static void
+render_rgba_surface(
+    soft_rgba_surface_t                    *dst,
+    const VdpRect                          *dst_rect,
+    const soft_rgba_surface_t              *src,
+    const VdpRect                          *src_rect,
+    const VdpColor                         *color,
+    const VdpOutputSurfaceRenderBlendState *blend_state
+)
+{
+    const uint32_t dst_w = dst_rect->x1 - dst_rect->x0;
+    const uint32_t dst_h = dst_rect->y1 - dst_rect->y0;
+    uint32_t x, y, sx, sy;
+    soft_pixel_t s, d;
+
+    if (dst_w == 0 || dst_h == 0)
+        return;
+
+    for (y = 0; y < dst_h; y++) {
+        for (x = 0; x < dst_w; x++) {
+            if (src) {
+                sx = src_rect->x0 + x * (src_rect->x1 - src_rect->x0) / dst_w;
+                sy = src_rect->y0 + y * (src_rect->y1 - src_rect->y0) / dst_h;
+                get_pixel(src, sx, sy, &s);
+            }
+            else {
+                /* No source surface means opaque white */
+                s.r = s.g = s.b = s.a = 1.0f;
+            }
+            if (color) {
+                s.r *= color->red;
+                s.g *= color->green;
+                s.b *= color->blue;
+                s.a *= color->alpha;
+            }
+            if (blend_state) {
+                get_pixel(dst, dst_rect->x0 + x, dst_rect->y0 + y, &d);
+                blend_pixel(blend_state, &s, &d);
+                s = d;
+            }
+            put_pixel(dst, dst_rect->x0 + x, dst_rect->y0 + y, &s);
+        }
+    }
+}
+
+static soft_rgba_surface_t *
+create_rgba_surface(
+    struct object_heap *heap,
+    VdpRGBAFormat       rgba_format,
+    uint32_t            width,
+    uint32_t            height,
+    uint32_t           *handle
+)
+{
+    soft_rgba_surface_t *obj_surface;
+    int id;
+
+    id = object_heap_allocate(heap);
+    if (id < 0)
+        return NULL;
+
+    obj_surface = (soft_rgba_surface_t *)object_heap_lookup(heap, id);
+    if (!obj_surface)
+        return NULL;
+
+    obj_surface->rgba_format = rgba_format;
+    obj_surface->width       = width;
+    obj_surface->height      = height;
+    obj_surface->pixels      = calloc(width * height, 4);
+    if (!obj_surface->pixels) {
+        object_heap_free(heap, (object_base_p)obj_surface);
+        return NULL;
+    }
+    *handle = id;
+    return obj_surface;
+}
+
+static void
+destroy_rgba_surface(struct object_heap *heap, soft_rgba_surface_t *obj_surface)
+{
+    free(obj_surface->pixels);
+    obj_surface->pixels = NULL;
+    object_heap_free(heap, (object_base_p)obj_surface);
+}
+
+/* ====================================================================== */
+/* === Device                                                         === */
+/* ====================================================================== */
+
+static void
+destroy_heap(struct object_heap *heap, void (*destroy_func)(object_base_p))
+{
+    object_base_p obj;
+    object_heap_iterator iter;
+
+    obj = object_heap_first(heap, &iter);
+    while (obj) {
+        if (destroy_func)
+            destroy_func(obj);
+        object_heap_free(heap, obj);
+        obj = object_heap_next(heap, &iter);
+    }
+    object_heap_destroy(heap);
+}
+
+static void destroy_video_surface_cb(object_base_p obj)
+{
+    soft_video_surface_p const obj_surface = (soft_video_surface_p)obj;
+
+    free(obj_surface->planes[0]);
+}
+
+static void destroy_rgba_surface_cb(object_base_p obj)
+{
+    soft_rgba_surface_t * const obj_surface = (soft_rgba_surface_t *)obj;
+
+    free(obj_surface->pixels);
+}
+
+static void destroy_queue_cb(object_base_p obj)
+{
+    soft_queue_p const obj_queue = (soft_queue_p)obj;
+
+    pthread_cond_destroy(&obj_queue->cond);
+    pthread_mutex_destroy(&obj_queue->lock);
+}
+
+static VdpStatus
+soft_device_destroy(VdpDevice device)
+{
+    soft_device_t * const dev = &g_soft_device;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    pthread_mutex_lock(&g_soft_device_lock);
+    if (dev->refcount == 0) {
+        pthread_mutex_unlock(&g_soft_device_lock);
+        return VDP_STATUS_INVALID_HANDLE;
+    }
+    if (--dev->refcount == 0) {
+        destroy_heap(&dev->decoder_heap,        NULL);
+        destroy_heap(&dev->queue_heap,          destroy_queue_cb);
+        destroy_heap(&dev->queue_target_heap,   NULL);
+        destroy_heap(&dev->mixer_heap,          NULL);
+        destroy_heap(&dev->bitmap_surface_heap, destroy_rgba_surface_cb);
+        destroy_heap(&dev->output_surface_heap, destroy_rgba_surface_cb);
+        destroy_heap(&dev->video_surface_heap,  destroy_video_surface_cb);
+    }
+    pthread_mutex_unlock(&g_soft_device_lock);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_get_api_version(uint32_t *api_version)
+{
+    if (!api_version)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *api_version = VDPAU_VERSION;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_get_information_string(char const **information_string)
+{
+    if (!information_string)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *information_string = "Software VDPAU device (" PACKAGE_NAME ")";
+    return VDP_STATUS_OK;
+}
+
+static char const *
+soft_get_error_string(VdpStatus status)
+{
+    switch (status) {
+#define _(STATUS) case VDP_STATUS_##STATUS: return #STATUS
+        _(OK);
+        _(NO_IMPLEMENTATION);
+        _(DISPLAY_PREEMPTED);
+        _(INVALID_HANDLE);
+        _(INVALID_POINTER);
+        _(INVALID_CHROMA_TYPE);
+        _(INVALID_Y_CB_CR_FORMAT);
+        _(INVALID_RGBA_FORMAT);
+        _(INVALID_INDEXED_FORMAT);
+        _(INVALID_COLOR_STANDARD);
+        _(INVALID_COLOR_TABLE_FORMAT);
+        _(INVALID_BLEND_FACTOR);
+        _(INVALID_BLEND_EQUATION);
+        _(INVALID_FLAG);
+        _(INVALID_DECODER_PROFILE);
+        _(INVALID_VIDEO_MIXER_FEATURE);
+        _(INVALID_VIDEO_MIXER_PARAMETER);
+        _(INVALID_VIDEO_MIXER_ATTRIBUTE);
+        _(INVALID_VIDEO_MIXER_PICTURE_STRUCTURE);
+        _(INVALID_FUNC_ID);
+        _(INVALID_SIZE);
+        _(INVALID_VALUE);
+        _(INVALID_STRUCT_VERSION);
+        _(RESOURCES);
+        _(HANDLE_DEVICE_MISMATCH);
+        _(ERROR);
+#undef _
+    }
+    return NULL;
+}
+
+static VdpStatus
+soft_generate_csc_matrix(
+    VdpProcamp         *procamp,
+    VdpColorStandard    standard,
+    VdpCSCMatrix       *csc_matrix
+)
+{
+    float kr, kb, kg, brightness, contrast, saturation, hue;
+    float ys, cs, m[3][3], x, y;
+    const float ybias  = -16.0f / 255.0f;
+    const float cbias  = -128.0f / 255.0f;
+    int i;
+
+    if (!csc_matrix)
+        return VDP_STATUS_INVALID_POINTER;
+
+    switch (standard) {
+    case VDP_COLOR_STANDARD_ITUR_BT_601:
+        kr = 0.299f;  kb = 0.114f;
+        break;
+    case VDP_COLOR_STANDARD_ITUR_BT_709:
+        kr = 0.2126f; kb = 0.0722f;
+        break;
+    case VDP_COLOR_STANDARD_SMPTE_240M:
+        kr = 0.212f;  kb = 0.087f;
+        break;
+    default:
+        return VDP_STATUS_INVALID_COLOR_STANDARD;
+    }
+
+    brightness = 0.0f;
+    contrast   = 1.0f;
+    saturation = 1.0f;
+    hue        = 0.0f;
+    if (procamp) {
+        if (procamp->struct_version > VDP_PROCAMP_VERSION)
+            return VDP_STATUS_INVALID_STRUCT_VERSION;
+        brightness = procamp->brightness;
+        contrast   = procamp->contrast;
+        saturation = procamp->saturation;
+        hue        = procamp->hue;
+    }
+
+    /* Limited range Y'CbCr to full range R'G'B' */
+    kg = 1.0f - kr - kb;
+    ys = 255.0f / 219.0f;
+    cs = 255.0f / 224.0f;
+    m[0][0] = ys; m[0][1] = 0.0f;                          m[0][2] = cs * 2.0f * (1.0f - kr);
+    m[1][0] = ys; m[1][1] = -cs * 2.0f * (1.0f - kb) * kb / kg;
+                                                           m[1][2] = -cs * 2.0f * (1.0f - kr) * kr / kg;
+    m[2][0] = ys; m[2][1] = cs * 2.0f * (1.0f - kb);       m[2][2] = 0.0f;
+
+    /* Apply procamp: contrast scales luma, saturation and hue rotate chroma */
+    x = contrast * saturation * cosf(hue);
+    y = contrast * saturation * sinf(hue);
+    for (i = 0; i < 3; i++) {
+        (*csc_matrix)[i][0] = contrast * m[i][0];
+        (*csc_matrix)[i][1] = m[i][1] * x - m[i][2] * y;
+        (*csc_matrix)[i][2] = m[i][2] * x + m[i][1] * y;
+        (*csc_matrix)[i][3] = m[i][0] * (brightness + contrast * ybias) +
+                              m[i][1] * (x * cbias + y * cbias) +
+                              m[i][2] * (x * cbias - y * cbias);
+    }
+    return VDP_STATUS_OK;
+}
+
+/* ====================================================================== */
+/* === Video surfaces                                                 === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_video_surface_create(
+    VdpDevice           device,
+    VdpChromaType       chroma_type,
+    uint32_t            width,
+    uint32_t            height,
+    VdpVideoSurface    *surface
+)
+{
+    soft_video_surface_p obj_surface;
+    uint32_t chroma_width, chroma_height, luma_size, chroma_size;
+    int id;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!surface)
+        return VDP_STATUS_INVALID_POINTER;
+    if (width == 0 || height == 0 ||
+        width > SOFT_MAX_SURFACE_SIZE || height > SOFT_MAX_SURFACE_SIZE)
+        return VDP_STATUS_INVALID_SIZE;
+
+    switch (chroma_type) {
+    case VDP_CHROMA_TYPE_420:
+        chroma_width  = (width + 1) / 2;
+        chroma_height = (height + 1) / 2;
+        break;
+    case VDP_CHROMA_TYPE_422:
+        chroma_width  = (width + 1) / 2;
+        chroma_height = height;
+        break;
+    case VDP_CHROMA_TYPE_444:
+        chroma_width  = width;
+        chroma_height = height;
+        break;
+    default:
+        return VDP_STATUS_INVALID_CHROMA_TYPE;
+    }
+
+    id = object_heap_allocate(&g_soft_device.video_surface_heap);
+    if (id < 0)
+        return VDP_STATUS_RESOURCES;
+    obj_surface = SOFT_VIDEO_SURFACE(id);
+    if (!obj_surface)
+        return VDP_STATUS_RESOURCES;
+
+    luma_size   = width * height;
+    chroma_size = chroma_width * chroma_height;
+    obj_surface->planes[0] = malloc(luma_size + 2 * chroma_size);
+    if (!obj_surface->planes[0]) {
+        object_heap_free(&g_soft_device.video_surface_heap,
+                         (object_base_p)obj_surface);
+        return VDP_STATUS_RESOURCES;
+    }
+    obj_surface->planes[1]     = obj_surface->planes[0] + luma_size;
+    obj_surface->planes[2]     = obj_surface->planes[1] + chroma_size;
+    obj_surface->chroma_type   = chroma_type;
+    obj_surface->width         = width;
+    obj_surface->height        = height;
+    obj_surface->chroma_width  = chroma_width;
+    obj_surface->chroma_height = chroma_height;
+
+    /* Start out black */
+    memset(obj_surface->planes[0], 16, luma_size);
+    memset(obj_surface->planes[1], 128, 2 * chroma_size);
+
+    *surface = id;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_surface_destroy(VdpVideoSurface surface)
+{
+    soft_video_surface_p const obj_surface = SOFT_VIDEO_SURFACE(surface);
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    destroy_video_surface_cb((object_base_p)obj_surface);
+    object_heap_free(&g_soft_device.video_surface_heap,
+                     (object_base_p)obj_surface);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_surface_query_ycbcr_caps(
+    VdpDevice           device,
+    VdpChromaType       surface_chroma_type,
+    VdpYCbCrFormat      bits_ycbcr_format,
+    VdpBool            *is_supported
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
+
+    switch (surface_chroma_type) {
+    case VDP_CHROMA_TYPE_420:
+        *is_supported = (bits_ycbcr_format == VDP_YCBCR_FORMAT_NV12 ||
+                         bits_ycbcr_format == VDP_YCBCR_FORMAT_YV12);
+        break;
+    case VDP_CHROMA_TYPE_422:
+        *is_supported = (bits_ycbcr_format == VDP_YCBCR_FORMAT_UYVY ||
+                         bits_ycbcr_format == VDP_YCBCR_FORMAT_YUYV);
+        break;
+    case VDP_CHROMA_TYPE_444:
+        *is_supported = (bits_ycbcr_format == VDP_YCBCR_FORMAT_Y8U8V8A8 ||
+                         bits_ycbcr_format == VDP_YCBCR_FORMAT_V8U8Y8A8);
+        break;
+    default:
+        *is_supported = VDP_FALSE;
+        break;
+    }
+    return VDP_STATUS_OK;
+}
+
+static inline void
+copy_plane(
+    uint8_t        *dst,
+    uint32_t        dst_pitch,
+    const uint8_t  *src,
+    uint32_t        src_pitch,
+    uint32_t        width,
+    uint32_t        height
+)
+{
+    uint32_t y;
+
+    for (y = 0; y < height; y++)
+        memcpy(dst + y * dst_pitch, src + y * src_pitch, width);
+}
+
+/* Packed formats are described by the byte offsets of Y (first and
+   second pixel for 4:2:2), Cb and Cr within a group of pixels */
+typedef struct {
+    unsigned int        bytes_per_group;
+    unsigned int        y0, y1, cb, cr;
+} soft_packed_format_t;
+
+static int
+get_packed_format(VdpYCbCrFormat format, soft_packed_format_t *f)
+{
+    switch (format) {
+    case VDP_YCBCR_FORMAT_YUYV:
+        f->bytes_per_group = 4; f->y0 = 0; f->y1 = 2; f->cb = 1; f->cr = 3;
+        return 1;
+    case VDP_YCBCR_FORMAT_UYVY:
+        f->bytes_per_group = 4; f->y0 = 1; f->y1 = 3; f->cb = 0; f->cr = 2;
+        return 1;
+    case VDP_YCBCR_FORMAT_Y8U8V8A8:
+        f->bytes_per_group = 4; f->y0 = 0; f->y1 = 0; f->cb = 1; f->cr = 2;
+        return 1;
+    case VDP_YCBCR_FORMAT_V8U8Y8A8:
+        f->bytes_per_group = 4; f->y0 = 2; f->y1 = 2; f->cb = 1; f->cr = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+is_compatible_ycbcr_format(VdpChromaType chroma_type, VdpYCbCrFormat format)
+{
+    VdpBool is_supported = VDP_FALSE;
+
+    soft_video_surface_query_ycbcr_caps(SOFT_DEVICE_HANDLE, chroma_type,
+                                        format, &is_supported);
+    return is_supported;
+}
+
+static VdpStatus
+soft_video_surface_get_bits_ycbcr(
+    VdpVideoSurface     surface,
+    VdpYCbCrFormat      destination_ycbcr_format,
+    void * const       *destination_data,
+    uint32_t const     *destination_pitches
+)
+{
+    soft_video_surface_p const obj_surface = SOFT_VIDEO_SURFACE(surface);
+    soft_packed_format_t f;
+    uint32_t x, y;
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!destination_data || !destination_pitches)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!is_compatible_ycbcr_format(obj_surface->chroma_type,
+                                    destination_ycbcr_format))
+        return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+
+    const uint32_t cw = obj_surface->chroma_width;
+    const uint32_t ch = obj_surface->chroma_height;
+
+    switch (destination_ycbcr_format) {
+    case VDP_YCBCR_FORMAT_NV12: {
+        copy_plane(destination_data[0], destination_pitches[0],
+                   obj_surface->planes[0], obj_surface->width,
+                   obj_surface->width, obj_surface->height);
+        for (y = 0; y < ch; y++) {
+            uint8_t * const dst = (uint8_t *)destination_data[1] + y * destination_pitches[1];
+            const uint8_t * const cb = obj_surface->planes[1] + y * cw;
+            const uint8_t * const cr = obj_surface->planes[2] + y * cw;
+            for (x = 0; x < cw; x++) {
+                dst[2*x + 0] = cb[x];
+                dst[2*x + 1] = cr[x];
+            }
+        }
+        break;
+    }
+    case VDP_YCBCR_FORMAT_YV12:
+        copy_plane(destination_data[0], destination_pitches[0],
+                   obj_surface->planes[0], obj_surface->width,
+                   obj_surface->width, obj_surface->height);
+        copy_plane(destination_data[1], destination_pitches[1],
+                   obj_surface->planes[2], cw, cw, ch);
+        copy_plane(destination_data[2], destination_pitches[2],
+                   obj_surface->planes[1], cw, cw, ch);
+        break;
+    default:
+        if (!get_packed_format(destination_ycbcr_format, &f))
+            return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+        for (y = 0; y < obj_surface->height; y++) {
+            uint8_t * const dst = (uint8_t *)destination_data[0] + y * destination_pitches[0];
+            const uint8_t * const luma = obj_surface->planes[0] + y * obj_surface->width;
+            const uint8_t * const cb   = obj_surface->planes[1] + y * cw;
+            const uint8_t * const cr   = obj_surface->planes[2] + y * cw;
+            for (x = 0; x < cw; x++) {
+                uint8_t * const group = dst + x * f.bytes_per_group;
+                if (obj_surface->chroma_type == VDP_CHROMA_TYPE_422) {
+                    group[f.y0] = luma[2*x];
+                    group[f.y1] = 2*x + 1 < obj_surface->width ? luma[2*x + 1] : luma[2*x];
+                }
+                else {
+                    group[f.y0] = luma[x];
+                    group[3]    = 0xff;
+                }
+                group[f.cb] = cb[x];
+                group[f.cr] = cr[x];
+            }
+        }
+        break;
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_surface_put_bits_ycbcr(
+    VdpVideoSurface     surface,
+    VdpYCbCrFormat      source_ycbcr_format,
+    void const * const *source_data,
+    uint32_t const     *source_pitches
+)
+{
+    soft_video_surface_p const obj_surface = SOFT_VIDEO_SURFACE(surface);
+    soft_packed_format_t f;
+    uint32_t x, y;
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!source_data || !source_pitches)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!is_compatible_ycbcr_format(obj_surface->chroma_type,
+                                    source_ycbcr_format))
+        return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+
+    const uint32_t cw = obj_surface->chroma_width;
+    const uint32_t ch = obj_surface->chroma_height;
+
+    switch (source_ycbcr_format) {
+    case VDP_YCBCR_FORMAT_NV12:
+        copy_plane(obj_surface->planes[0], obj_surface->width,
+                   source_data[0], source_pitches[0],
+                   obj_surface->width, obj_surface->height);
+        for (y = 0; y < ch; y++) {
+            const uint8_t * const src = (const uint8_t *)source_data[1] + y * source_pitches[1];
+            uint8_t * const cb = obj_surface->planes[1] + y * cw;
+            uint8_t * const cr = obj_surface->planes[2] + y * cw;
+            for (x = 0; x < cw; x++) {
+                cb[x] = src[2*x + 0];
+                cr[x] = src[2*x + 1];
+            }
+        }
+        break;
+    case VDP_YCBCR_FORMAT_YV12:
+        copy_plane(obj_surface->planes[0], obj_surface->width,
+                   source_data[0], source_pitches[0],
+                   obj_surface->width, obj_surface->height);
+        copy_plane(obj_surface->planes[2], cw,
+                   source_data[1], source_pitches[1], cw, ch);
+        copy_plane(obj_surface->planes[1], cw,
+                   source_data[2], source_pitches[2], cw, ch);
+        break;
+    default:
+        if (!get_packed_format(source_ycbcr_format, &f))
+            return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+        for (y = 0; y < obj_surface->height; y++) {
+            const uint8_t * const src = (const uint8_t *)source_data[0] + y * source_pitches[0];
+            uint8_t * const luma = obj_surface->planes[0] + y * obj_surface->width;
+            uint8_t * const cb   = obj_surface->planes[1] + y * cw;
+            uint8_t * const cr   = obj_surface->planes[2] + y * cw;
+            for (x = 0; x < cw; x++) {
+                const uint8_t * const group = src + x * f.bytes_per_group;
+                if (obj_surface->chroma_type == VDP_CHROMA_TYPE_422) {
+                    luma[2*x] = group[f.y0];
+                    if (2*x + 1 < obj_surface->width)
+                        luma[2*x + 1] = group[f.y1];
+                }
+                else
+                    luma[x] = group[f.y0];
+                cb[x] = group[f.cb];
+                cr[x] = group[f.cr];
+            }
+        }
+        break;
+    }
+    return VDP_STATUS_OK;
+}
+
+/* ====================================================================== */
+/* === Output and bitmap surfaces                                     === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_output_surface_create(
+    VdpDevice           device,
+    VdpRGBAFormat       rgba_format,
+    uint32_t            width,
+    uint32_t            height,
+    VdpOutputSurface   *surface
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!surface)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!is_valid_rgba_format(rgba_format))
+        return VDP_STATUS_INVALID_RGBA_FORMAT;
+    if (width == 0 || height == 0 ||
+        width > SOFT_MAX_SURFACE_SIZE || height > SOFT_MAX_SURFACE_SIZE)
+        return VDP_STATUS_INVALID_SIZE;
+
+    if (!create_rgba_surface(&g_soft_device.output_surface_heap,
+                             rgba_format, width, height, surface))
+        return VDP_STATUS_RESOURCES;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_destroy(VdpOutputSurface surface)
+{
+    soft_output_surface_p const obj_surface = SOFT_OUTPUT_SURFACE(surface);
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    destroy_rgba_surface(&g_soft_device.output_surface_heap, obj_surface);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_query_rgba_caps(
+    VdpDevice           device,
+    VdpRGBAFormat       surface_rgba_format,
+    VdpBool            *is_supported
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *is_supported = is_valid_rgba_format(surface_rgba_format);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_get_bits_native(
+    VdpOutputSurface    surface,
+    VdpRect const      *source_rect,
+    void * const       *destination_data,
+    uint32_t const     *destination_pitches
+)
+{
+    soft_output_surface_p const obj_surface = SOFT_OUTPUT_SURFACE(surface);
+    VdpRect rect;
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!destination_data || !destination_pitches)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!get_rect(source_rect, obj_surface->width, obj_surface->height, &rect))
+        return VDP_STATUS_INVALID_SIZE;
+
+    copy_plane(destination_data[0], destination_pitches[0],
+               obj_surface->pixels + 4 * (rect.y0 * obj_surface->width + rect.x0),
+               4 * obj_surface->width,
+               4 * (rect.x1 - rect.x0), rect.y1 - rect.y0);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+put_bits_native(
+    soft_rgba_surface_t *obj_surface,
+    void const * const  *source_data,
+    uint32_t const      *source_pitches,
+    VdpRect const       *destination_rect
+)
+{
+    VdpRect rect;
+
+    if (!source_data || !source_pitches)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!get_rect(destination_rect, obj_surface->width, obj_surface->height, &rect))
+        return VDP_STATUS_INVALID_SIZE;
+
+    copy_plane(obj_surface->pixels + 4 * (rect.y0 * obj_surface->width + rect.x0),
+               4 * obj_surface->width,
+               source_data[0], source_pitches[0],
+               4 * (rect.x1 - rect.x0), rect.y1 - rect.y0);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_put_bits_native(
+    VdpOutputSurface    surface,
+    void const * const *source_data,
+    uint32_t const     *source_pitches,
+    VdpRect const      *destination_rect
+)
+{
+    soft_output_surface_p const obj_surface = SOFT_OUTPUT_SURFACE(surface);
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    return put_bits_native(obj_surface, source_data, source_pitches,
+                           destination_rect);
+}
+
+static VdpStatus
+soft_output_surface_query_put_bits_indexed_capabilities(
+    VdpDevice           device,
+    VdpRGBAFormat       surface_rgba_format,
+    VdpIndexedFormat    bits_indexed_format,
+    VdpColorTableFormat color_table_format,
+    VdpBool            *is_supported
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *is_supported = (is_valid_rgba_format(surface_rgba_format) &&
+                     color_table_format == VDP_COLOR_TABLE_FORMAT_B8G8R8X8 &&
+                     (bits_indexed_format == VDP_INDEXED_FORMAT_A4I4 ||
+                      bits_indexed_format == VDP_INDEXED_FORMAT_I4A4 ||
+                      bits_indexed_format == VDP_INDEXED_FORMAT_A8I8 ||
+                      bits_indexed_format == VDP_INDEXED_FORMAT_I8A8));
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_put_bits_indexed(
+    VdpOutputSurface    surface,
+    VdpIndexedFormat    source_indexed_format,
+    void const * const *source_data,
+    uint32_t const     *source_pitch,
+    VdpRect const      *destination_rect,
+    VdpColorTableFormat color_table_format,
+    void const         *color_table
+)
+{
+    soft_output_surface_p const obj_surface = SOFT_OUTPUT_SURFACE(surface);
+    const uint8_t *color_entry;
+    unsigned int index, alpha;
+    soft_pixel_t p;
+    VdpRect rect;
+    uint32_t x, y;
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!source_data || !source_pitch || !color_table)
+        return VDP_STATUS_INVALID_POINTER;
+    if (color_table_format != VDP_COLOR_TABLE_FORMAT_B8G8R8X8)
+        return VDP_STATUS_INVALID_COLOR_TABLE_FORMAT;
+    if (!get_rect(destination_rect, obj_surface->width, obj_surface->height, &rect))
+        return VDP_STATUS_INVALID_SIZE;
+
+    for (y = 0; y < rect.y1 - rect.y0; y++) {
+        const uint8_t * const src = (const uint8_t *)source_data[0] + y * source_pitch[0];
+        for (x = 0; x < rect.x1 - rect.x0; x++) {
+            /* Components are named in memory order, MSB first */
+            switch (source_indexed_format) {
+            case VDP_INDEXED_FORMAT_A4I4:
+                alpha = (src[x] >> 4) * 17;
+                index = src[x] & 0x0f;
+                break;
+            case VDP_INDEXED_FORMAT_I4A4:
+                index = src[x] >> 4;
+                alpha = (src[x] & 0x0f) * 17;
+                break;
+            case VDP_INDEXED_FORMAT_A8I8:
+                alpha = src[2*x + 0];
+                index = src[2*x + 1];
+                break;
+            case VDP_INDEXED_FORMAT_I8A8:
+                index = src[2*x + 0];
+                alpha = src[2*x + 1];
+                break;
+            default:
+                return VDP_STATUS_INVALID_INDEXED_FORMAT;
+            }
+            color_entry = (const uint8_t *)color_table + 4 * index;
+            p.b = color_entry[0] / 255.0f;
+            p.g = color_entry[1] / 255.0f;
+            p.r = color_entry[2] / 255.0f;
+            p.a = alpha / 255.0f;
+            put_pixel(obj_surface, rect.x0 + x, rect.y0 + y, &p);
+        }
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+render_surface(
+    VdpOutputSurface                        destination_surface,
+    VdpRect const                          *destination_rect,
+    soft_rgba_surface_t                    *src,
+    VdpRect const                          *source_rect,
+    VdpColor const                         *colors,
+    VdpOutputSurfaceRenderBlendState const *blend_state
+)
+{
+    soft_output_surface_p const dst = SOFT_OUTPUT_SURFACE(destination_surface);
+    VdpRect dst_rect, src_rect;
+
+    if (!dst)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (blend_state &&
+        blend_state->struct_version > VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION)
+        return VDP_STATUS_INVALID_STRUCT_VERSION;
+    if (!get_rect(destination_rect, dst->width, dst->height, &dst_rect))
+        return VDP_STATUS_INVALID_SIZE;
+    if (src && !get_rect(source_rect, src->width, src->height, &src_rect))
+        return VDP_STATUS_INVALID_SIZE;
+
+    /* XXX: rotation flags and per-vertex colors are not supported,
+       colors[0] modulates the whole source */
+    render_rgba_surface(dst, &dst_rect, src, &src_rect, colors, blend_state);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_output_surface_render_output_surface(
+    VdpOutputSurface                        destination_surface,
+    VdpRect const                          *destination_rect,
+    VdpOutputSurface                        source_surface,
+    VdpRect const                          *source_rect,
+    VdpColor const                         *colors,
+    VdpOutputSurfaceRenderBlendState const *blend_state,
+    uint32_t                                flags
+)
+{
+    soft_output_surface_p src = NULL;
+
+    if (source_surface != VDP_INVALID_HANDLE) {
+        src = SOFT_OUTPUT_SURFACE(source_surface);
+        if (!src)
+            return VDP_STATUS_INVALID_HANDLE;
+    }
+    return render_surface(destination_surface, destination_rect,
+                          src, source_rect, colors, blend_state);
+}
+
+static VdpStatus
+soft_output_surface_render_bitmap_surface(
+    VdpOutputSurface                        destination_surface,
+    VdpRect const                          *destination_rect,
+    VdpBitmapSurface                        source_surface,
+    VdpRect const                          *source_rect,
+    VdpColor const                         *colors,
+    VdpOutputSurfaceRenderBlendState const *blend_state,
+    uint32_t                                flags
+)
+{
+    soft_bitmap_surface_p src = NULL;
+
+    if (source_surface != VDP_INVALID_HANDLE) {
+        src = SOFT_BITMAP_SURFACE(source_surface);
+        if (!src)
+            return VDP_STATUS_INVALID_HANDLE;
+    }
+    return render_surface(destination_surface, destination_rect,
+                          src, source_rect, colors, blend_state);
+}
+
+static VdpStatus
+soft_bitmap_surface_query_capabilities(
+    VdpDevice           device,
+    VdpRGBAFormat       surface_rgba_format,
+    VdpBool            *is_supported,
+    uint32_t           *max_width,
+    uint32_t           *max_height
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported || !max_width || !max_height)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *is_supported = is_valid_rgba_format(surface_rgba_format);
+    *max_width    = SOFT_MAX_SURFACE_SIZE;
+    *max_height   = SOFT_MAX_SURFACE_SIZE;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_bitmap_surface_create(
+    VdpDevice           device,
+    VdpRGBAFormat       rgba_format,
+    uint32_t            width,
+    uint32_t            height,
+    VdpBool             frequently_accessed,
+    VdpBitmapSurface   *surface
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!surface)
+        return VDP_STATUS_INVALID_POINTER;
+    if (!is_valid_rgba_format(rgba_format))
+        return VDP_STATUS_INVALID_RGBA_FORMAT;
+    if (width == 0 || height == 0 ||
+        width > SOFT_MAX_SURFACE_SIZE || height > SOFT_MAX_SURFACE_SIZE)
+        return VDP_STATUS_INVALID_SIZE;
+
+    if (!create_rgba_surface(&g_soft_device.bitmap_surface_heap,
+                             rgba_format, width, height, surface))
+        return VDP_STATUS_RESOURCES;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_bitmap_surface_destroy(VdpBitmapSurface surface)
+{
+    soft_bitmap_surface_p const obj_surface = SOFT_BITMAP_SURFACE(surface);
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    destroy_rgba_surface(&g_soft_device.bitmap_surface_heap, obj_surface);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_bitmap_surface_put_bits_native(
+    VdpBitmapSurface    surface,
+    void const * const *source_data,
+    uint32_t const     *source_pitches,
+    VdpRect const      *destination_rect
+)
+{
+    soft_bitmap_surface_p const obj_surface = SOFT_BITMAP_SURFACE(surface);
+
+    if (!obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    return put_bits_native(obj_surface, source_data, source_pitches,
+                           destination_rect);
+}
+
+/* ====================================================================== */
+/* === Video mixer                                                    === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_video_mixer_query_feature_support(
+    VdpDevice            device,
+    VdpVideoMixerFeature feature,
+    VdpBool             *is_supported
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
+
+    /* Deinterlacing, noise reduction, sharpening, etc. are not implemented */
+    *is_supported = VDP_FALSE;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_query_attribute_support(
+    VdpDevice              device,
+    VdpVideoMixerAttribute attribute,
+    VdpBool               *is_supported
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *is_supported = (attribute == VDP_VIDEO_MIXER_ATTRIBUTE_BACKGROUND_COLOR ||
+                     attribute == VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_set_feature_enables(
+    VdpVideoMixer               mixer,
+    uint32_t                    feature_count,
+    VdpVideoMixerFeature const *features,
+    VdpBool const              *feature_enables
+)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+    unsigned int i, j;
+
+    if (!obj_mixer)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (feature_count > 0 && (!features || !feature_enables))
+        return VDP_STATUS_INVALID_POINTER;
+
+    for (i = 0; i < feature_count; i++) {
+        for (j = 0; j < obj_mixer->num_features; j++) {
+            if (obj_mixer->features[j] == features[i])
+                break;
+        }
+        if (j == obj_mixer->num_features)
+            return VDP_STATUS_INVALID_VIDEO_MIXER_FEATURE;
+        obj_mixer->feature_enables[j] = feature_enables[i];
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_get_feature_enables(
+    VdpVideoMixer               mixer,
+    uint32_t                    feature_count,
+    VdpVideoMixerFeature const *features,
+    VdpBool                    *feature_enables
+)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+    unsigned int i, j;
+
+    if (!obj_mixer)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (feature_count > 0 && (!features || !feature_enables))
+        return VDP_STATUS_INVALID_POINTER;
+
+    for (i = 0; i < feature_count; i++) {
+        for (j = 0; j < obj_mixer->num_features; j++) {
+            if (obj_mixer->features[j] == features[i])
+                break;
+        }
+        if (j == obj_mixer->num_features)
+            return VDP_STATUS_INVALID_VIDEO_MIXER_FEATURE;
+        feature_enables[i] = obj_mixer->feature_enables[j];
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_set_attribute_values(
+    VdpVideoMixer                 mixer,
+    uint32_t                      attribute_count,
+    VdpVideoMixerAttribute const *attributes,
+    void const * const           *attribute_values
+)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+    unsigned int i;
+
+    if (!obj_mixer)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (attribute_count > 0 && (!attributes || !attribute_values))
+        return VDP_STATUS_INVALID_POINTER;
+
+    for (i = 0; i < attribute_count; i++) {
+        switch (attributes[i]) {
+        case VDP_VIDEO_MIXER_ATTRIBUTE_BACKGROUND_COLOR:
+            if (!attribute_values[i])
+                return VDP_STATUS_INVALID_POINTER;
+            obj_mixer->background_color = *(const VdpColor *)attribute_values[i];
+            break;
+        case VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX:
+            if (attribute_values[i])
+                memcpy(obj_mixer->csc_matrix, attribute_values[i],
+                       sizeof(obj_mixer->csc_matrix));
+            else
+                soft_generate_csc_matrix(NULL, VDP_COLOR_STANDARD_ITUR_BT_601,
+                                         &obj_mixer->csc_matrix);
+            break;
+        default:
+            return VDP_STATUS_INVALID_VIDEO_MIXER_ATTRIBUTE;
+        }
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_get_attribute_values(
+    VdpVideoMixer                 mixer,
+    uint32_t                      attribute_count,
+    VdpVideoMixerAttribute const *attributes,
+    void * const                 *attribute_values
+)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+    unsigned int i;
+
+    if (!obj_mixer)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (attribute_count > 0 && (!attributes || !attribute_values))
+        return VDP_STATUS_INVALID_POINTER;
+
+    for (i = 0; i < attribute_count; i++) {
+        if (!attribute_values[i])
+            return VDP_STATUS_INVALID_POINTER;
+        switch (attributes[i]) {
+        case VDP_VIDEO_MIXER_ATTRIBUTE_BACKGROUND_COLOR:
+            *(VdpColor *)attribute_values[i] = obj_mixer->background_color;
+            break;
+        case VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX:
+            memcpy(attribute_values[i], obj_mixer->csc_matrix,
+                   sizeof(obj_mixer->csc_matrix));
+            break;
+        default:
+            return VDP_STATUS_INVALID_VIDEO_MIXER_ATTRIBUTE;
+        }
+    }
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_create(
+    VdpDevice                     device,
+    uint32_t                      feature_count,
+    VdpVideoMixerFeature const   *features,
+    uint32_t                      parameter_count,
+    VdpVideoMixerParameter const *parameters,
+    void const * const           *parameter_values,
+    VdpVideoMixer                *mixer
+)
+{
+    soft_mixer_p obj_mixer;
+    unsigned int i;
+    int id;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!mixer)
+        return VDP_STATUS_INVALID_POINTER;
+    if (feature_count > 0 && !features)
+        return VDP_STATUS_INVALID_POINTER;
+    if (parameter_count > 0 && (!parameters || !parameter_values))
+        return VDP_STATUS_INVALID_POINTER;
+    if (feature_count > SOFT_MAX_MIXER_FEATURES)
+        return VDP_STATUS_RESOURCES;
+
+    id = object_heap_allocate(&g_soft_device.mixer_heap);
+    if (id < 0)
+        return VDP_STATUS_RESOURCES;
+    obj_mixer = SOFT_MIXER(id);
+    if (!obj_mixer)
+        return VDP_STATUS_RESOURCES;
+
+    obj_mixer->width        = 0;
+    obj_mixer->height       = 0;
+    obj_mixer->chroma_type  = VDP_CHROMA_TYPE_420;
+    obj_mixer->num_features = feature_count;
+    for (i = 0; i < feature_count; i++) {
+        obj_mixer->features[i]        = features[i];
+        obj_mixer->feature_enables[i] = VDP_FALSE;
+    }
+    obj_mixer->background_color.red   = 0.0f;
+    obj_mixer->background_color.green = 0.0f;
+    obj_mixer->background_color.blue  = 0.0f;
+    obj_mixer->background_color.alpha = 1.0f;
+    soft_generate_csc_matrix(NULL, VDP_COLOR_STANDARD_ITUR_BT_601,
+                             &obj_mixer->csc_matrix);
+
+    for (i = 0; i < parameter_count; i++) {
+        const void * const value = parameter_values[i];
+        if (!value)
+            continue;
+        switch (parameters[i]) {
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH:
+            obj_mixer->width = *(const uint32_t *)value;
+            break;
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT:
+            obj_mixer->height = *(const uint32_t *)value;
+            break;
+        case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE:
+            obj_mixer->chroma_type = *(const VdpChromaType *)value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    *mixer = id;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_video_mixer_destroy(VdpVideoMixer mixer)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+
+    if (!obj_mixer)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    object_heap_free(&g_soft_device.mixer_heap, (object_base_p)obj_mixer);
+    return VDP_STATUS_OK;
+}
+
+// Convert video surface pixels in SRC_RECT to RGB into DST_RECT of DST
+static void
+mixer_render_video(
+    soft_mixer_p                    obj_mixer,
+    soft_video_surface_p            src,
+    const VdpRect                  *src_rect,
+    VdpVideoMixerPictureStructure   picture_structure,
+    soft_rgba_surface_t            *dst,
+    const VdpRect                  *dst_rect,
+    const VdpRect                  *clip_rect
+)
+{
+    const float (* const m)[4] = (const float (*)[4])obj_mixer->csc_matrix;
+    const uint32_t dst_w = dst_rect->x1 - dst_rect->x0;
+    const uint32_t dst_h = dst_rect->y1 - dst_rect->y0;
+    const uint32_t src_w = src_rect->x1 - src_rect->x0;
+    const uint32_t src_h = src_rect->y1 - src_rect->y0;
+    const unsigned int chroma_shift_x = src->chroma_type != VDP_CHROMA_TYPE_444;
+    const unsigned int chroma_shift_y = src->chroma_type == VDP_CHROMA_TYPE_420;
+    uint32_t x, y, sx, sy, cx, cy;
+    float Y, Cb, Cr;
+    soft_pixel_t p;
+
+    if (dst_w == 0 || dst_h == 0 || src_w == 0 || src_h == 0)
+        return;
+
+    for (y = 0; y < dst_h; y++) {
+        if (dst_rect->y0 + y < clip_rect->y0 || dst_rect->y0 + y >= clip_rect->y1)
+            continue;
+        sy = src_rect->y0 + y * src_h / dst_h;
+        switch (picture_structure) {
+        case VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD:
+            sy &= ~1U;
+            break;
+        case VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD:
+            sy |= 1;
+            if (sy >= src->height)
+                sy -= 2;
+            break;
+        default:
+            break;
+        }
+        cy = sy >> chroma_shift_y;
+        for (x = 0; x < dst_w; x++) {
+            if (dst_rect->x0 + x < clip_rect->x0 || dst_rect->x0 + x >= clip_rect->x1)
+                continue;
+            sx = src_rect->x0 + x * src_w / dst_w;
+            cx = sx >> chroma_shift_x;
+            Y  = src->planes[0][sy * src->width + sx] / 255.0f;
+            Cb = src->planes[1][cy * src->chroma_width + cx] / 255.0f;
+            Cr = src->planes[2][cy * src->chroma_width + cx] / 255.0f;
+            p.r = m[0][0] * Y + m[0][1] * Cb + m[0][2] * Cr + m[0][3];
+            p.g = m[1][0] * Y + m[1][1] * Cb + m[1][2] * Cr + m[1][3];
+            p.b = m[2][0] * Y + m[2][1] * Cb + m[2][2] * Cr + m[2][3];
+            p.a = 1.0f;
+            put_pixel(dst, dst_rect->x0 + x, dst_rect->y0 + y, &p);
+        }
+    }
+}
+
+static VdpStatus
+soft_video_mixer_render(
+    VdpVideoMixer                 mixer,
+    VdpOutputSurface              background_surface,
+    VdpRect const                *background_source_rect,
+    VdpVideoMixerPictureStructure current_picture_structure,
+    uint32_t                      video_surface_past_count,
+    VdpVideoSurface const        *video_surface_past,
+    VdpVideoSurface               video_surface_current,
+    uint32_t                      video_surface_future_count,
+    VdpVideoSurface const        *video_surface_future,
+    VdpRect const                *video_source_rect,
+    VdpOutputSurface              destination_surface,
+    VdpRect const                *destination_rect,
+    VdpRect const                *destination_video_rect,
+    uint32_t                      layer_count,
+    VdpLayer const               *layers
+)
+{
+    soft_mixer_p const obj_mixer = SOFT_MIXER(mixer);
+    soft_video_surface_p const src = SOFT_VIDEO_SURFACE(video_surface_current);
+    soft_output_surface_p const dst = SOFT_OUTPUT_SURFACE(destination_surface);
+    soft_output_surface_p bg = NULL;
+    VdpRect dst_rect, dst_video_rect, src_rect, bg_rect;
+    unsigned int i;
+
+    if (!obj_mixer || !src || !dst)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (layer_count > 0 && !layers)
+        return VDP_STATUS_INVALID_POINTER;
+    if (current_picture_structure != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD &&
+        current_picture_structure != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD &&
+        current_picture_structure != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME)
+        return VDP_STATUS_INVALID_VIDEO_MIXER_PICTURE_STRUCTURE;
+
+    if (background_surface != VDP_INVALID_HANDLE) {
+        bg = SOFT_OUTPUT_SURFACE(background_surface);
+        if (!bg)
+            return VDP_STATUS_INVALID_HANDLE;
+        if (!get_rect(background_source_rect, bg->width, bg->height, &bg_rect))
+            return VDP_STATUS_INVALID_SIZE;
+    }
+    if (!get_rect(destination_rect, dst->width, dst->height, &dst_rect))
+        return VDP_STATUS_INVALID_SIZE;
+    if (!get_rect(video_source_rect, src->width, src->height, &src_rect))
+        return VDP_STATUS_INVALID_SIZE;
+    if (destination_video_rect)
+        dst_video_rect = *destination_video_rect;
+    else
+        dst_video_rect = dst_rect;
+
+    /* Background: either the background surface or the mixer color */
+    if (bg)
+        render_rgba_surface(dst, &dst_rect, bg, &bg_rect, NULL, NULL);
+    else
+        fill_rect(dst, &dst_rect, &obj_mixer->background_color);
+
+    /* Video, clipped to the destination rectangle */
+    mixer_render_video(obj_mixer, src, &src_rect, current_picture_structure,
+                       dst, &dst_video_rect, &dst_rect);
+
+    /* Layers are blended on top with straight alpha */
+    static const VdpOutputSurfaceRenderBlendState blend_state = {
+        .struct_version                 = VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+        .blend_factor_source_color      = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA,
+        .blend_factor_destination_color = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .blend_factor_source_alpha      = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_destination_alpha = VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .blend_equation_color           = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_equation_alpha           = VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+    };
+    for (i = 0; i < layer_count; i++) {
+        soft_output_surface_p const layer = SOFT_OUTPUT_SURFACE(layers[i].source_surface);
+        VdpRect layer_src_rect, layer_dst_rect;
+
+        if (!layer)
+            return VDP_STATUS_INVALID_HANDLE;
+        if (!get_rect(layers[i].source_rect, layer->width, layer->height, &layer_src_rect) ||
+            !get_rect(layers[i].destination_rect, dst->width, dst->height, &layer_dst_rect))
+            return VDP_STATUS_INVALID_SIZE;
+        render_rgba_surface(dst, &layer_dst_rect, layer, &layer_src_rect,
+                            NULL, &blend_state);
+    }
+    return VDP_STATUS_OK;
+}
+
+/* ====================================================================== */
+/* === Presentation queue                                             === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_presentation_queue_target_create_x11(
+    VdpDevice                   device,
+    Drawable                    drawable,
+    VdpPresentationQueueTarget *target
+)
+{
+    soft_queue_target_p obj_target;
+    int id;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!target)
+        return VDP_STATUS_INVALID_POINTER;
+
+    id = object_heap_allocate(&g_soft_device.queue_target_heap);
+    if (id < 0)
+        return VDP_STATUS_RESOURCES;
+    obj_target = SOFT_QUEUE_TARGET(id);
+    if (!obj_target)
+        return VDP_STATUS_RESOURCES;
+
+    obj_target->drawable = drawable;
+    *target = id;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_target_destroy(VdpPresentationQueueTarget target)
+{
+    soft_queue_target_p const obj_target = SOFT_QUEUE_TARGET(target);
+
+    if (!obj_target)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    object_heap_free(&g_soft_device.queue_target_heap, (object_base_p)obj_target);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_create(
+    VdpDevice                   device,
+    VdpPresentationQueueTarget  target,
+    VdpPresentationQueue       *queue
+)
+{
+    soft_queue_p obj_queue;
+    int id;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!SOFT_QUEUE_TARGET(target))
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!queue)
+        return VDP_STATUS_INVALID_POINTER;
+
+    id = object_heap_allocate(&g_soft_device.queue_heap);
+    if (id < 0)
+        return VDP_STATUS_RESOURCES;
+    obj_queue = SOFT_QUEUE(id);
+    if (!obj_queue)
+        return VDP_STATUS_RESOURCES;
+
+    obj_queue->target                 = target;
+    obj_queue->background_color.red   = 0.0f;
+    obj_queue->background_color.green = 0.0f;
+    obj_queue->background_color.blue  = 0.0f;
+    obj_queue->background_color.alpha = 1.0f;
+    obj_queue->epoch                  = soft_get_time();
+    obj_queue->num_entries            = 0;
+    pthread_mutex_init(&obj_queue->lock, NULL);
+    pthread_cond_init(&obj_queue->cond, NULL);
+
+    *queue = id;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_destroy(VdpPresentationQueue queue)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    destroy_queue_cb((object_base_p)obj_queue);
+    object_heap_free(&g_soft_device.queue_heap, (object_base_p)obj_queue);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_set_background_color(
+    VdpPresentationQueue        queue,
+    VdpColor * const            background_color
+)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!background_color)
+        return VDP_STATUS_INVALID_POINTER;
+
+    obj_queue->background_color = *background_color;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_get_background_color(
+    VdpPresentationQueue        queue,
+    VdpColor                   *background_color
+)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!background_color)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *background_color = obj_queue->background_color;
+    return VDP_STATUS_OK;
+}
+
+static inline soft_queue_entry_t *
+queue_entry(soft_queue_p obj_queue, unsigned int n)
+{
+    return &obj_queue->entries[n % SOFT_QUEUE_DEPTH];
+}
+
+// Find the sequence number of the last display of SURFACE, 0 if none
+static unsigned int
+queue_find_surface(soft_queue_p obj_queue, VdpOutputSurface surface)
+{
+    unsigned int n, first;
+
+    first = obj_queue->num_entries > SOFT_QUEUE_DEPTH ?
+        obj_queue->num_entries - SOFT_QUEUE_DEPTH : 0;
+    for (n = obj_queue->num_entries; n > first; n--) {
+        if (queue_entry(obj_queue, n - 1)->surface == surface)
+            return n;
+    }
+    return 0;
+}
+
+static VdpStatus
+soft_presentation_queue_display(
+    VdpPresentationQueue        queue,
+    VdpOutputSurface            surface,
+    uint32_t                    clip_width,
+    uint32_t                    clip_height,
+    VdpTime                     earliest_presentation_time
+)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+    soft_queue_entry_t *entry;
+    VdpTime t;
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!SOFT_OUTPUT_SURFACE(surface))
+        return VDP_STATUS_INVALID_HANDLE;
+
+    pthread_mutex_lock(&obj_queue->lock);
+
+    /* Surfaces flip on the next simulated retrace that is not before the
+       requested time, and at most once per retrace */
+    t = soft_get_time();
+    if (t < earliest_presentation_time)
+        t = earliest_presentation_time;
+    if (obj_queue->num_entries > 0) {
+        const VdpTime next_vsync =
+            queue_entry(obj_queue, obj_queue->num_entries - 1)->time + SOFT_VSYNC_PERIOD;
+        if (t < next_vsync)
+            t = next_vsync;
+    }
+    t = obj_queue->epoch +
+        ((t - obj_queue->epoch + SOFT_VSYNC_PERIOD - 1) / SOFT_VSYNC_PERIOD) * SOFT_VSYNC_PERIOD;
+
+    entry = queue_entry(obj_queue, obj_queue->num_entries++);
+    entry->surface = surface;
+    entry->time    = t;
+
+    pthread_cond_broadcast(&obj_queue->cond);
+    pthread_mutex_unlock(&obj_queue->lock);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_block_until_surface_idle(
+    VdpPresentationQueue        queue,
+    VdpOutputSurface            surface,
+    VdpTime                    *first_presentation_time
+)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+    unsigned int n;
+    struct timespec ts;
+    VdpTime now, idle_time;
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!first_presentation_time)
+        return VDP_STATUS_INVALID_POINTER;
+
+    pthread_mutex_lock(&obj_queue->lock);
+    n = queue_find_surface(obj_queue, surface);
+    if (n == 0) {
+        *first_presentation_time = 0;
+        pthread_mutex_unlock(&obj_queue->lock);
+        return VDP_STATUS_OK;
+    }
+    *first_presentation_time = queue_entry(obj_queue, n - 1)->time;
+
+    /* The surface turns idle once the next displayed surface is visible */
+    for (;;) {
+        if (obj_queue->num_entries <= n) {
+            pthread_cond_wait(&obj_queue->cond, &obj_queue->lock);
+            continue;
+        }
+        if (obj_queue->num_entries - n > SOFT_QUEUE_DEPTH)
+            break;  /* long since replaced */
+        idle_time = queue_entry(obj_queue, n)->time;
+        now = soft_get_time();
+        if (now >= idle_time)
+            break;
+        ts.tv_sec  = idle_time / 1000000000;
+        ts.tv_nsec = idle_time % 1000000000;
+        pthread_cond_timedwait(&obj_queue->cond, &obj_queue->lock, &ts);
+    }
+    pthread_mutex_unlock(&obj_queue->lock);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_presentation_queue_query_surface_status(
+    VdpPresentationQueue        queue,
+    VdpOutputSurface            surface,
+    VdpPresentationQueueStatus *status,
+    VdpTime                    *first_presentation_time
+)
+{
+    soft_queue_p const obj_queue = SOFT_QUEUE(queue);
+    unsigned int n;
+    VdpTime now, t;
+
+    if (!obj_queue)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!status || !first_presentation_time)
+        return VDP_STATUS_INVALID_POINTER;
+
+    pthread_mutex_lock(&obj_queue->lock);
+    *status = VDP_PRESENTATION_QUEUE_STATUS_IDLE;
+    *first_presentation_time = 0;
+    n = queue_find_surface(obj_queue, surface);
+    if (n > 0) {
+        now = soft_get_time();
+        t   = queue_entry(obj_queue, n - 1)->time;
+        if (now < t)
+            *status = VDP_PRESENTATION_QUEUE_STATUS_QUEUED;
+        else {
+            *first_presentation_time = t;
+            if (obj_queue->num_entries == n ||
+                now < queue_entry(obj_queue, n)->time)
+                *status = VDP_PRESENTATION_QUEUE_STATUS_VISIBLE;
+        }
+    }
+    pthread_mutex_unlock(&obj_queue->lock);
+    return VDP_STATUS_OK;
+}
+
+/* ====================================================================== */
+/* === Decoder                                                        === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_decoder_query_capabilities(
+    VdpDevice           device,
+    VdpDecoderProfile   profile,
+    VdpBool            *is_supported,
+    uint32_t           *max_level,
+    uint32_t           *max_macroblocks,
+    uint32_t           *max_width,
+    uint32_t           *max_height
+)
+{
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!is_supported || !max_level || !max_macroblocks ||
+        !max_width || !max_height)
+        return VDP_STATUS_INVALID_POINTER;
+
+    *is_supported    = get_VdpCodec(profile) != 0;
+    *max_level       = 51;
+    *max_width       = SOFT_MAX_DECODER_SIZE;
+    *max_height      = SOFT_MAX_DECODER_SIZE;
+    *max_macroblocks = (SOFT_MAX_DECODER_SIZE / 16) * (SOFT_MAX_DECODER_SIZE / 16);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_decoder_create(
+    VdpDevice           device,
+    VdpDecoderProfile   profile,
+    uint32_t            width,
+    uint32_t            height,
+    uint32_t            max_references,
+    VdpDecoder         *decoder
+)
+{
+    soft_decoder_p obj_decoder;
+    int id;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!decoder)
+        return VDP_STATUS_INVALID_POINTER;
+    if (get_VdpCodec(profile) == 0)
+        return VDP_STATUS_INVALID_DECODER_PROFILE;
+    if (width == 0 || height == 0 ||
+        width > SOFT_MAX_DECODER_SIZE || height > SOFT_MAX_DECODER_SIZE)
+        return VDP_STATUS_INVALID_SIZE;
+
+    id = object_heap_allocate(&g_soft_device.decoder_heap);
+    if (id < 0)
+        return VDP_STATUS_RESOURCES;
+    obj_decoder = SOFT_DECODER(id);
+    if (!obj_decoder)
+        return VDP_STATUS_RESOURCES;
+
+    obj_decoder->profile        = profile;
+    obj_decoder->width          = width;
+    obj_decoder->height         = height;
+    obj_decoder->max_references = max_references;
+
+    *decoder = id;
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_decoder_destroy(VdpDecoder decoder)
+{
+    soft_decoder_p const obj_decoder = SOFT_DECODER(decoder);
+
+    if (!obj_decoder)
+        return VDP_STATUS_INVALID_HANDLE;
+
+    object_heap_free(&g_soft_device.decoder_heap, (object_base_p)obj_decoder);
+    return VDP_STATUS_OK;
+}
+
+static VdpStatus
+soft_decoder_render(
+    VdpDecoder                  decoder,
+    VdpVideoSurface             target,
+    VdpPictureInfo const       *picture_info,
+    uint32_t                    bitstream_buffer_count,
+    VdpBitstreamBuffer const   *bitstream_buffers
+)
+{
+    soft_decoder_p const obj_decoder = SOFT_DECODER(decoder);
+    soft_video_surface_p const obj_surface = SOFT_VIDEO_SURFACE(target);
+    uint64_t num_bytes = 0;
+    unsigned int i;
+
+    if (!obj_decoder || !obj_surface)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!picture_info)
+        return VDP_STATUS_INVALID_POINTER;
+    if (bitstream_buffer_count > 0 && !bitstream_buffers)
+        return VDP_STATUS_INVALID_POINTER;
+
+    for (i = 0; i < bitstream_buffer_count; i++) {
+        if (bitstream_buffers[i].struct_version > VDP_BITSTREAM_BUFFER_VERSION)
+            return VDP_STATUS_INVALID_STRUCT_VERSION;
+        if (bitstream_buffers[i].bitstream_bytes > 0 &&
+            !bitstream_buffers[i].bitstream)
+            return VDP_STATUS_INVALID_POINTER;
+        num_bytes += bitstream_buffers[i].bitstream_bytes;
+    }
+
+    STATS_COUNT("soft: decoder renders", 1);
+    STATS_COUNT("soft: bitstream buffers", bitstream_buffer_count);
+    STATS_COUNT("soft: bitstream bytes", num_bytes);
+
+    /* No bitstream decoding in software, the surface is left as is */
+    return VDP_STATUS_OK;
+}
+
+/* ====================================================================== */
+/* === Device creation                                                === */
+/* ====================================================================== */
+
+static VdpStatus
+soft_get_proc_address(
+    VdpDevice           device,
+    VdpFuncId           function_id,
+    void              **function_pointer
+)
+{
+    void *func;
+
+    if (device != SOFT_DEVICE_HANDLE)
+        return VDP_STATUS_INVALID_HANDLE;
+    if (!function_pointer)
+        return VDP_STATUS_INVALID_POINTER;
+
+    switch (function_id) {
+#define _(ID, FUNC) case VDP_FUNC_ID_##ID: func = (void *)soft_##FUNC; break
+        _(GET_ERROR_STRING,                             get_error_string);
+        _(GET_PROC_ADDRESS,                             get_proc_address);
+        _(GET_API_VERSION,                              get_api_version);
+        _(GET_INFORMATION_STRING,                       get_information_string);
+        _(DEVICE_DESTROY,                               device_destroy);
+        _(GENERATE_CSC_MATRIX,                          generate_csc_matrix);
+        _(VIDEO_SURFACE_QUERY_GET_PUT_BITS_Y_CB_CR_CAPABILITIES,
+                                                        video_surface_query_ycbcr_caps);
+        _(VIDEO_SURFACE_CREATE,                         video_surface_create);
+        _(VIDEO_SURFACE_DESTROY,                        video_surface_destroy);
+        _(VIDEO_SURFACE_GET_BITS_Y_CB_CR,               video_surface_get_bits_ycbcr);
+        _(VIDEO_SURFACE_PUT_BITS_Y_CB_CR,               video_surface_put_bits_ycbcr);
+        _(OUTPUT_SURFACE_QUERY_GET_PUT_BITS_NATIVE_CAPABILITIES,
+                                                        output_surface_query_rgba_caps);
+        _(OUTPUT_SURFACE_QUERY_PUT_BITS_INDEXED_CAPABILITIES,
+                                                        output_surface_query_put_bits_indexed_capabilities);
+        _(OUTPUT_SURFACE_CREATE,                        output_surface_create);
+        _(OUTPUT_SURFACE_DESTROY,                       output_surface_destroy);
+        _(OUTPUT_SURFACE_GET_BITS_NATIVE,               output_surface_get_bits_native);
+        _(OUTPUT_SURFACE_PUT_BITS_NATIVE,               output_surface_put_bits_native);
+        _(OUTPUT_SURFACE_PUT_BITS_INDEXED,              output_surface_put_bits_indexed);
+        _(OUTPUT_SURFACE_RENDER_OUTPUT_SURFACE,         output_surface_render_output_surface);
+        _(OUTPUT_SURFACE_RENDER_BITMAP_SURFACE,         output_surface_render_bitmap_surface);
+        _(BITMAP_SURFACE_QUERY_CAPABILITIES,            bitmap_surface_query_capabilities);
+        _(BITMAP_SURFACE_CREATE,                        bitmap_surface_create);
+        _(BITMAP_SURFACE_DESTROY,                       bitmap_surface_destroy);
+        _(BITMAP_SURFACE_PUT_BITS_NATIVE,               bitmap_surface_put_bits_native);
+        _(DECODER_QUERY_CAPABILITIES,                   decoder_query_capabilities);
+        _(DECODER_CREATE,                               decoder_create);
+        _(DECODER_DESTROY,                              decoder_destroy);
+        _(DECODER_RENDER,                               decoder_render);
+        _(VIDEO_MIXER_QUERY_FEATURE_SUPPORT,            video_mixer_query_feature_support);
+        _(VIDEO_MIXER_QUERY_ATTRIBUTE_SUPPORT,          video_mixer_query_attribute_support);
+        _(VIDEO_MIXER_CREATE,                           video_mixer_create);
+        _(VIDEO_MIXER_SET_FEATURE_ENABLES,              video_mixer_set_feature_enables);
+        _(VIDEO_MIXER_SET_ATTRIBUTE_VALUES,             video_mixer_set_attribute_values);
+        _(VIDEO_MIXER_GET_FEATURE_ENABLES,              video_mixer_get_feature_enables);
+        _(VIDEO_MIXER_GET_ATTRIBUTE_VALUES,             video_mixer_get_attribute_values);
+        _(VIDEO_MIXER_DESTROY,                          video_mixer_destroy);
+        _(VIDEO_MIXER_RENDER,                           video_mixer_render);
+        _(PRESENTATION_QUEUE_TARGET_CREATE_X11,         presentation_queue_target_create_x11);
+        _(PRESENTATION_QUEUE_TARGET_DESTROY,            presentation_queue_target_destroy);
+        _(PRESENTATION_QUEUE_CREATE,                    presentation_queue_create);
+        _(PRESENTATION_QUEUE_DESTROY,                   presentation_queue_destroy);
+        _(PRESENTATION_QUEUE_SET_BACKGROUND_COLOR,      presentation_queue_set_background_color);
+        _(PRESENTATION_QUEUE_GET_BACKGROUND_COLOR,      presentation_queue_get_background_color);
+        _(PRESENTATION_QUEUE_DISPLAY,                   presentation_queue_display);
+        _(PRESENTATION_QUEUE_BLOCK_UNTIL_SURFACE_IDLE,  presentation_queue_block_until_surface_idle);
+        _(PRESENTATION_QUEUE_QUERY_SURFACE_STATUS,      presentation_queue_query_surface_status);
+#undef _
+    default:
+        *function_pointer = NULL;
+        return VDP_STATUS_INVALID_FUNC_ID;
+    }
+    *function_pointer = func;
+    return VDP_STATUS_OK;
+}
+
+// Create software VDPAU device
+VdpStatus
+vdpau_soft_device_create(
+    VdpDevice          *device,
+    VdpGetProcAddress **get_proc_address
+)
+{
+    soft_device_t * const dev = &g_soft_device;
+    VdpStatus vdp_status = VDP_STATUS_OK;
+
+    if (!device || !get_proc_address)
+        return VDP_STATUS_INVALID_POINTER;
+
+    pthread_mutex_lock(&g_soft_device_lock);
+    if (dev->refcount == 0) {
+#define INIT_HEAP(type, id) do {                                        \
+            if (object_heap_init(&dev->type##_heap,                     \
+                                 sizeof(soft_##type##_t),               \
+                                 SOFT_##id##_ID_OFFSET) != 0)           \
+                vdp_status = VDP_STATUS_RESOURCES;                      \
+        } while (0)
+        INIT_HEAP(video_surface,    VIDEO_SURFACE);
+        INIT_HEAP(mixer,            MIXER);
+        INIT_HEAP(queue_target,     QUEUE_TARGET);
+        INIT_HEAP(queue,            QUEUE);
+        INIT_HEAP(decoder,          DECODER);
+#undef INIT_HEAP
+        if (object_heap_init(&dev->output_surface_heap,
+                             sizeof(soft_rgba_surface_t),
+                             SOFT_OUTPUT_SURFACE_ID_OFFSET) != 0 ||
+            object_heap_init(&dev->bitmap_surface_heap,
+                             sizeof(soft_rgba_surface_t),
+                             SOFT_BITMAP_SURFACE_ID_OFFSET) != 0)
+            vdp_status = VDP_STATUS_RESOURCES;
+    }
+    if (vdp_status == VDP_STATUS_OK)
+        dev->refcount++;
+    pthread_mutex_unlock(&g_soft_device_lock);
+
+    if (vdp_status != VDP_STATUS_OK)
+        return vdp_status;
+
+    D(bug("created software VDPAU device\n"));
+    *device           = SOFT_DEVICE_HANDLE;
+    *get_proc_address = soft_get_proc_address;
+    return VDP_STATUS_OK;
+}
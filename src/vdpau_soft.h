@@ -0,0 +1,43 @@
+/*
+ *  vdpau_soft.h - VDPAU backend for VA-API (software VDPAU device)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_SOFT_H
+#define VDPAU_SOFT_H
+
+#include "vdpau_driver.h"
+
+/* The software device keeps all surfaces in host memory and runs the
+ * video mixer on the CPU. It cannot decode bitstreams: VdpDecoderRender()
+ * validates its arguments and leaves the target surface untouched. The
+ * presentation queue does not display anything, it only simulates
+ * vertical retraces to produce presentation timestamps. */
+
+// Check whether the software VDPAU device was requested
+int vdpau_soft_enabled(void)
+    attribute_hidden;
+
+// Create software VDPAU device
+VdpStatus
+vdpau_soft_device_create(
+    VdpDevice          *device,
+    VdpGetProcAddress **get_proc_address
+) attribute_hidden;
+
+#endif /* VDPAU_SOFT_H */
@@ -0,0 +1,361 @@
+/*
+ *  vdpau_stats.c - VDPAU backend for VA-API (latency statistics)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_stats.h"
+#include "utils.h"
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+/* Durations below 8 ns get a bucket each, then every power of two is
+   split into 8 sub-buckets, i.e. values are kept within 12.5% */
+#define STATS_SUB_BUCKETS       8
+#define STATS_MAX_EXPONENT      39      /* ~550 s */
+#define STATS_NUM_BUCKETS       ((STATS_MAX_EXPONENT - 1) * STATS_SUB_BUCKETS)
+#define STATS_MAX_SITES         256
+#define STATS_MAX_COUNTERS      64
+
+/* Default interval between dumps to VDPAU_VIDEO_STATS_FILE (in ms) */
+#define STATS_DUMP_INTERVAL     1000
+
+typedef struct {
+    uint64_t            count;
+    uint64_t            sum;
+    uint64_t            max;
+    uint32_t            buckets[STATS_NUM_BUCKETS];
+} stats_histogram_t;
+
+/* Per-thread histograms are never freed, so that statistics of exited
+   threads are still reported */
+typedef struct stats_thread stats_thread_t;
+struct stats_thread {
+    stats_thread_t     *next;
+    stats_histogram_t  *histograms[STATS_MAX_SITES];
+};
+
+int g_stats_enabled;
+
+static pthread_mutex_t  g_stats_lock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_stats_cond    = PTHREAD_COND_INITIALIZER;
+static unsigned int     g_stats_refcount;
+static stats_site_t    *g_stats_sites[STATS_MAX_SITES];
+static int              g_stats_num_sites;
+static stats_counter_t *g_stats_counters[STATS_MAX_COUNTERS];
+static int              g_stats_num_counters;
+static stats_thread_t  *g_stats_threads;
+static __thread stats_thread_t *g_stats_thread;
+static const char      *g_stats_file;
+static unsigned int     g_stats_interval;
+static pthread_t        g_stats_dump_thread;
+static int              g_stats_dump_thread_quit = -1;
+
+static inline unsigned int stats_get_bucket(uint64_t value)
+{
+    unsigned int e;
+
+    if (value < STATS_SUB_BUCKETS)
+        return value;
+    e = 63 - __builtin_clzll(value);
+    if (e > STATS_MAX_EXPONENT)
+        return STATS_NUM_BUCKETS - 1;
+    return (e - 2) * STATS_SUB_BUCKETS + ((value >> (e - 3)) & (STATS_SUB_BUCKETS - 1));
+}
+
+static inline uint64_t stats_get_bucket_value(unsigned int bucket)
+{
+    unsigned int e;
+
+    if (bucket < STATS_SUB_BUCKETS)
+        return bucket;
+    e = bucket / STATS_SUB_BUCKETS + 2;
+    return (uint64_t)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << (e - 3);
+}
+
+static int stats_site_register(stats_site_t *site)
+{
+    int id;
+
+    pthread_mutex_lock(&g_stats_lock);
+    id = site->id;
+    if (id < 0 && g_stats_num_sites < STATS_MAX_SITES) {
+        id = g_stats_num_sites;
+        g_stats_sites[id] = site;
+        __atomic_store_n(&site->id, id, __ATOMIC_RELEASE);
+        __atomic_store_n(&g_stats_num_sites, id + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+    return id;
+}
+
+static stats_thread_t *stats_thread_new(void)
+{
+    stats_thread_t *thread;
+
+    thread = calloc(1, sizeof(*thread));
+    if (!thread)
+        return NULL;
+
+    thread->next = __atomic_load_n(&g_stats_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&g_stats_threads, &thread->next, thread,
+                                        1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return thread;
+}
+
+// Record a call of SITE that took DURATION nanoseconds
+void
+stats_record(stats_site_t *site, uint64_t duration)
+{
+    stats_thread_t *thread = g_stats_thread;
+    stats_histogram_t *histogram;
+    uint32_t *bucket;
+    int id;
+
+    if (!thread && !(thread = g_stats_thread = stats_thread_new()))
+        return;
+
+    id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+    if (id < 0 && (id = stats_site_register(site)) < 0)
+        return;
+
+    histogram = thread->histograms[id];
+    if (!histogram) {
+        histogram = calloc(1, sizeof(*histogram));
+        if (!histogram)
+            return;
+        __atomic_store_n(&thread->histograms[id], histogram, __ATOMIC_RELEASE);
+    }
+
+    /* This thread is the only writer */
+    bucket = &histogram->buckets[stats_get_bucket(duration)];
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + duration, __ATOMIC_RELAXED);
+    if (duration > histogram->max)
+        __atomic_store_n(&histogram->max, duration, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+}
+
+// Add N to COUNTER
+void
+stats_count_add(stats_counter_t *counter, uint64_t n)
+{
+    int id;
+
+    if (__atomic_load_n(&counter->id, __ATOMIC_ACQUIRE) < 0) {
+        pthread_mutex_lock(&g_stats_lock);
+        id = counter->id;
+        if (id < 0 && g_stats_num_counters < STATS_MAX_COUNTERS) {
+            id = g_stats_num_counters;
+            g_stats_counters[id] = counter;
+            __atomic_store_n(&counter->id, id, __ATOMIC_RELEASE);
+            __atomic_store_n(&g_stats_num_counters, id + 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&g_stats_lock);
+        if (id < 0)
+            return;
+    }
+    __atomic_fetch_add(&counter->value, n, __ATOMIC_RELAXED);
+}
+
+// Merge the histograms of all threads for site ID
+static void stats_merge(int id, stats_histogram_t *merged)
+{
+    stats_thread_t *thread;
+    stats_histogram_t *histogram;
+    uint64_t value;
+    unsigned int i;
+
+    memset(merged, 0, sizeof(*merged));
+    thread = __atomic_load_n(&g_stats_threads, __ATOMIC_ACQUIRE);
+    for (; thread; thread = thread->next) {
+        histogram = __atomic_load_n(&thread->histograms[id], __ATOMIC_ACQUIRE);
+        if (!histogram)
+            continue;
+        merged->count += __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+        merged->sum   += __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+        value = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+        if (merged->max < value)
+            merged->max = value;
+        for (i = 0; i < STATS_NUM_BUCKETS; i++)
+            merged->buckets[i] += __atomic_load_n(&histogram->buckets[i],
+                                                  __ATOMIC_RELAXED);
+    }
+}
+
+// Get the lower bound of the bucket holding the PERCENTILE-th value
+static uint64_t
+stats_get_percentile(const stats_histogram_t *histogram, unsigned int percentile)
+{
+    uint64_t count = 0, target;
+    unsigned int i;
+
+    /* Bucket counts may be ahead of the total count while merging */
+    target = (histogram->count * percentile + 99) / 100;
+    for (i = 0; i < STATS_NUM_BUCKETS; i++) {
+        count += histogram->buckets[i];
+        if (count >= target)
+            return stats_get_bucket_value(i);
+    }
+    return histogram->max;
+}
+
+static void stats_dump(FILE *fp)
+{
+    stats_histogram_t histogram;
+    int i, num_sites, num_counters;
+
+    fprintf(fp, "%-40s %10s %10s %10s %10s %10s %10s\n", "call",
+            "count", "mean (us)", "p50", "p90", "p99", "max");
+
+    num_sites = __atomic_load_n(&g_stats_num_sites, __ATOMIC_ACQUIRE);
+    for (i = 0; i < num_sites; i++) {
+        stats_merge(i, &histogram);
+        if (histogram.count == 0)
+            continue;
+        fprintf(fp, "%-40s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                g_stats_sites[i]->name,
+                (unsigned long long)histogram.count,
+                histogram.sum / 1000.0 / histogram.count,
+                stats_get_percentile(&histogram, 50) / 1000.0,
+                stats_get_percentile(&histogram, 90) / 1000.0,
+                stats_get_percentile(&histogram, 99) / 1000.0,
+                histogram.max / 1000.0);
+    }
+
+    num_counters = __atomic_load_n(&g_stats_num_counters, __ATOMIC_ACQUIRE);
+    if (num_counters == 0)
+        return;
+    fprintf(fp, "\n%-40s %10s\n", "counter", "value");
+    for (i = 0; i < num_counters; i++)
+        fprintf(fp, "%-40s %10llu\n", g_stats_counters[i]->name,
+                (unsigned long long)__atomic_load_n(&g_stats_counters[i]->value,
+                                                    __ATOMIC_RELAXED));
+}
+
+// Replace VDPAU_VIDEO_STATS_FILE with the current statistics
+static void stats_dump_file(void)
+{
+    char tmp_path[PATH_MAX];
+    FILE *fp;
+
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", g_stats_file) >= sizeof(tmp_path))
+        return;
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        D(bug("failed to open statistics file %s\n", tmp_path));
+        return;
+    }
+    stats_dump(fp);
+    if (fclose(fp) != 0 || rename(tmp_path, g_stats_file) != 0)
+        unlink(tmp_path);
+}
+
+static void *stats_dump_thread(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&g_stats_lock);
+    while (!g_stats_dump_thread_quit) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += g_stats_interval / 1000;
+        deadline.tv_nsec += (g_stats_interval % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        if (pthread_cond_timedwait(&g_stats_cond, &g_stats_lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&g_stats_lock);
+            stats_dump_file();
+            pthread_mutex_lock(&g_stats_lock);
+        }
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+    return NULL;
+}
+
+// Start recording statistics, once per display
+int
+vdpau_stats_init(void)
+{
+    int enabled, interval;
+
+    pthread_mutex_lock(&g_stats_lock);
+    if (g_stats_refcount++ > 0) {
+        pthread_mutex_unlock(&g_stats_lock);
+        return 0;
+    }
+
+    g_stats_file = getenv("VDPAU_VIDEO_STATS_FILE");
+    if (g_stats_file && !*g_stats_file)
+        g_stats_file = NULL;
+    if (getenv_yesno("VDPAU_VIDEO_STATS", &enabled) < 0)
+        enabled = g_stats_file != NULL;
+    if (getenv_int("VDPAU_VIDEO_STATS_INTERVAL", &interval) < 0 || interval < 0)
+        interval = STATS_DUMP_INTERVAL;
+    g_stats_interval = interval;
+
+    if (enabled && g_stats_file && g_stats_interval > 0) {
+        g_stats_dump_thread_quit = 0;
+        if (pthread_create(&g_stats_dump_thread, NULL, stats_dump_thread, NULL) != 0)
+            g_stats_dump_thread_quit = -1;
+    }
+    g_stats_enabled = enabled;
+    pthread_mutex_unlock(&g_stats_lock);
+    return 0;
+}
+
+// Dump statistics, and stop recording them with the last display
+void
+vdpau_stats_exit(void)
+{
+    int stop_dump_thread = 0;
+
+    pthread_mutex_lock(&g_stats_lock);
+    if (g_stats_refcount == 0 || --g_stats_refcount > 0) {
+        pthread_mutex_unlock(&g_stats_lock);
+        return;
+    }
+    if (g_stats_dump_thread_quit == 0) {
+        g_stats_dump_thread_quit = 1;
+        pthread_cond_signal(&g_stats_cond);
+        stop_dump_thread = 1;
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+
+    if (stop_dump_thread) {
+        pthread_join(g_stats_dump_thread, NULL);
+        g_stats_dump_thread_quit = -1;
+    }
+
+    if (!g_stats_enabled)
+        return;
+    g_stats_enabled = 0;
+
+    if (g_stats_file)
+        stats_dump_file();
+    else
+        stats_dump(stdout);
+}
@@ -0,0 +1,109 @@
+/*
+ *  vdpau_stats.h - VDPAU backend for VA-API (latency statistics)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_STATS_H
+#define VDPAU_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Latency of VA entry points and VDPAU calls is recorded per call site
+ * into per-thread log-linear histograms when VDPAU_VIDEO_STATS is set
+ * or VDPAU_VIDEO_STATS_FILE names a file. Histograms have a single
+ * writer, so readers merge them without locking. */
+typedef struct stats_site stats_site_t;
+struct stats_site {
+    const char         *name;
+    int                 id;     /* -1 until first recorded */
+};
+
+typedef struct {
+    stats_site_t       *site;
+    uint64_t            start;  /* 0 if not recorded */
+} stats_timer_t;
+
+/* Counters of events that have no latency, e.g. bitstream buffers, are
+ * dumped after the histograms */
+typedef struct stats_counter stats_counter_t;
+struct stats_counter {
+    const char         *name;
+    int                 id;     /* -1 until first counted */
+    uint64_t            value;
+};
+
+extern int g_stats_enabled attribute_hidden;
+
+// Record a call of SITE that took DURATION nanoseconds
+void
+stats_record(stats_site_t *site, uint64_t duration)
+    attribute_hidden;
+
+// Add N to COUNTER
+void
+stats_count_add(stats_counter_t *counter, uint64_t n)
+    attribute_hidden;
+
+// Start recording statistics, once per display
+int
+vdpau_stats_init(void)
+    attribute_hidden;
+
+// Dump statistics, and stop recording them with the last display
+void
+vdpau_stats_exit(void)
+    attribute_hidden;
+
+static inline uint64_t stats_get_ticks(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static inline stats_timer_t stats_timer_begin(stats_site_t *site)
+{
+    stats_timer_t timer;
+
+    timer.site  = site;
+    timer.start = __builtin_expect(g_stats_enabled, 0) ? stats_get_ticks() : 0;
+    return timer;
+}
+
+static inline void stats_timer_end(stats_timer_t *timer)
+{
+    if (__builtin_expect(timer->start != 0, 0))
+        stats_record(timer->site, stats_get_ticks() - timer->start);
+}
+
+// Add N to counter NAME, if statistics are recorded
+#define STATS_COUNT(name, n) do {                                       \
+        static stats_counter_t stats_counter = { name, -1, 0 };         \
+        if (__builtin_expect(g_stats_enabled, 0))                       \
+            stats_count_add(&stats_counter, n);                         \
+    } while (0)
+
+// Time the enclosing scope as call site NAME
+#define STATS_SCOPE(var, name)                                          \
+    static stats_site_t var##_site = { name, -1 };                      \
+    stats_timer_t var __attribute__((cleanup(stats_timer_end))) =       \
+        stats_timer_begin(&var##_site)
+
+#endif /* VDPAU_STATS_H */
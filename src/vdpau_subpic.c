@@ -23,6 +23,7 @@
 #include "vdpau_video.h"
 #include "vdpau_image.h"
 #include "vdpau_buffer.h"
+#include "vdpau_caps.h"
 #include "utils.h"
 
 #define DEBUG 1
@@ -97,36 +98,15 @@ is_supported_format(
     vdpau_driver_data_t             *driver_data,
     const vdpau_subpic_format_map_t *format)
 {
-    VdpBool is_supported = VDP_FALSE;
-    VdpStatus vdp_status;
-    uint32_t max_width, max_height;
-
     switch (format->vdp_format_type) {
     case VDP_IMAGE_FORMAT_TYPE_RGBA:
-        vdp_status = vdpau_bitmap_surface_query_capabilities(
-            driver_data,
-            driver_data->vdp_device,
-            format->vdp_format,
-            &is_supported,
-            &max_width,
-            &max_height
-        );
-        break;
+        return vdpau_caps_has_bitmap_format(driver_data, format->vdp_format);
     case VDP_IMAGE_FORMAT_TYPE_INDEXED:
-        vdp_status = vdpau_output_surface_query_put_bits_indexed_capabilities(
-            driver_data,
-            driver_data->vdp_device,
-            VDP_RGBA_FORMAT_B8G8R8A8,
-            format->vdp_format,
-            VDP_COLOR_TABLE_FORMAT_B8G8R8X8,
-            &is_supported
-        );
-        break;
+        return vdpau_caps_has_indexed_format(driver_data, format->vdp_format);
     default:
-        vdp_status = VDP_STATUS_ERROR;
         break;
     }
-    return vdp_status == VDP_STATUS_OK && is_supported;
+    return VDP_FALSE;
 }
 
 // Append association to the subpicture
@@ -349,12 +329,22 @@ commit_subpicture(
         dirty_rect.y1 = MAX(dirty_rect.y1, rect->y + rect->height);
     }
 
+    /* Widen the rectangle to aligned rows, image pitches are aligned */
+    const unsigned int bpp = (obj_image->image.format.bits_per_pixel + 7) / 8;
+    const unsigned int align = get_image_pitch_alignment();
+    if (align % bpp == 0 && dirty_rect.x0 < dirty_rect.x1) {
+        const unsigned int align_pixels = align / bpp;
+        dirty_rect.x0 -= dirty_rect.x0 % align_pixels;
+        dirty_rect.x1 += (align_pixels - dirty_rect.x1 % align_pixels) % align_pixels;
+        dirty_rect.x1  = MIN(dirty_rect.x1, obj_subpicture->width);
+    }
+
     const uint8_t *src;
     uint32_t src_stride;
     src_stride = obj_image->image.pitches[0];
     src = ((uint8_t *)obj_buffer->buffer_data + obj_image->image.offsets[0] +
            dirty_rect.y0 * obj_image->image.pitches[0] +
-           dirty_rect.x0 * ((obj_image->image.format.bits_per_pixel + 7) / 8));
+           dirty_rect.x0 * bpp);
 
     VdpStatus vdp_status;
     switch (obj_subpicture->vdp_format_type) {
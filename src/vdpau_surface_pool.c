@@ -0,0 +1,130 @@
+/*
+ *  vdpau_surface_pool.c - VDPAU backend for VA-API (video surface pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_surface_pool.h"
+#include "utils.h"
+
+/* Default number of idle surfaces kept, and for how long (in ms) */
+#define VDPAU_SURFACE_POOL_SIZE         32
+#define VDPAU_SURFACE_POOL_TIMEOUT      5000
+
+// Create a VDPAU video surface for the pool
+static VdpStatus
+surface_pool_create(
+    vdpau_driver_data_t *driver_data,
+    uint32_t             chroma_type,
+    uint32_t             width,
+    uint32_t             height,
+    uint32_t            *surface
+)
+{
+    VdpStatus vdp_status;
+
+    vdp_status = vdpau_video_surface_create(
+        driver_data,
+        driver_data->vdp_device,
+        chroma_type,
+        width, height,
+        surface
+    );
+    VDPAU_CHECK_STATUS(vdp_status, "VdpVideoSurfaceCreate()");
+    return vdp_status;
+}
+
+// Destroy a VDPAU video surface of the pool
+static void
+surface_pool_destroy(vdpau_driver_data_t *driver_data, uint32_t surface)
+{
+    vdpau_video_surface_destroy(driver_data, surface);
+}
+
+// Create pool of recycled VDPAU video surfaces
+int
+vdpau_surface_pool_init(vdpau_driver_data_t *driver_data)
+{
+    unsigned int max_surfaces, timeout;
+    int value;
+
+    if (getenv_int("VDPAU_VIDEO_SURFACE_POOL_SIZE", &value) < 0 || value < 0)
+        value = VDPAU_SURFACE_POOL_SIZE;
+    max_surfaces = value;
+    if (getenv_int("VDPAU_VIDEO_SURFACE_POOL_TIMEOUT", &value) < 0 || value < 0)
+        value = VDPAU_SURFACE_POOL_TIMEOUT;
+    timeout = value;
+
+    driver_data->surface_pool = handle_pool_new(
+        "video surface",
+        max_surfaces, timeout,
+        surface_pool_create,
+        surface_pool_destroy
+    );
+    if (!driver_data->surface_pool)
+        return -1;
+    return 0;
+}
+
+// Destroy pool of recycled VDPAU video surfaces
+void
+vdpau_surface_pool_exit(vdpau_driver_data_t *driver_data)
+{
+    handle_pool_free(driver_data, driver_data->surface_pool);
+    driver_data->surface_pool = NULL;
+}
+
+// Get NUM_SURFACES video surfaces, recycled ones first
+VdpStatus
+surface_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpChromaType        chroma_type,
+    uint32_t             width,
+    uint32_t             height,
+    VdpVideoSurface     *surfaces,
+    unsigned int         num_surfaces
+)
+{
+    return handle_pool_acquire(
+        driver_data,
+        driver_data->surface_pool,
+        chroma_type,
+        width, height,
+        surfaces, num_surfaces
+    );
+}
+
+// Return NUM_SURFACES video surfaces to the pool, or destroy them
+void
+surface_pool_release(
+    vdpau_driver_data_t   *driver_data,
+    VdpChromaType          chroma_type,
+    uint32_t               width,
+    uint32_t               height,
+    const VdpVideoSurface *surfaces,
+    unsigned int           num_surfaces
+)
+{
+    handle_pool_release(
+        driver_data,
+        driver_data->surface_pool,
+        chroma_type,
+        width, height,
+        surfaces, num_surfaces
+    );
+}
@@ -0,0 +1,64 @@
+/*
+ *  vdpau_surface_pool.h - VDPAU backend for VA-API (video surface pool)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_SURFACE_POOL_H
+#define VDPAU_SURFACE_POOL_H
+
+#include "vdpau_driver.h"
+#include "vdpau_handle_pool.h"
+
+/* VdpVideoSurfaces released by vaDestroySurfaces() are kept per (chroma
+ * type, width, height) so that the next vaCreateSurfaces() of the same
+ * geometry does not go through VdpVideoSurfaceCreate() again. Recycled
+ * surfaces keep their previous contents. */
+
+// Create pool of recycled VDPAU video surfaces
+int
+vdpau_surface_pool_init(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Destroy pool of recycled VDPAU video surfaces
+void
+vdpau_surface_pool_exit(vdpau_driver_data_t *driver_data)
+    attribute_hidden;
+
+// Get NUM_SURFACES video surfaces, recycled ones first
+VdpStatus
+surface_pool_acquire(
+    vdpau_driver_data_t *driver_data,
+    VdpChromaType        chroma_type,
+    uint32_t             width,
+    uint32_t             height,
+    VdpVideoSurface     *surfaces,
+    unsigned int         num_surfaces
+) attribute_hidden;
+
+// Return NUM_SURFACES video surfaces to the pool, or destroy them
+void
+surface_pool_release(
+    vdpau_driver_data_t   *driver_data,
+    VdpChromaType          chroma_type,
+    uint32_t               width,
+    uint32_t               height,
+    const VdpVideoSurface *surfaces,
+    unsigned int           num_surfaces
+) attribute_hidden;
+
+#endif /* VDPAU_SURFACE_POOL_H */
@@ -0,0 +1,168 @@
+/*
+ *  vdpau_timeline.c - VDPAU backend for VA-API (timeline export)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include "sysdeps.h"
+#include "vdpau_timeline.h"
+#include <va/va.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+int g_timeline_enabled;
+
+static pthread_mutex_t  g_timeline_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int     g_timeline_refcount;
+static FILE            *g_timeline_file;
+static int              g_timeline_pid;
+static uint32_t         g_timeline_flow;
+
+/* Trace event timestamps are in microseconds */
+#define TIMELINE_TS_FMT         "%llu.%03u"
+#define TIMELINE_TS(t)          (unsigned long long)((t) / 1000), (unsigned int)((t) % 1000)
+
+// Write a flow event of ID bound to the span at TS on TRACK
+static void
+timeline_write_flow(const char *phase, uint32_t id, uint32_t track, uint64_t ts)
+{
+    fprintf(g_timeline_file,
+            "{\"name\":\"picture\",\"cat\":\"vdpau\",\"ph\":\"%s\","
+            "\"bp\":\"e\",\"id\":%u,\"pid\":%d,\"tid\":%u,"
+            "\"ts\":" TIMELINE_TS_FMT "},\n",
+            phase, id, g_timeline_pid, track, TIMELINE_TS(ts));
+}
+
+// Write SPAN, ending now
+void
+timeline_write_span(const timeline_span_t *span)
+{
+    const uint64_t end = stats_get_ticks();
+    const uint64_t duration = end - span->start;
+
+    /* Flow events bind to the span enclosing them, pick its middle */
+    const uint64_t middle = span->start + duration / 2;
+
+    pthread_mutex_lock(&g_timeline_lock);
+    if (g_timeline_file) {
+        fprintf(g_timeline_file,
+                "{\"name\":\"%s\",\"cat\":\"vdpau\",\"ph\":\"X\","
+                "\"pid\":%d,\"tid\":%u,"
+                "\"ts\":" TIMELINE_TS_FMT ",\"dur\":" TIMELINE_TS_FMT,
+                span->name, g_timeline_pid, span->track,
+                TIMELINE_TS(span->start), TIMELINE_TS(duration));
+        if (span->surface != VA_INVALID_SURFACE)
+            fprintf(g_timeline_file, ",\"args\":{\"surface\":\"0x%08x\"}",
+                    span->surface);
+        fputs("},\n", g_timeline_file);
+        if (span->flow_start)
+            timeline_write_flow("s", span->flow_start, span->track, middle);
+        if (span->flow_end)
+            timeline_write_flow("f", span->flow_end, span->track, middle);
+    }
+    pthread_mutex_unlock(&g_timeline_lock);
+}
+
+// Name the track of a VA context or output
+void
+timeline_name_track(uint32_t track, const char *format, ...)
+{
+    va_list args;
+
+    if (!g_timeline_enabled)
+        return;
+
+    pthread_mutex_lock(&g_timeline_lock);
+    if (g_timeline_file) {
+        fprintf(g_timeline_file,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                "\"args\":{\"name\":\"",
+                g_timeline_pid, track);
+        va_start(args, format);
+        vfprintf(g_timeline_file, format, args);
+        va_end(args);
+        fputs("\"}},\n", g_timeline_file);
+    }
+    pthread_mutex_unlock(&g_timeline_lock);
+}
+
+// Allocate a new flow ID
+uint32_t
+timeline_new_flow(void)
+{
+    uint32_t id;
+
+    /* Skip 0, which means no flow */
+    do {
+        id = __atomic_add_fetch(&g_timeline_flow, 1, __ATOMIC_RELAXED);
+    } while (id == 0);
+    return id;
+}
+
+// Open VDPAU_VIDEO_TIMELINE, once per display
+int
+vdpau_timeline_init(void)
+{
+    const char * const timeline_file = getenv("VDPAU_VIDEO_TIMELINE");
+
+    if (!timeline_file || !*timeline_file)
+        return 0;
+
+    pthread_mutex_lock(&g_timeline_lock);
+    if (g_timeline_refcount++ > 0) {
+        pthread_mutex_unlock(&g_timeline_lock);
+        return 0;
+    }
+
+    if (!g_timeline_file) {
+        g_timeline_file = fopen(timeline_file, "w");
+        if (!g_timeline_file) {
+            vdpau_error_message("could not open timeline file %s, "
+                                "timeline disabled\n", timeline_file);
+            g_timeline_refcount--;
+            pthread_mutex_unlock(&g_timeline_lock);
+            return 0;
+        }
+        g_timeline_pid = getpid();
+        fprintf(g_timeline_file,
+                "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"vdpau-va-driver\"}},\n",
+                g_timeline_pid);
+    }
+    g_timeline_enabled = 1;
+    pthread_mutex_unlock(&g_timeline_lock);
+    return 0;
+}
+
+// Flush the timeline, and stop recording it with the last display
+void
+vdpau_timeline_exit(void)
+{
+    pthread_mutex_lock(&g_timeline_lock);
+    if (g_timeline_refcount == 0 || --g_timeline_refcount > 0) {
+        pthread_mutex_unlock(&g_timeline_lock);
+        return;
+    }
+    g_timeline_enabled = 0;
+    fflush(g_timeline_file);
+    pthread_mutex_unlock(&g_timeline_lock);
+}
@@ -0,0 +1,99 @@
+/*
+ *  vdpau_timeline.h - VDPAU backend for VA-API (timeline export)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef VDPAU_TIMELINE_H
+#define VDPAU_TIMELINE_H
+
+#include "vdpau_stats.h"
+
+/* When VDPAU_VIDEO_TIMELINE names a file, the decode and display steps
+ * of every picture are written to it as trace events (JSON array format)
+ * for chrome://tracing or ui.perfetto.dev. Each VA context and each
+ * output gets its own track, keyed by its object ID, and every span
+ * carries the VASurfaceID it worked on. A flow arrow links vaEndPicture()
+ * of a surface to the first flip of the output surface showing it.
+ *
+ * The file is never closed with "]", which the format allows, so that
+ * it can be loaded while the application is still running.
+ */
+typedef struct {
+    const char         *name;
+    uint32_t            track;          /* VAContextID or output ID */
+    uint32_t            surface;        /* VASurfaceID */
+    uint32_t            flow_start;     /* flow IDs, 0 if none */
+    uint32_t            flow_end;
+    uint64_t            start;          /* 0 if not recorded */
+} timeline_span_t;
+
+extern int g_timeline_enabled attribute_hidden;
+
+// Open VDPAU_VIDEO_TIMELINE, once per display. The timeline stays
+// disabled if the file cannot be opened
+int
+vdpau_timeline_init(void)
+    attribute_hidden;
+
+// Flush the timeline, and stop recording it with the last display
+void
+vdpau_timeline_exit(void)
+    attribute_hidden;
+
+// Name the track of a VA context or output
+void
+timeline_name_track(uint32_t track, const char *format, ...)
+    attribute_hidden;
+
+// Allocate a new flow ID
+uint32_t
+timeline_new_flow(void)
+    attribute_hidden;
+
+// Write SPAN, ending now
+void
+timeline_write_span(const timeline_span_t *span)
+    attribute_hidden;
+
+static inline timeline_span_t
+timeline_span_begin(const char *name, uint32_t track, uint32_t surface)
+{
+    timeline_span_t span;
+
+    span.name       = name;
+    span.track      = track;
+    span.surface    = surface;
+    span.flow_start = 0;
+    span.flow_end   = 0;
+    span.start      = __builtin_expect(g_timeline_enabled, 0) ? stats_get_ticks() : 0;
+    return span;
+}
+
+static inline void timeline_span_end(timeline_span_t *span)
+{
+    if (__builtin_expect(span->start != 0, 0))
+        timeline_write_span(span);
+}
+
+// Record the enclosing scope as span NAME of SURFACE on TRACK
+#define TIMELINE_SCOPE(var, name, track, surface)                       \
+    timeline_span_t var __attribute__((cleanup(timeline_span_end))) =   \
+        timeline_span_begin(name, track, surface)
+
+#endif /* VDPAU_TIMELINE_H */
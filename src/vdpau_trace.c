@@ -0,0 +1,433 @@
+/*
+ *  vdpau_trace.c - VDPAU backend for VA-API (binary trace)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include "sysdeps.h"
+#include "vdpau_trace.h"
+#include "utils.h"
+#include <pthread.h>
+#include <time.h>
+
+#define DEBUG 1
+#include "debug.h"
+
+/* Number of records per thread, and default flush interval (in ms) */
+#define TRACE_RING_SIZE         4096
+#define TRACE_FLUSH_INTERVAL    50
+
+/* Strings are interned by contents, as %s arguments may be built on
+   the stack. The table is only appended to, lookups take no lock */
+#define TRACE_MAX_STRINGS       4096
+#define TRACE_HASH_SIZE         (2 * TRACE_MAX_STRINGS)
+
+/* Reserved string ID of %s arguments that did not fit in the table */
+#define TRACE_STRING_DROPPED    0
+
+enum {
+    TRACE_ARG_INT = 1,
+    TRACE_ARG_LONG,
+    TRACE_ARG_LONG_LONG,
+    TRACE_ARG_POINTER,
+    TRACE_ARG_DOUBLE,
+    TRACE_ARG_STRING
+};
+
+typedef struct {
+    const char         *str;
+    unsigned int        num_args;
+    uint8_t             arg_types[VDPAU_TRACE_MAX_ARGS];
+} trace_string_t;
+
+/* Single producer (the owning thread), single consumer (the flusher) */
+typedef struct trace_ring trace_ring_t;
+struct trace_ring {
+    trace_ring_t       *next;
+    unsigned int        thread;
+    unsigned int        head;           /* written by the producer */
+    unsigned int        tail;           /* written by the consumer */
+    unsigned int        flush_head;     /* consumer snapshot of head */
+    uint64_t            num_dropped;
+    int                 indent;
+    vdpau_trace_record_t records[TRACE_RING_SIZE];
+};
+
+static pthread_mutex_t  g_trace_lock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_trace_cond    = PTHREAD_COND_INITIALIZER;
+static unsigned int     g_trace_refcount;
+static trace_string_t   g_trace_strings[TRACE_MAX_STRINGS] = {
+    [TRACE_STRING_DROPPED] = { "<dropped>", 0, { 0, } }
+};
+static unsigned int     g_trace_num_strings = TRACE_STRING_DROPPED + 1;
+static unsigned int     g_trace_num_strings_written;
+static int              g_trace_hash[TRACE_HASH_SIZE]; /* string ID + 1 */
+static trace_ring_t    *g_trace_rings;
+static unsigned int     g_trace_num_threads;
+static __thread trace_ring_t *g_trace_ring;
+static FILE            *g_trace_file;
+static unsigned int     g_trace_interval;
+static pthread_t        g_trace_thread;
+static int              g_trace_thread_quit = -1;
+static int              g_trace_file_enabled = -1;
+
+// Check whether VDPAU_VIDEO_TRACE_FILE names a trace file
+int trace_file_requested(void)
+{
+    const char * const trace_file = getenv("VDPAU_VIDEO_TRACE_FILE");
+
+    return trace_file && *trace_file;
+}
+
+// Check whether trace_print() records to VDPAU_VIDEO_TRACE_FILE
+int trace_file_enabled(void)
+{
+    int enabled = __atomic_load_n(&g_trace_file_enabled, __ATOMIC_RELAXED);
+
+    if (enabled < 0) {
+        enabled = trace_file_requested();
+        __atomic_store_n(&g_trace_file_enabled, enabled, __ATOMIC_RELAXED);
+    }
+    return enabled;
+}
+
+static inline uint64_t trace_get_ticks(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static uint32_t trace_hash_string(const char *str)
+{
+    uint32_t hash = 2166136261U;
+
+    while (*str)
+        hash = (hash ^ (uint8_t)*str++) * 16777619U;
+    return hash;
+}
+
+// Determine argument types of a printf() format
+static void trace_parse_format(trace_string_t *string)
+{
+    const char *p = string->str;
+    unsigned int n = 0, type, num_longs;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        if (*++p == '%') {
+            p++;
+            continue;
+        }
+        num_longs = 0;
+        for (; *p; p++) {
+            if (*p == 'l')
+                num_longs++;
+            else if (!strchr("#0- +'123456789.hzjt", *p))
+                break;
+        }
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            type = (num_longs == 0 ? TRACE_ARG_INT :
+                    num_longs == 1 ? TRACE_ARG_LONG : TRACE_ARG_LONG_LONG);
+            break;
+        case 'p':
+            type = TRACE_ARG_POINTER;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+            type = TRACE_ARG_DOUBLE;
+            break;
+        case 's':
+            type = TRACE_ARG_STRING;
+            break;
+        default:
+            type = 0;
+            break;
+        }
+        if (!type || n == VDPAU_TRACE_MAX_ARGS)
+            break;
+        string->arg_types[n++] = type;
+        p++;
+    }
+    string->num_args = n;
+}
+
+// Look STR up, return its ID or -1 with *PSLOT set to the free hash slot
+static int trace_lookup_string(const char *str, uint32_t hash, unsigned int *pslot)
+{
+    unsigned int i;
+    int id;
+
+    for (i = hash % TRACE_HASH_SIZE; ; i = (i + 1) % TRACE_HASH_SIZE) {
+        id = __atomic_load_n(&g_trace_hash[i], __ATOMIC_ACQUIRE) - 1;
+        if (id < 0)
+            break;
+        if (strcmp(g_trace_strings[id].str, str) == 0)
+            return id;
+    }
+    *pslot = i;
+    return -1;
+}
+
+// Get the ID of STR, or -1 if the table is full
+static int trace_intern_string(const char *str)
+{
+    const uint32_t hash = trace_hash_string(str);
+    trace_string_t *string;
+    unsigned int slot;
+    int id;
+
+    if ((id = trace_lookup_string(str, hash, &slot)) >= 0)
+        return id;
+
+    /* Another thread may be adding the same string */
+    pthread_mutex_lock(&g_trace_lock);
+    if ((id = trace_lookup_string(str, hash, &slot)) < 0 &&
+        g_trace_num_strings < TRACE_MAX_STRINGS) {
+        string = &g_trace_strings[g_trace_num_strings];
+        string->str = strdup(str);
+        if (string->str) {
+            trace_parse_format(string);
+            id = g_trace_num_strings;
+            __atomic_store_n(&g_trace_num_strings, id + 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&g_trace_hash[slot], id + 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+    return id;
+}
+
+static trace_ring_t *trace_ring_new(void)
+{
+    trace_ring_t *ring;
+
+    ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return NULL;
+
+    ring->thread = __atomic_add_fetch(&g_trace_num_threads, 1, __ATOMIC_RELAXED);
+    ring->next   = __atomic_load_n(&g_trace_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&g_trace_rings, &ring->next, ring,
+                                        1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    return ring;
+}
+
+// Record a trace_print() call into the ring of the current thread
+void
+trace_record(int indent, const char *format, va_list args)
+{
+    trace_ring_t *ring = g_trace_ring;
+    vdpau_trace_record_t *record;
+    const trace_string_t *string;
+    unsigned int i, head;
+    int id, arg_id;
+
+    if (!ring && !(ring = g_trace_ring = trace_ring_new()))
+        return;
+
+    head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+        __atomic_add_fetch(&ring->num_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if ((id = trace_intern_string(format)) < 0) {
+        __atomic_add_fetch(&ring->num_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    string = &g_trace_strings[id];
+
+    record = &ring->records[head % TRACE_RING_SIZE];
+    record->timestamp = trace_get_ticks();
+    record->thread    = ring->thread;
+    record->id        = id;
+    record->type      = VDPAU_TRACE_RECORD_PRINT;
+    record->num_args  = string->num_args;
+    record->indent    = indent > 0 ? indent : 0;
+    record->reserved  = 0;
+    for (i = 0; i < string->num_args; i++) {
+        switch (string->arg_types[i]) {
+        case TRACE_ARG_INT:
+            record->args[i] = va_arg(args, unsigned int);
+            break;
+        case TRACE_ARG_LONG:
+            record->args[i] = va_arg(args, unsigned long);
+            break;
+        case TRACE_ARG_LONG_LONG:
+            record->args[i] = va_arg(args, unsigned long long);
+            break;
+        case TRACE_ARG_POINTER:
+            record->args[i] = (uintptr_t)va_arg(args, void *);
+            break;
+        case TRACE_ARG_DOUBLE: {
+            const double value = va_arg(args, double);
+            memcpy(&record->args[i], &value, sizeof(value));
+            break;
+        }
+        case TRACE_ARG_STRING:
+            arg_id = trace_intern_string(va_arg(args, const char *));
+            record->args[i] = arg_id < 0 ? TRACE_STRING_DROPPED : arg_id;
+            break;
+        }
+    }
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Write string definitions for strings interned since the last flush
+static void trace_write_strings(FILE *fp)
+{
+    vdpau_trace_record_t record;
+    unsigned int i, num_strings;
+    size_t len, pos, n;
+
+    num_strings = __atomic_load_n(&g_trace_num_strings, __ATOMIC_ACQUIRE);
+    for (i = g_trace_num_strings_written; i < num_strings; i++) {
+        const char * const str = g_trace_strings[i].str;
+        len = strlen(str) + 1;
+        for (pos = 0; pos < len; pos += n) {
+            memset(&record, 0, sizeof(record));
+            record.id   = i;
+            record.type = VDPAU_TRACE_RECORD_STRING;
+            n = MIN(len - pos, sizeof(record.args));
+            memcpy(record.args, str + pos, n);
+            fwrite(&record, sizeof(record), 1, fp);
+        }
+    }
+    g_trace_num_strings_written = num_strings;
+}
+
+// Write out the contents of all rings
+static void trace_flush(FILE *fp)
+{
+    trace_ring_t *ring, *rings;
+    vdpau_trace_record_t record;
+    unsigned int tail;
+    uint64_t num_dropped;
+
+    /* Strings used by records pushed so far are all interned */
+    rings = __atomic_load_n(&g_trace_rings, __ATOMIC_ACQUIRE);
+    for (ring = rings; ring; ring = ring->next)
+        ring->flush_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    trace_write_strings(fp);
+
+    for (ring = rings; ring; ring = ring->next) {
+        for (tail = ring->tail; tail != ring->flush_head; tail++)
+            fwrite(&ring->records[tail % TRACE_RING_SIZE],
+                   sizeof(ring->records[0]), 1, fp);
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        num_dropped = __atomic_exchange_n(&ring->num_dropped, 0, __ATOMIC_RELAXED);
+        if (num_dropped > 0) {
+            memset(&record, 0, sizeof(record));
+            record.timestamp = trace_get_ticks();
+            record.thread    = ring->thread;
+            record.type      = VDPAU_TRACE_RECORD_DROPPED;
+            record.args[0]   = num_dropped;
+            fwrite(&record, sizeof(record), 1, fp);
+        }
+    }
+    fflush(fp);
+}
+
+static void *trace_flush_thread(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&g_trace_lock);
+    while (!g_trace_thread_quit) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)g_trace_interval * 1000000;
+        deadline.tv_sec  += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&g_trace_cond, &g_trace_lock, &deadline);
+        pthread_mutex_unlock(&g_trace_lock);
+        trace_flush(g_trace_file);
+        pthread_mutex_lock(&g_trace_lock);
+    }
+    pthread_mutex_unlock(&g_trace_lock);
+    return NULL;
+}
+
+// Start the trace flusher thread, once per display
+int
+vdpau_trace_init(void)
+{
+    static const uint32_t header[2] = {
+        VDPAU_TRACE_VERSION, sizeof(vdpau_trace_record_t)
+    };
+    int interval;
+
+    if (!trace_file_enabled())
+        return 0;
+
+    pthread_mutex_lock(&g_trace_lock);
+    if (g_trace_refcount++ > 0) {
+        pthread_mutex_unlock(&g_trace_lock);
+        return 0;
+    }
+
+    if (!g_trace_file) {
+        const char * const trace_file = getenv("VDPAU_VIDEO_TRACE_FILE");
+        g_trace_file = fopen(trace_file, "wb");
+        if (!g_trace_file) {
+            /* trace_print() formats text again from now on */
+            vdpau_error_message("could not open trace file %s, "
+                                "tracing to the standard output\n",
+                                trace_file);
+            __atomic_store_n(&g_trace_file_enabled, 0, __ATOMIC_RELAXED);
+            g_trace_refcount--;
+            pthread_mutex_unlock(&g_trace_lock);
+            return 0;
+        }
+        fwrite(VDPAU_TRACE_MAGIC, 8, 1, g_trace_file);
+        fwrite(header, sizeof(header), 1, g_trace_file);
+    }
+
+    if (getenv_int("VDPAU_VIDEO_TRACE_FLUSH_INTERVAL", &interval) < 0 ||
+        interval < 1)
+        interval = TRACE_FLUSH_INTERVAL;
+    g_trace_interval = interval;
+
+    g_trace_thread_quit = 0;
+    if (pthread_create(&g_trace_thread, NULL, trace_flush_thread, NULL) != 0)
+        g_trace_thread_quit = -1;
+    pthread_mutex_unlock(&g_trace_lock);
+    return 0;
+}
+
+// Flush the trace, and stop the flusher thread with the last display
+void
+vdpau_trace_exit(void)
+{
+    pthread_mutex_lock(&g_trace_lock);
+    if (g_trace_refcount == 0 || --g_trace_refcount > 0) {
+        pthread_mutex_unlock(&g_trace_lock);
+        return;
+    }
+    if (g_trace_thread_quit == 0) {
+        g_trace_thread_quit = 1;
+        pthread_cond_signal(&g_trace_cond);
+        pthread_mutex_unlock(&g_trace_lock);
+        pthread_join(g_trace_thread, NULL);
+        g_trace_thread_quit = -1;
+    }
+    else {
+        pthread_mutex_unlock(&g_trace_lock);
+        trace_flush(g_trace_file);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ *  vdpau_trace.h - VDPAU backend for VA-API (binary trace)
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef VDPAU_TRACE_H
+#define VDPAU_TRACE_H
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/* When VDPAU_VIDEO_TRACE_FILE names a file, trace_print() appends a
+ * fixed-size record to a per-thread ring instead of formatting text, and
+ * a background thread flushes the rings to the file. All fields are in
+ * host byte order.
+ *
+ *   file header:   magic "VDPVATRC", version, record size (32-bit words)
+ *   record:        vdpau_trace_record_t
+ *
+ *   VDPAU_TRACE_RECORD_STRING:  string ID, up to sizeof(args) bytes of the
+ *                               string; the string continues in the next
+ *                               records until a NUL byte
+ *   VDPAU_TRACE_RECORD_PRINT:   format string ID, arguments in format order;
+ *                               %s arguments are string IDs, floating-point
+ *                               ones are doubles, others integers
+ *   VDPAU_TRACE_RECORD_DROPPED: args[0] records lost as the ring was full
+ *
+ * String ID 0 is always "<dropped>", and stands for %s arguments that
+ * did not fit in the string table.
+ *
+ * A string is always defined before the first record that uses it, so
+ * the text trace is rebuilt by running printf() over the records.
+ */
+#define VDPAU_TRACE_MAGIC               "VDPVATRC"
+#define VDPAU_TRACE_VERSION             2
+#define VDPAU_TRACE_MAX_ARGS            6
+
+enum {
+    VDPAU_TRACE_RECORD_STRING   = 1,
+    VDPAU_TRACE_RECORD_PRINT,
+    VDPAU_TRACE_RECORD_DROPPED
+};
+
+typedef struct {
+    uint64_t            timestamp;      /* CLOCK_MONOTONIC, in ns */
+    uint16_t            thread;         /* sequential thread number */
+    uint16_t            id;             /* string ID */
+    uint8_t             type;
+    uint8_t             num_args;
+    uint8_t             indent;
+    uint8_t             reserved;
+    uint64_t            args[VDPAU_TRACE_MAX_ARGS];
+} vdpau_trace_record_t;
+
+// Check whether VDPAU_VIDEO_TRACE_FILE names a trace file
+int trace_file_requested(void)
+    attribute_hidden;
+
+// Check whether trace_print() records to VDPAU_VIDEO_TRACE_FILE, which
+// stops if the file cannot be opened
+int trace_file_enabled(void)
+    attribute_hidden;
+
+// Start the trace flusher thread, once per display. If the file cannot
+// be opened, tracing falls back to text
+int
+vdpau_trace_init(void)
+    attribute_hidden;
+
+// Flush the trace, and stop the flusher thread with the last display
+void
+vdpau_trace_exit(void)
+    attribute_hidden;
+
+// Record a trace_print() call into the ring of the current thread
+void
+trace_record(int indent, const char *format, va_list args)
+    attribute_hidden;
+
+#endif /* VDPAU_TRACE_H */
@@ -22,9 +22,16 @@
 #include "vdpau_video.h"
 #include "vdpau_video_x11.h"
 #include "vdpau_decode.h"
+#include "vdpau_decoder_cache.h"
 #include "vdpau_subpic.h"
 #include "vdpau_mixer.h"
 #include "vdpau_buffer.h"
+#include "vdpau_caps.h"
+#include "vdpau_capture.h"
+#include "vdpau_decode_worker.h"
+#include "vdpau_image.h"
+#include "vdpau_surface_pool.h"
+#include "vdpau_timeline.h"
 #include "utils.h"
 
 #define DEBUG 1
@@ -60,37 +67,7 @@ get_max_surface_size(
     uint32_t            *pmax_height
 )
 {
-    VdpBool is_supported = VDP_FALSE;
-    VdpStatus vdp_status;
-    uint32_t max_level, max_references, max_width, max_height;
-
-    if (pmax_width)
-        *pmax_width = 0;
-    if (pmax_height)
-        *pmax_height = 0;
-
-    vdp_status = vdpau_decoder_query_capabilities(
-        driver_data,
-        driver_data->vdp_device,
-        profile,
-        &is_supported,
-        &max_level,
-        &max_references,
-        &max_width,
-        &max_height
-    );
-    if (!VDPAU_CHECK_STATUS(vdp_status, "VdpDecoderQueryCapabilities()"))
-        return VDP_FALSE;
-
-    if (!is_supported)
-        return VDP_FALSE;
-
-    if (pmax_width)
-        *pmax_width = max_width;
-    if (max_height)
-        *pmax_height = max_height;
-
-    return VDP_TRUE;
+    return vdpau_caps_get_decoder(driver_data, profile, pmax_width, pmax_height);
 }
 
 // vaGetConfigAttributes
@@ -374,8 +351,11 @@ vdpau_DestroySurfaces(
         if (!obj_surface)
             continue;
 
+        sync_surface_decode(driver_data, obj_surface);
         if (obj_surface->vdp_surface != VDP_INVALID_HANDLE) {
-            vdpau_video_surface_destroy(driver_data, obj_surface->vdp_surface);
+            surface_pool_release(driver_data, obj_surface->vdp_chroma_type,
+                                 obj_surface->width, obj_surface->height,
+                                 &obj_surface->vdp_surface, 1);
             obj_surface->vdp_surface = VDP_INVALID_HANDLE;
         }
 
@@ -420,6 +400,13 @@ vdpau_DestroySurfaces(
         obj_surface->assocs_count = 0;
         obj_surface->assocs_count_max = 0;
 
+        destroy_derived_image(ctx, obj_surface);
+        free(obj_surface->staging_data);
+        obj_surface->staging_data = NULL;
+        obj_surface->staging_size = 0;
+
+        pthread_cond_destroy(&obj_surface->sync_cond);
+        pthread_mutex_destroy(&obj_surface->sync_lock);
         object_heap_free(&driver_data->surface_heap, (object_base_p)obj_surface);
     }
     return VA_STATUS_SUCCESS;
@@ -439,28 +426,32 @@ vdpau_CreateSurfaces(
     VDPAU_DRIVER_DATA_INIT;
 
     VAStatus va_status = VA_STATUS_SUCCESS;
-    VdpVideoSurface vdp_surface = VDP_INVALID_HANDLE;
     VdpChromaType vdp_chroma_type = get_VdpChromaType(format);
+    VdpVideoSurface *vdp_surfaces;
     VdpStatus vdp_status;
-    int i;
+    object_mixer_p obj_mixer = NULL;
+    int i, n;
 
     /* We only support one format */
     if (format != VA_RT_FORMAT_YUV420)
         return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
 
-    for (i = 0; i < num_surfaces; i++) {
-        vdp_status = vdpau_video_surface_create(
-            driver_data,
-            driver_data->vdp_device,
-            vdp_chroma_type,
-            width, height,
-            &vdp_surface
-        );
-        if (!VDPAU_CHECK_STATUS(vdp_status, "VdpVideoSurfaceCreate()")) {
-            va_status = VA_STATUS_ERROR_ALLOCATION_FAILED;
-            break;
-        }
+    if (num_surfaces <= 0)
+        return VA_STATUS_SUCCESS;
+
+    vdp_surfaces = malloc(num_surfaces * sizeof(vdp_surfaces[0]));
+    if (!vdp_surfaces)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    vdp_status = surface_pool_acquire(driver_data, vdp_chroma_type,
+                                      width, height,
+                                      vdp_surfaces, num_surfaces);
+    if (vdp_status != VDP_STATUS_OK) {
+        free(vdp_surfaces);
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    }
 
+    for (i = 0; i < num_surfaces; i++) {
         int va_surface = object_heap_allocate(&driver_data->surface_heap);
         object_surface_p obj_surface = VDPAU_SURFACE(va_surface);
         if (!obj_surface) {
@@ -469,24 +460,39 @@ vdpau_CreateSurfaces(
         }
         obj_surface->va_context                 = VA_INVALID_ID;
         obj_surface->va_surface_status          = VASurfaceReady;
-        obj_surface->vdp_surface                = vdp_surface;
+        obj_surface->vdp_surface                = vdp_surfaces[i];
         obj_surface->width                      = width;
         obj_surface->height                     = height;
         obj_surface->assocs                     = NULL;
         obj_surface->assocs_count               = 0;
         obj_surface->assocs_count_max           = 0;
+        obj_surface->decode_seq                 = 0;
+        obj_surface->decode_status              = VA_STATUS_SUCCESS;
+        obj_surface->timeline_flow              = 0;
+        obj_surface->derived_image              = VA_INVALID_ID;
+        obj_surface->derived_image_valid        = 0;
+        obj_surface->staging_data               = NULL;
+        obj_surface->staging_size               = 0;
+        obj_surface->staging_valid              = 0;
+        obj_surface->is_locked                  = 0;
+        pthread_mutex_init(&obj_surface->sync_lock, NULL);
+        pthread_cond_init(&obj_surface->sync_cond, NULL);
         obj_surface->vdp_chroma_type            = vdp_chroma_type;
         obj_surface->output_surfaces            = NULL;
         obj_surface->output_surfaces_count      = 0;
         obj_surface->output_surfaces_count_max  = 0;
         obj_surface->video_mixer                = NULL;
         surfaces[i]                             = va_surface;
-        vdp_surface                             = VDP_INVALID_HANDLE;
+        vdp_surfaces[i]                         = VDP_INVALID_HANDLE;
 
-        object_mixer_p obj_mixer;
-        obj_mixer = video_mixer_create_cached(driver_data, obj_surface);
+        /* All surfaces of the batch share the same mixer */
+        if (obj_mixer)
+            obj_mixer = video_mixer_ref(driver_data, obj_mixer);
+        else
+            obj_mixer = video_mixer_create_cached(driver_data, obj_surface);
         if (!obj_mixer) {
             va_status = VA_STATUS_ERROR_ALLOCATION_FAILED;
+            i++;
             break;
         }
         obj_surface->video_mixer = obj_mixer;
@@ -494,10 +500,15 @@ vdpau_CreateSurfaces(
 
     /* Error recovery */
     if (va_status != VA_STATUS_SUCCESS) {
-        if (vdp_surface != VDP_INVALID_HANDLE)
-            vdpau_video_surface_destroy(driver_data, vdp_surface);
         vdpau_DestroySurfaces(ctx, surfaces, i);
+        for (i = 0, n = 0; i < num_surfaces; i++) {
+            if (vdp_surfaces[i] != VDP_INVALID_HANDLE)
+                vdp_surfaces[n++] = vdp_surfaces[i];
+        }
+        surface_pool_release(driver_data, vdp_chroma_type, width, height,
+                             vdp_surfaces, n);
     }
+    free(vdp_surfaces);
     return va_status;
 }
 // vaCreateSurfaces2
@@ -526,6 +537,11 @@ VAStatus vdpau_DestroyContext(VADriverContextP ctx, VAContextID context)
     if (!obj_context)
         return VA_STATUS_ERROR_INVALID_CONTEXT;
 
+    if (obj_context->decode_worker) {
+        decode_worker_free(obj_context->decode_worker);
+        obj_context->decode_worker = NULL;
+    }
+
     if (obj_context->gen_slice_data) {
         free(obj_context->gen_slice_data);
         obj_context->gen_slice_data = NULL;
@@ -540,8 +556,22 @@ VAStatus vdpau_DestroyContext(VADriverContextP ctx, VAContextID context)
         obj_context->vdp_bitstream_buffers_count_max = 0;
     }
 
+    if (obj_context->bitstream_data) {
+        free(obj_context->bitstream_data);
+        obj_context->bitstream_data = NULL;
+        obj_context->bitstream_data_size = 0;
+        obj_context->bitstream_data_size_max = 0;
+    }
+
     if (obj_context->vdp_decoder != VDP_INVALID_HANDLE) {
-        vdpau_decoder_destroy(driver_data, obj_context->vdp_decoder);
+        decoder_cache_release(
+            driver_data,
+            obj_context->vdp_profile,
+            obj_context->picture_width,
+            obj_context->picture_height,
+            obj_context->max_ref_frames,
+            obj_context->vdp_decoder
+        );
         obj_context->vdp_decoder = VDP_INVALID_HANDLE;
     }
 
@@ -551,12 +581,18 @@ VAStatus vdpau_DestroyContext(VADriverContextP ctx, VAContextID context)
         obj_context->dead_buffers = NULL;
     }
 
+    if (obj_context->slice_data_arena) {
+        slice_data_arena_unref(driver_data, obj_context->slice_data_arena);
+        obj_context->slice_data_arena = NULL;
+    }
+
     if (obj_context->render_targets) {
         for (i = 0; i < obj_context->num_render_targets; i++) {
             object_surface_p obj_surface;
             obj_surface = VDPAU_SURFACE(obj_context->render_targets[i]);
-            if (obj_surface)
-                obj_surface->va_context = VA_INVALID_ID;
+            if (!obj_surface)
+                continue;
+            obj_surface->va_context = VA_INVALID_ID;
         }
         free(obj_context->render_targets);
         obj_context->render_targets = NULL;
@@ -635,12 +671,18 @@ vdpau_CreateContext(
     obj_context->vdp_codec              = get_VdpCodec(vdp_profile);
     obj_context->vdp_profile            = vdp_profile;
     obj_context->vdp_decoder            = VDP_INVALID_HANDLE;
+    init_translate_buffer_funcs(obj_context);
     obj_context->gen_slice_data = NULL;
     obj_context->gen_slice_data_size = 0;
     obj_context->gen_slice_data_size_max = 0;
     obj_context->vdp_bitstream_buffers = NULL;
     obj_context->vdp_bitstream_buffers_count = 0;
     obj_context->vdp_bitstream_buffers_count_max = 0;
+    obj_context->bitstream_data = NULL;
+    obj_context->bitstream_data_size = 0;
+    obj_context->bitstream_data_size_max = 0;
+    obj_context->slice_data_arena = NULL;
+    obj_context->decode_worker = NULL;
 
     if (!obj_context->render_targets) {
         vdpau_DestroyContext(ctx, context_id);
@@ -658,6 +700,20 @@ vdpau_CreateContext(
         ASSERT(obj_surface->va_context == VA_INVALID_ID);
         obj_surface->va_context = context_id;
     }
+
+    if (decode_worker_enabled()) {
+        obj_context->decode_worker = decode_worker_new(driver_data);
+        if (!obj_context->decode_worker)
+            D(bug("failed to create decode worker, decoding synchronously\n"));
+    }
+
+    /* Otherwise, the decoder is created at the first vaEndPicture() */
+    if (decoder_cache_preallocate(driver_data) &&
+        ensure_decoder_with_max_refs(driver_data, obj_context, -1) != VDP_STATUS_OK)
+        D(bug("failed to preallocate decoder, retrying at vaEndPicture()\n"));
+
+    capture_create_context(driver_data, obj_context);
+    timeline_name_track(context_id, "VAContext 0x%08x", context_id);
     return VA_STATUS_SUCCESS;
 }
 
@@ -670,6 +726,22 @@ query_surface_status(
 )
 {
     VAStatus va_status = VA_STATUS_SUCCESS;
+    unsigned int decode_pending;
+
+    pthread_mutex_lock(&obj_surface->sync_lock);
+    decode_pending = obj_surface->decode_seq != 0;
+    pthread_mutex_unlock(&obj_surface->sync_lock);
+
+    if (decode_pending) {
+        if (status)
+            *status = VASurfaceRendering;
+        return VA_STATUS_SUCCESS;
+    }
+
+    /* VDPAU serializes operations on a surface, so it is as good as
+       ready for the client as soon as the decode was submitted */
+    if (obj_surface->va_surface_status == VASurfaceRendering)
+        obj_surface->va_surface_status = VASurfaceReady;
 
     if (obj_surface->va_surface_status == VASurfaceDisplaying) {
         unsigned int i, num_output_surfaces_displaying = 0;
@@ -726,34 +798,146 @@ vdpau_QuerySurfaceStatus(
     return query_surface_status(driver_data, obj_surface, status);
 }
 
-// Wait for the surface to complete pending operations
-VAStatus
-sync_surface(
+// Wait for the last queued output surface to become visible
+static VAStatus
+sync_output_surface(
     vdpau_driver_data_t *driver_data,
-    object_surface_p     obj_surface
+    object_output_p      obj_output
 )
 {
-    /* VDPAU only supports status interface for in-progress display */
-    /* XXX: polling is bad but there currently is no alternative */
-    for (;;) {
-        VASurfaceStatus va_surface_status;
-        VAStatus va_status;
+    VdpOutputSurface vdp_output_surface, vdp_previous_surface;
+    VdpPresentationQueueStatus vdp_queue_status;
+    VdpTime vdp_dummy_time;
+    VdpStatus vdp_status;
 
-        va_status = query_surface_status(
+    vdp_output_surface = obj_output->vdp_output_surfaces[obj_output->displayed_output_surface];
+    if (vdp_output_surface == VDP_INVALID_HANDLE)
+        return VA_STATUS_SUCCESS;
+
+    vdp_previous_surface = VDP_INVALID_HANDLE;
+    if (obj_output->has_previous)
+        vdp_previous_surface = obj_output->vdp_output_surfaces[obj_output->previous_output_surface];
+
+    /* The presentation queue flips surfaces in order, so the last queued
+       surface becomes visible exactly when its predecessor turns idle */
+    if (vdp_previous_surface != VDP_INVALID_HANDLE &&
+        vdp_previous_surface != vdp_output_surface) {
+        vdp_status = vdpau_presentation_queue_block_until_surface_idle(
             driver_data,
-            obj_surface,
-            &va_surface_status
+            obj_output->vdp_flip_queue,
+            vdp_previous_surface,
+            &vdp_dummy_time
         );
-        if (va_status != VA_STATUS_SUCCESS)
-            return va_status;
+        if (!VDPAU_CHECK_STATUS(vdp_status, "VdpPresentationQueueBlockUntilSurfaceIdle()"))
+            return vdpau_get_VAStatus(vdp_status);
+        return VA_STATUS_SUCCESS;
+    }
 
-        if (va_surface_status != VASurfaceDisplaying)
+    /* First surface queued to an empty queue: VDPAU has nothing to block
+       on, so wait for the next retrace to show it */
+    for (;;) {
+        vdp_status = vdpau_presentation_queue_query_surface_status(
+            driver_data,
+            obj_output->vdp_flip_queue,
+            vdp_output_surface,
+            &vdp_queue_status,
+            &vdp_dummy_time
+        );
+        if (vdp_status != VDP_STATUS_OK)
+            return vdpau_get_VAStatus(vdp_status);
+        if (vdp_queue_status == VDP_PRESENTATION_QUEUE_STATUS_VISIBLE)
             break;
         delay_usec(VDPAU_SYNC_DELAY);
     }
     return VA_STATUS_SUCCESS;
 }
 
+// Wait for the surface to complete pending operations
+VAStatus
+sync_surface(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface
+)
+{
+    VAStatus va_status;
+
+    va_status = sync_surface_decode(driver_data, obj_surface);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    if (obj_surface->va_surface_status == VASurfaceRendering)
+        obj_surface->va_surface_status = VASurfaceReady;
+
+    if (obj_surface->va_surface_status == VASurfaceDisplaying) {
+        unsigned int i;
+        for (i = 0; i < obj_surface->output_surfaces_count; i++) {
+            object_output_p obj_output = obj_surface->output_surfaces[i];
+            if (!obj_output)
+                return VA_STATUS_ERROR_INVALID_SURFACE;
+
+            va_status = sync_output_surface(driver_data, obj_output);
+            if (va_status != VA_STATUS_SUCCESS)
+                return va_status;
+        }
+        obj_surface->va_surface_status = VASurfaceReady;
+    }
+    return VA_STATUS_SUCCESS;
+}
+
+// Mark CPU copies of the surface contents as out of date
+void
+invalidate_surface_copies(object_surface_p obj_surface)
+{
+    obj_surface->derived_image_valid = 0;
+    obj_surface->staging_valid       = 0;
+}
+
+// Wait for the pending decode job targeting the surface, if any
+VAStatus
+sync_surface_decode(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface
+)
+{
+    VAStatus va_status;
+
+    pthread_mutex_lock(&obj_surface->sync_lock);
+    while (obj_surface->decode_seq)
+        pthread_cond_wait(&obj_surface->sync_cond, &obj_surface->sync_lock);
+    va_status = obj_surface->decode_status;
+    obj_surface->decode_status = VA_STATUS_SUCCESS;
+    pthread_mutex_unlock(&obj_surface->sync_lock);
+    return va_status;
+}
+
+// Mark the surface as the target of decode job SEQ
+void
+surface_decode_begin(object_surface_p obj_surface, unsigned int seq)
+{
+    pthread_mutex_lock(&obj_surface->sync_lock);
+    obj_surface->decode_seq    = seq;
+    obj_surface->decode_status = VA_STATUS_SUCCESS;
+    pthread_mutex_unlock(&obj_surface->sync_lock);
+}
+
+// Mark decode job SEQ as completed and wake up waiters
+void
+surface_decode_end(
+    object_surface_p     obj_surface,
+    unsigned int         seq,
+    VAStatus             va_status
+)
+{
+    pthread_mutex_lock(&obj_surface->sync_lock);
+    /* A newer job may target the same surface already */
+    if (obj_surface->decode_seq == seq) {
+        obj_surface->decode_seq    = 0;
+        obj_surface->decode_status = va_status;
+        pthread_cond_broadcast(&obj_surface->sync_cond);
+    }
+    pthread_mutex_unlock(&obj_surface->sync_lock);
+}
+
 // vaSyncSurface
 VAStatus
 vdpau_SyncSurface2(
@@ -972,6 +1156,63 @@ vdpau_DbgCopySurfaceToBuffer(
     return VA_STATUS_ERROR_UNKNOWN;
 }
 
+// Read the surface back into its derived image, and get the plane layout
+static VAStatus
+get_surface_buffer(
+    VADriverContextP    ctx,
+    VASurfaceID         surface,
+    unsigned int       *fourcc,
+    unsigned int       *luma_stride,
+    unsigned int       *chroma_u_stride,
+    unsigned int       *chroma_v_stride,
+    unsigned int       *luma_offset,
+    unsigned int       *chroma_u_offset,
+    unsigned int       *chroma_v_offset,
+    unsigned int       *buffer_name,
+    void              **buffer
+)
+{
+    vdpau_driver_data_t * const driver_data = ctx->pDriverData;
+    unsigned int u_plane, v_plane, v_offset;
+    VAStatus va_status;
+    VAImage image;
+
+    /* The derived image is only read back again if the surface changed */
+    va_status = vdpau_DeriveImage(ctx, surface, &image);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    object_buffer_p obj_buffer = VDPAU_BUFFER(image.buf);
+    if (!obj_buffer)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    switch (image.format.fourcc) {
+    case VA_FOURCC('N','V','1','2'):
+        u_plane  = 1;
+        v_plane  = 1;
+        v_offset = 1;
+        break;
+    case VA_FOURCC('Y','V','1','2'):
+        u_plane  = 2;
+        v_plane  = 1;
+        v_offset = 0;
+        break;
+    default:
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+    }
+
+    if (fourcc)          *fourcc          = image.format.fourcc;
+    if (luma_stride)     *luma_stride     = image.pitches[0];
+    if (chroma_u_stride) *chroma_u_stride = image.pitches[u_plane];
+    if (chroma_v_stride) *chroma_v_stride = image.pitches[v_plane];
+    if (luma_offset)     *luma_offset     = image.offsets[0];
+    if (chroma_u_offset) *chroma_u_offset = image.offsets[u_plane];
+    if (chroma_v_offset) *chroma_v_offset = image.offsets[v_plane] + v_offset;
+    if (buffer_name)     *buffer_name     = image.buf;
+    if (buffer)          *buffer          = obj_buffer->buffer_data;
+    return VA_STATUS_SUCCESS;
+}
+
 #if VA_CHECK_VERSION(0,30,0)
 // vaCreateSurfaceFromCIFrame
 VAStatus
@@ -1014,8 +1255,15 @@ vdpau_CopySurfaceToBuffer(
     void              **buffer
 )
 {
-    /* TODO */
-    return VA_STATUS_ERROR_UNKNOWN;
+    VDPAU_DRIVER_DATA_INIT;
+
+    if (!VDPAU_SURFACE(surface))
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    return get_surface_buffer(ctx, surface, fourcc,
+                              luma_stride, chroma_u_stride, chroma_v_stride,
+                              luma_offset, chroma_u_offset, chroma_v_offset,
+                              NULL, buffer);
 }
 #endif
 
@@ -1036,15 +1284,24 @@ vdpau_LockSurface(
     void              **buffer
 )
 {
-    if (fourcc)          *fourcc          = VA_FOURCC('N','V','1','2');
-    if (luma_stride)     *luma_stride     = 0;
-    if (chroma_u_stride) *chroma_u_stride = 0;
-    if (chroma_v_stride) *chroma_v_stride = 0;
-    if (luma_offset)     *luma_offset     = 0;
-    if (chroma_u_offset) *chroma_u_offset = 0;
-    if (chroma_v_offset) *chroma_v_offset = 0;
-    if (buffer_name)     *buffer_name     = 0;
-    if (buffer)          *buffer          = NULL;
+    VDPAU_DRIVER_DATA_INIT;
+    VAStatus va_status;
+
+    object_surface_p obj_surface = VDPAU_SURFACE(surface);
+    if (!obj_surface)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    if (obj_surface->is_locked)
+        return VA_STATUS_ERROR_SURFACE_BUSY;
+
+    va_status = get_surface_buffer(ctx, surface, fourcc,
+                                   luma_stride, chroma_u_stride, chroma_v_stride,
+                                   luma_offset, chroma_u_offset, chroma_v_offset,
+                                   buffer_name, buffer);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    obj_surface->is_locked = 1;
     return VA_STATUS_SUCCESS;
 }
 
@@ -1055,6 +1312,18 @@ vdpau_UnlockSurface(
     VASurfaceID         surface
 )
 {
+    VDPAU_DRIVER_DATA_INIT;
+
+    object_surface_p obj_surface = VDPAU_SURFACE(surface);
+    if (!obj_surface)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    if (!obj_surface->is_locked)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    /* The readback buffer is kept for the next lock, until the surface
+       is destroyed */
+    obj_surface->is_locked = 0;
     return VA_STATUS_SUCCESS;
 }
 #endif
@@ -64,13 +64,19 @@ struct object_context {
     VdpCodec                     vdp_codec;
     VdpDecoderProfile            vdp_profile;
     VdpDecoder                   vdp_decoder;
+    translate_buffer_func_t      translate_buffer_funcs[VDPAU_MAX_TRANSLATE_BUFFER_TYPES];
     uint8_t                     *gen_slice_data;
     unsigned int                 gen_slice_data_size;
     unsigned int                 gen_slice_data_size_max;
     VdpBitstreamBuffer          *vdp_bitstream_buffers;
     unsigned int                 vdp_bitstream_buffers_count;
     unsigned int                 vdp_bitstream_buffers_count_max;
-    union {
+    uint8_t                     *bitstream_data;
+    unsigned int                 bitstream_data_size;
+    unsigned int                 bitstream_data_size_max;
+    struct slice_data_arena     *slice_data_arena;
+    struct decode_worker        *decode_worker;
+    union vdp_picture_info {
         VdpPictureInfoMPEG1Or2   mpeg2;
 #if HAVE_VDPAU_MPEG4
         VdpPictureInfoMPEG4Part2 mpeg4;
@@ -97,6 +103,18 @@ struct object_surface {
     SubpictureAssociationP      *assocs;
     unsigned int                 assocs_count;
     unsigned int                 assocs_count_max;
+    pthread_mutex_t              sync_lock;
+    pthread_cond_t               sync_cond;
+    unsigned int                 decode_seq;    /* pending decode job, 0 if none */
+    VAStatus                     decode_status;
+    uint32_t                     timeline_flow; /* decode to display, 0 if none */
+    VAImageID                    derived_image; /* vaDeriveImage() shadow */
+    unsigned int                 derived_image_valid;
+    uint8_t                     *staging_data;  /* sub-rectangle get/put */
+    unsigned int                 staging_size;
+    VdpYCbCrFormat               staging_format;
+    unsigned int                 staging_valid;
+    unsigned int                 is_locked;     /* vaLockSurface() */
 };
 
 // Query surface status
@@ -113,6 +131,31 @@ sync_surface(
     vdpau_driver_data_t *driver_data,
     object_surface_p     obj_surface
 ) attribute_hidden;
+
+// Mark CPU copies of the surface contents as out of date
+void
+invalidate_surface_copies(object_surface_p obj_surface)
+    attribute_hidden;
+
+// Wait for the pending decode job targeting the surface, if any
+VAStatus
+sync_surface_decode(
+    vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface
+) attribute_hidden;
+
+// Mark the surface as the target of decode job SEQ
+void
+surface_decode_begin(object_surface_p obj_surface, unsigned int seq)
+    attribute_hidden;
+
+// Mark decode job SEQ as completed and wake up waiters
+void
+surface_decode_end(
+    object_surface_p     obj_surface,
+    unsigned int         seq,
+    VAStatus             va_status
+) attribute_hidden;
  
 // Add subpicture association to surface
 // NOTE: the subpicture owns the SubpictureAssociation object
@@ -23,6 +23,7 @@
 #include "vdpau_video_x11.h"
 #include "vdpau_subpic.h"
 #include "vdpau_mixer.h"
+#include "vdpau_timeline.h"
 #include "utils.h"
 #include "utils_x11.h"
 
@@ -189,14 +190,18 @@ output_surface_create(
     obj_output->vdp_flip_target          = VDP_INVALID_HANDLE;
     obj_output->current_output_surface   = 0;
     obj_output->displayed_output_surface = 0;
+    obj_output->previous_output_surface  = 0;
     obj_output->queued_surfaces          = 0;
     obj_output->fields                   = 0;
     obj_output->is_window                = 0;
     obj_output->size_changed             = 0;
+    obj_output->has_previous             = 0;
 
     if (drawable != None)
         obj_output->is_window = is_window(driver_data->x11_dpy, drawable);
 
+    timeline_name_track(obj_output->base.id, "Drawable 0x%08lx", drawable);
+
     unsigned int i;
     for (i = 0; i < VDPAU_MAX_OUTPUT_SURFACES; i++) {
         obj_output->vdp_output_surfaces[i] = VDP_INVALID_HANDLE;
@@ -396,6 +401,9 @@ render_surface(
     unsigned int         flags
 )
 {
+    TIMELINE_SCOPE(timeline, "render_surface", obj_output->base.id,
+                   obj_surface->base.id);
+
     VdpRect src_rect;
     src_rect.x0 = source_rect->x;
     src_rect.y0 = source_rect->y;
@@ -544,6 +552,9 @@ render_subpictures(
     const VARectangle   *target_rect
 )
 {
+    TIMELINE_SCOPE(timeline, "render_subpictures", obj_output->base.id,
+                   obj_surface->base.id);
+
     unsigned int i;
     for (i = 0; i < obj_surface->assocs_count; i++) {
         SubpictureAssociationP const assoc = obj_surface->assocs[i];
@@ -576,10 +587,20 @@ render_subpictures(
 static VAStatus
 flip_surface_unlocked(
     vdpau_driver_data_t *driver_data,
+    object_surface_p     obj_surface,
     object_output_p      obj_output
 )
 {
     VdpStatus vdp_status;
+
+    /* Only the first display of a decoded picture ends its flow */
+    TIMELINE_SCOPE(timeline, "flip_surface_unlocked", obj_output->base.id,
+                   obj_surface->base.id);
+    if (timeline.start) {
+        timeline.flow_end = obj_surface->timeline_flow;
+        obj_surface->timeline_flow = 0;
+    }
+
     vdp_status = vdpau_presentation_queue_display(
         driver_data,
         obj_output->vdp_flip_queue,
@@ -591,6 +612,8 @@ flip_surface_unlocked(
     if (!VDPAU_CHECK_STATUS(vdp_status, "VdpPresentationQueueDisplay()"))
         return vdpau_get_VAStatus(vdp_status);
 
+    obj_output->previous_output_surface  = obj_output->displayed_output_surface;
+    obj_output->has_previous             = obj_output->queued_surfaces > 0;
     obj_output->displayed_output_surface = obj_output->current_output_surface;
     obj_output->current_output_surface   =
         (++obj_output->queued_surfaces) % VDPAU_MAX_OUTPUT_SURFACES;
@@ -607,7 +630,7 @@ queue_surface_unlocked(
     obj_surface->va_surface_status       = VASurfaceDisplaying;
     obj_output->fields                   = 0;
 
-    return flip_surface_unlocked(driver_data, obj_output);
+    return flip_surface_unlocked(driver_data, obj_surface, obj_output);
 }
 
 VAStatus
@@ -646,6 +669,8 @@ put_surface_unlocked(
     if (obj_output->vdp_output_surfaces[obj_output->current_output_surface] != VDP_INVALID_HANDLE &&
         obj_output->vdp_output_surfaces_dirty[obj_output->current_output_surface]) {
         VdpTime dummy_time;
+        TIMELINE_SCOPE(timeline, "block_until_surface_idle",
+                       obj_output->base.id, obj_surface->base.id);
         vdp_status = vdpau_presentation_queue_block_until_surface_idle(
             driver_data,
             obj_output->vdp_flip_queue,
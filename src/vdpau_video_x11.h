@@ -41,10 +41,12 @@ struct object_output {
     pthread_mutex_t             vdp_output_surfaces_lock;
     unsigned int                current_output_surface;
     unsigned int                displayed_output_surface;
+    unsigned int                previous_output_surface;
     unsigned int                queued_surfaces;
     unsigned int                fields;
     unsigned int                is_window    : 1; /* drawable is a window */
     unsigned int                size_changed : 1; /* size changed since previous vaPutSurface() and user noticed the change */
+    unsigned int                has_previous : 1; /* previous_output_surface was queued before displayed_output_surface */
 };
 
 // Create output surface
@@ -0,0 +1,163 @@
+/*
+ *  yuv2rgb.c - NV12 to RGB conversion
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#include "sysdeps.h"
+#include "yuv2rgb.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define USE_YUV2RGB_SSE2 1
+#endif
+
+/* 8-bit BT.601 coefficients (298, 409, 100, 208, 516) / 256, evaluated
+   with 6 fractional bits so that the SIMD version fits in 16-bit lanes:
+   74.5 = 74 + 1/2 and 102.25 = 102 + 1/4 */
+static inline uint8_t clamp_u8(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Convert pixels [X0, X1) of a row
+static void
+nv12_to_rgb32_row_c(
+    uint8_t            *dst,
+    const uint8_t      *y_row,
+    const uint8_t      *uv_row,
+    unsigned int        x0,
+    unsigned int        x1,
+    int                 rgba_order
+)
+{
+    const unsigned int r_pos = rgba_order ? 0 : 2;
+    const unsigned int b_pos = rgba_order ? 2 : 0;
+    unsigned int x;
+
+    for (x = x0; x < x1; x++, dst += 4) {
+        const int c  = y_row[x] - 16;
+        const int d  = uv_row[(x & ~1U) + 0] - 128;
+        const int e  = uv_row[(x & ~1U) + 1] - 128;
+        const int yv = 74 * c + (c >> 1) + 32;
+
+        dst[r_pos] = clamp_u8((yv + 102 * e + (e >> 2)) >> 6);
+        dst[1]     = clamp_u8((yv - 25 * d - 52 * e) >> 6);
+        dst[b_pos] = clamp_u8((yv + 129 * d) >> 6);
+        dst[3]     = 0xff;
+    }
+}
+
+#if USE_YUV2RGB_SSE2
+// Convert pixels [X0, X1) of a row, X0 even, 8 pixels at a time
+static unsigned int
+nv12_to_rgb32_row_sse2(
+    uint8_t            *dst,
+    const uint8_t      *y_row,
+    const uint8_t      *uv_row,
+    unsigned int        x0,
+    unsigned int        x1,
+    int                 rgba_order
+)
+{
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i alpha  = _mm_set1_epi8((char)0xff);
+    const __m128i lo16   = _mm_set1_epi32(0xffff);
+    const __m128i c16    = _mm_set1_epi16(16);
+    const __m128i c128   = _mm_set1_epi16(128);
+    const __m128i round  = _mm_set1_epi16(32);
+    unsigned int x;
+
+    for (x = x0; x + 8 <= x1; x += 8, dst += 32) {
+        const __m128i yb  = _mm_loadl_epi64((const __m128i *)(y_row + x));
+        const __m128i uvb = _mm_loadl_epi64((const __m128i *)(uv_row + x));
+        const __m128i c   = _mm_sub_epi16(_mm_unpacklo_epi8(yb, zero), c16);
+        const __m128i uv  = _mm_unpacklo_epi8(uvb, zero);
+
+        /* Duplicate each U and V sample for the two pixels sharing it */
+        __m128i u = _mm_and_si128(uv, lo16);
+        __m128i v = _mm_srli_epi32(uv, 16);
+        const __m128i d = _mm_sub_epi16(_mm_or_si128(u, _mm_slli_epi32(u, 16)), c128);
+        const __m128i e = _mm_sub_epi16(_mm_or_si128(v, _mm_slli_epi32(v, 16)), c128);
+
+        const __m128i yv = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(74)),
+                          _mm_srai_epi16(c, 1)),
+            round);
+        __m128i r = _mm_adds_epi16(
+            yv, _mm_add_epi16(_mm_mullo_epi16(e, _mm_set1_epi16(102)),
+                              _mm_srai_epi16(e, 2)));
+        __m128i g = _mm_sub_epi16(
+            _mm_sub_epi16(yv, _mm_mullo_epi16(d, _mm_set1_epi16(25))),
+            _mm_mullo_epi16(e, _mm_set1_epi16(52)));
+        __m128i b = _mm_adds_epi16(yv, _mm_mullo_epi16(d, _mm_set1_epi16(129)));
+
+        r = _mm_packus_epi16(_mm_srai_epi16(r, 6), zero);
+        g = _mm_packus_epi16(_mm_srai_epi16(g, 6), zero);
+        b = _mm_packus_epi16(_mm_srai_epi16(b, 6), zero);
+        if (rgba_order) {
+            const __m128i t = r;
+            r = b;
+            b = t;
+        }
+
+        const __m128i bg = _mm_unpacklo_epi8(b, g);
+        const __m128i ra = _mm_unpacklo_epi8(r, alpha);
+        _mm_storeu_si128((__m128i *)dst,        _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(bg, ra));
+    }
+    return x;
+}
+#endif
+
+// Convert a WIDTH x HEIGHT block of NV12 pixels at (X, Y) to 32-bit RGB
+void
+nv12_to_rgb32(
+    uint8_t            *dst,
+    unsigned int        dst_stride,
+    const uint8_t      *y_plane,
+    unsigned int        y_stride,
+    const uint8_t      *uv_plane,
+    unsigned int        uv_stride,
+    unsigned int        x,
+    unsigned int        y,
+    unsigned int        width,
+    unsigned int        height,
+    int                 rgba_order
+)
+{
+    unsigned int i, x0;
+
+    for (i = 0; i < height; i++, dst += dst_stride) {
+        const uint8_t * const y_row  = y_plane  + (y + i) * y_stride;
+        const uint8_t * const uv_row = uv_plane + ((y + i) / 2) * uv_stride;
+
+        /* Start the SIMD loop on a chroma sample boundary */
+        x0 = x;
+        if ((x0 & 1) && width > 0) {
+            nv12_to_rgb32_row_c(dst, y_row, uv_row, x0, x0 + 1, rgba_order);
+            x0++;
+        }
+#if USE_YUV2RGB_SSE2
+        x0 = nv12_to_rgb32_row_sse2(dst + (x0 - x) * 4, y_row, uv_row,
+                                    x0, x + width, rgba_order);
+#endif
+        nv12_to_rgb32_row_c(dst + (x0 - x) * 4, y_row, uv_row,
+                            x0, x + width, rgba_order);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ *  yuv2rgb.h - NV12 to RGB conversion
+ *
+ *  libva-vdpau-driver (C) 2009-2011 Splitted-Desktop Systems
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef YUV2RGB_H
+#define YUV2RGB_H
+
+#include <stdint.h>
+
+// Convert a WIDTH x HEIGHT block of NV12 pixels at (X, Y) to 32-bit RGB
+// with opaque alpha, using BT.601 limited range coefficients. Pixels are
+// stored R, G, B, A if RGBA_ORDER is set, B, G, R, A otherwise
+void
+nv12_to_rgb32(
+    uint8_t            *dst,
+    unsigned int        dst_stride,
+    const uint8_t      *y_plane,
+    unsigned int        y_stride,
+    const uint8_t      *uv_plane,
+    unsigned int        uv_stride,
+    unsigned int        x,
+    unsigned int        y,
+    unsigned int        width,
+    unsigned int        height,
+    int                 rgba_order
+) attribute_hidden;
+
+#endif /* YUV2RGB_H */